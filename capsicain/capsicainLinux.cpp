@@ -0,0 +1,214 @@
+#include "pch.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "evdevIO.h"
+#include "uinputIO.h"
+#include "headlessIO.h"
+
+using namespace std;
+
+// capsicain on Linux: the keyboards come from evdev (see evdevIO.h), the result goes to a uinput virtual keyboard
+// (see uinputIO.h). Same engine, same ini. Console output goes to stderr.
+//
+// usage: capsicain_linux [--nograb] [--stdin] [--print | --events file] [path/to/capsicain.ini]
+//
+// --nograb  do not grab the keyboards; the system still gets every key (use with --print to try out a config)
+// --stdin   read the strokes as text from stdin instead of the keyboards (capsicain_headless format)
+// --print   print the resulting strokes to stdout (capsicain_headless format) instead of the virtual keyboard
+// --events  write the uinput event stream (struct input_event) to file instead of the virtual keyboard. '-' is stdout.
+//
+// [ESC]+[X] or Ctrl+C to stop. [ESC]+[H] for the commands.
+
+#define CAPTURE_REMINDER_SECONDS 60  //while [ESC]+[G] captures, the console says so this often
+
+EvdevInput evdevInput;
+ostream strokeOutput(cout.rdbuf());  //main() moves cout to stderr
+HeadlessIO textIO(strokeOutput);
+UinputOutput uinputOutput;
+SteadyClock steadyClock;
+bool processCommand(int scancode);
+
+//there is no tray icon on Linux, so a running capture (a keylogger, after all) is repeated on the console
+atomic<bool> capturing(false);
+
+class LinuxHost : public EngineHost
+{
+public:
+    string getHardwareId(InterceptionDevice device) override
+    {
+        return evdevInput.getHardwareId(device);
+    }
+    void showCapture(bool active) override
+    {
+        capturing = active;
+    }
+    bool processCommand(int scancode) override
+    {
+        return ::processCommand(scancode);
+    }
+} linuxHost;
+
+Engine *engine = nullptr;
+
+mutex reminderMutex;
+condition_variable reminderStop;
+bool reminderStopped = false;
+
+void remindOfCapture()
+{
+    unique_lock<mutex> lock(reminderMutex);
+    while (!reminderStop.wait_for(lock, chrono::seconds(CAPTURE_REMINDER_SECONDS), [] { return reminderStopped; }))
+    {
+        if (capturing)
+            cout << endl << "CAPTURE is running: all input goes to " << CAPTURE_FILE_NAME << ". [ESC]+[G] to stop.";
+    }
+}
+
+void printHelp()
+{
+    cout << "HELP" << endl << endl
+        << "Press [ESC] + [key] for core commands" << endl << endl
+        << "[H] Help" << endl
+        << "[X] Exit" << endl
+        << "[0]..[9] switch configs. [0] is the unchangeable empty 'do nothing but listen for commands' config" << endl
+        << "[Backspace] Reset the key state and the latency histograms" << endl
+        << "[R] Reset and reload the .ini file" << endl
+        << "[S] Status" << endl
+        << "[P] write the latency histograms to " LATENCY_FILE_NAME << endl
+        << "[G] Capture all input to " CAPTURE_FILE_NAME " and back off (for capsicain_replay)" << endl
+        << "[F] Flight recorder: the last keys through the pipeline, to " FLIGHT_FILE_NAME " and " TRACE_FILE_NAME << endl
+        << "[D] Debug mode output" << endl
+        << "[E] Error log" << endl
+        << "[C] Print list of key labels for all scancodes" << endl
+        << "[W] flip ALT <-> WIN on Apple keyboards" << endl
+        << "[Z] (labeled [Y] on GER keyboard): flip Y <-> Z keys" << endl
+        << "[I] Show processed Ini for the active config" << endl
+        << "[J][K][L] Macro Recording: Start,Stop,Playback" << endl
+        << "[,] and [.]: delay between keys in sequences -/+ 1ms";
+}
+
+// [ESC]+x combos; Engine::processCommonCommand() has all but exit and help
+// returns false if exit was requested
+bool processCommand(int scancode)
+{
+    cout << endl << endl << "::";
+
+    if (engine->processCommonCommand(scancode))
+        return true;
+
+    switch (scancode)
+    {
+    case SC_X:
+        cout << endl << endl << "ESC+X :: EXIT";
+        return false;
+    case SC_H:
+        printHelp();
+        break;
+    default:
+        cout << "Unknown command";
+        break;
+    }
+    return true;
+}
+
+void stopOnSignal(int)
+{
+    evdevInput.stop();
+}
+
+int main(int argc, char *argv[])
+{
+    //strokes on stdout, console on stderr
+    cout.rdbuf(cerr.rdbuf());
+
+    bool grab = true;
+    bool readStdin = false;
+    bool print = false;
+    string eventsFileName;
+    string iniFileName = "capsicain.ini";
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--nograb")
+            grab = false;
+        else if (arg == "--stdin")
+            readStdin = true;
+        else if (arg == "--print")
+            print = true;
+        else if (arg == "--events" && i + 1 < argc)
+            eventsFileName = argv[++i];
+        else
+            iniFileName = arg;
+    }
+
+    cout << "Capsicain v" VERSION " (Linux)" << endl;
+    if (eventsFileName != "")
+    {
+        int fd = eventsFileName == "-" ? dup(STDOUT_FILENO) : open(eventsFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            cout << endl << "Cannot write " << eventsFileName << endl;
+            return 1;
+        }
+        uinputOutput.attach(fd);
+    }
+    else if (!print && !uinputOutput.open())
+    {
+        cout << endl << "Cannot create the virtual keyboard: /dev/uinput. Permission? (root, or the 'input' group and the uinput module)" << endl;
+        return 1;
+    }
+
+    Engine theEngine(print ? (EngineOutput &)textIO : uinputOutput, steadyClock, linuxHost);
+    engine = &theEngine;
+    engine->iniFileName = iniFileName;
+    if (!engine->loadIni())
+    {
+        cout << endl << "Cannot read " << engine->iniFileName << " - exiting..." << endl;
+        return 1;
+    }
+
+    if (!readStdin)
+    {
+        evdevInput.ignoreDeviceName = UINPUT_DEVICE_NAME;  //our own output
+        if (!evdevInput.open(grab))
+        {
+            cout << endl << "No keyboard found in " EVDEV_INPUT_DIR ". Permission? (root, or the 'input' group)" << endl;
+            return 1;
+        }
+        signal(SIGINT, stopOnSignal);
+        signal(SIGTERM, stopOnSignal);
+        cout << endl << endl << "[ESC] + [X] to stop." << endl << "[ESC] + [H] for Help";
+        cout << endl << endl << "capsicain running.... ";
+    }
+
+    thread reminder(remindOfCapture);
+
+    //CORE LOOP
+    if (readStdin)
+        engine->run(textIO);
+    else
+        engine->run(evdevInput);
+
+    {
+        lock_guard<mutex> lock(reminderMutex);
+        reminderStopped = true;
+    }
+    reminderStop.notify_one();
+    reminder.join();
+
+    evdevInput.close();
+    uinputOutput.close();
+    cout << endl << "bye" << endl;
+    return 0;
+}
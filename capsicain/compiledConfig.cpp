@@ -0,0 +1,148 @@
+#include "pch.h"
+#include <vector>
+#include <unordered_map>
+
+#include "compiledConfig.h"
+#include "engine.h"
+
+using namespace std;
+
+//one combo rule as constraints on the bits of the combo state word
+struct ComboConstraint
+{
+    int combo;                      //index into modCombos
+    unsigned long long mustBeSet;   //modAnd, modTap, deadkey bits
+    unsigned long long mustBeClear; //modNot, deadkey bits
+    unsigned long long anyOf;       //modOr; 0 if unused
+};
+
+struct DiagramBuilder
+{
+    vector<ComboDecisionNode> &nodes;
+    unordered_map<unsigned long long, int> nodeIndex;  //merges identical nodes (bit, ifClear, ifSet)
+    long budget = COMBO_DECISION_BUDGET;
+
+    explicit DiagramBuilder(vector<ComboDecisionNode> &nodes) : nodes(nodes) {}
+
+    int makeNode(unsigned char bit, int ifClear, int ifSet)
+    {
+        if (ifClear == ifSet)
+            return ifClear;
+        unsigned long long key = ((unsigned long long)bit << 56)
+            ^ ((unsigned long long)(unsigned int)ifClear << 28) ^ (unsigned int)ifSet;
+        auto known = nodeIndex.find(key);
+        if (known != nodeIndex.end())
+        {
+            const ComboDecisionNode &n = nodes[known->second];
+            if (n.bit == bit && n.ifClear == ifClear && n.ifSet == ifSet)
+                return known->second;
+        }
+        nodes.push_back({ bit, ifClear, ifSet });
+        nodeIndex[key] = (int)nodes.size() - 1;
+        return (int)nodes.size() - 1;
+    }
+
+    //Shannon expansion in combo definition order: the first combo that can still match decides which bit is tested next
+    int build(const vector<ComboConstraint> &candidates, unsigned long long known1, unsigned long long known0)
+    {
+        if (--budget < 0)
+            return COMBO_SCAN;
+
+        vector<ComboConstraint> alive;
+        for (const ComboConstraint &c : candidates)
+        {
+            bool dead = (c.mustBeSet & known0) || (c.mustBeClear & known1)
+                || (c.anyOf != 0 && (c.anyOf & known1) == 0 && (c.anyOf & ~known0) == 0);
+            if (dead)
+                continue;
+            if (alive.size() == 0)
+            {
+                bool matches = (c.mustBeSet & ~known1) == 0 && (c.mustBeClear & ~known0) == 0
+                    && (c.anyOf == 0 || (c.anyOf & known1) != 0);
+                if (matches)
+                    return COMBO_LEAF(c.combo);
+            }
+            alive.push_back(c);
+        }
+        if (alive.size() == 0)
+            return COMBO_NONE;
+
+        const ComboConstraint &first = alive[0];
+        unsigned long long undecided = (first.mustBeSet | first.mustBeClear | first.anyOf) & ~(known1 | known0);
+        unsigned char bit = 0;
+        while (((undecided >> bit) & 1) == 0)
+            bit++;
+        unsigned long long mask = 1ULL << bit;
+
+        int ifClear = build(alive, known1, known0 | mask);
+        int ifSet = build(alive, known1 | mask, known0);
+        if (ifClear == COMBO_SCAN || ifSet == COMBO_SCAN)
+            return COMBO_SCAN;
+        return makeNode(bit, ifClear, ifSet);
+    }
+};
+
+void compileConfig(AllMaps &maps)
+{
+    CompiledConfig &compiled = maps.compiled;
+    compiled.comboNodes.clear();
+    DiagramBuilder builder(compiled.comboNodes);
+
+    for (int vk = 0; vk < MAX_VCODES; vk++)
+    {
+        CompiledKey &key = compiled.keys[vk];
+        for (int c = 0; c < REWIRE_COLS; c++)
+            key.rewire[c] = maps.rewiremap[vk][c];
+
+        key.alpha[0] = maps.alphamap[vk];
+        switch (key.alpha[0])
+        {
+        case SC_Y:  key.alpha[1] = SC_Z;  break;
+        case SC_Z:  key.alpha[1] = SC_Y;  break;
+        default:    key.alpha[1] = key.alpha[0];
+        }
+
+        vector<ComboConstraint> constraints;
+        for (unsigned int i = maps.comboIndex[vk]; i < maps.comboIndex[vk + 1]; i++)
+        {
+            const AllMaps::ComboMatch &m = maps.comboMatches[i];
+            unsigned long long deadkey = (unsigned long long)m.deadkey << 32;
+            unsigned long long deadkeyClear = (unsigned long long)(unsigned char)~m.deadkey << 32;
+            constraints.push_back({ (int)m.combo,
+                m.modAnd | ((unsigned long long)m.modTap << 16) | deadkey,
+                m.modNot | deadkeyClear,
+                m.modOr });
+        }
+        builder.budget = COMBO_DECISION_BUDGET;
+        key.comboDecision = builder.build(constraints, 0, 0);
+
+        key.transparent = key.comboDecision == COMBO_NONE && key.alpha[0] == vk;
+        for (int c = 0; c < REWIRE_COLS; c++)
+            if (key.rewire[c] != -1)
+                key.transparent = false;
+        if (vk < 256 && (maps.chordsOfKey[vk] != 0 || maps.layerKeys[vk] != 0 || maps.composeColumn[vk] != 0))
+            key.transparent = false;
+    }
+}
+
+int scanCombos(const AllMaps &maps, int vcode, unsigned short modifierDown, unsigned short modifierTapped, unsigned char activeDeadkey)
+{
+    if (vcode < 0 || vcode >= MAX_VCODES)
+        return -1;
+
+    for (unsigned int i = maps.comboIndex[vcode]; i < maps.comboIndex[vcode + 1]; i++)
+    {
+        const AllMaps::ComboMatch &match = maps.comboMatches[i];
+        if (
+            (activeDeadkey == match.deadkey) &&
+            (modifierDown & match.modAnd) == match.modAnd &&
+            (match.modOr == 0 || (modifierDown & match.modOr) > 0) &&
+            (modifierDown & match.modNot) == 0 &&
+            ((modifierTapped & match.modTap) == match.modTap)
+            )
+        {
+            return match.combo;
+        }
+    }
+    return -1;
+}
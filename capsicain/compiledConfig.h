@@ -0,0 +1,64 @@
+#pragma once
+
+// A config compiled into one table, indexed by vcode.
+// The REWIRE row, the combo decision and the alpha layout (with and without flipZy) of a key
+// are all in its CompiledKey, so the pipeline does not need to search or branch over the maps.
+// Built from AllMaps by compileConfig() after the ini config was parsed.
+
+#include <string>
+#include <vector>
+#include "constants.h"
+
+//combo decision leaves are negative; node indexes >= 0
+#define COMBO_NONE -1   //no combo applies
+#define COMBO_SCAN -2   //diagram was too big to build, scan the combos of this vcode instead
+#define COMBO_LEAF(combo) (-3 - (combo))
+#define COMBO_OF_LEAF(leaf) (-3 - (leaf))
+
+#define COMBO_DECISION_BUDGET 200000  //max build steps per vcode before falling back to COMBO_SCAN
+
+//tests one bit of the combo state word, see comboStateWord()
+struct ComboDecisionNode
+{
+    unsigned char bit;
+    int ifClear;
+    int ifSet;
+};
+
+struct CompiledKey
+{
+    int rewire[REWIRE_COLS];  //copy of the rewiremap row, -1 = undefined
+    int alpha[2];             //alpha layout result; [1] with flipZy applied
+    int comboDecision;        //root node or leaf of the combo decision diagram
+    bool transparent;         //the config does nothing with the key; as a LAYER it falls through to the layer below
+};
+
+struct CompiledConfig
+{
+    CompiledKey keys[MAX_VCODES];
+    std::vector<ComboDecisionNode> comboNodes;  //shared by all keys; identical sub-diagrams are merged
+};
+
+struct AllMaps;
+
+//modifierDown in bits 0..15, modifierTapped in bits 16..31, activeDeadkey in bits 32..39
+inline unsigned long long comboStateWord(unsigned short modifierDown, unsigned short modifierTapped, unsigned char activeDeadkey)
+{
+    return modifierDown | ((unsigned long long)modifierTapped << 16) | ((unsigned long long)activeDeadkey << 32);
+}
+
+//walks the combo decision diagram of vcode. Returns a leaf (COMBO_NONE, COMBO_SCAN or COMBO_LEAF(index into modCombos))
+inline int decideCombo(const CompiledConfig &compiled, int vcode, unsigned long long stateWord)
+{
+    int node = compiled.keys[vcode].comboDecision;
+    while (node >= 0)
+    {
+        const ComboDecisionNode &n = compiled.comboNodes[node];
+        node = ((stateWord >> n.bit) & 1) ? n.ifSet : n.ifClear;
+    }
+    return node;
+}
+
+void compileConfig(AllMaps &maps);
+//the interpreted combo search: first combo of vcode that matches. Returns the index into modCombos or -1
+int scanCombos(const AllMaps &maps, int vcode, unsigned short modifierDown, unsigned short modifierTapped, unsigned char activeDeadkey);
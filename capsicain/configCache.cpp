@@ -0,0 +1,380 @@
+#include "pch.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <cstring>
+
+#include "configCache.h"
+#include "utils.h"
+
+using namespace std;
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static unsigned long long hashBytes(const char *data, size_t size, unsigned long long hash = FNV_OFFSET)
+{
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (unsigned char)data[i]) * FNV_PRIME;
+    return hash;
+}
+
+unsigned long long hashIniText(std::string_view iniText)
+{
+    return hashBytes(iniText.data(), iniText.size());
+}
+
+std::string getConfigCacheFileName(const std::string &iniFileName)
+{
+    return iniFileName + ".cache";
+}
+
+//the vcodes of the virtual keys are numbered in scancodes.h, so a cache of another build may mean other keys
+static unsigned long long getBuildHash()
+{
+    string version = VERSION;
+    unsigned long long hash = hashBytes(version.data(), version.size());
+    const char separator = 0;
+    for (int i = 0; i < MAX_VCODES; i++)
+    {
+        hash = hashBytes(PRETTY_VK_LABELS[i].data(), PRETTY_VK_LABELS[i].size(), hash);
+        hash = hashBytes(&separator, 1, hash);
+    }
+    return hash;
+}
+
+struct CacheHeader
+{
+    char magic[8];              //"CPSCACHE"
+    unsigned int version;       //CONFIG_CACHE_VERSION
+    unsigned int maxVcodes;
+    unsigned int rewireCols;
+    unsigned int maxConfigs;
+    unsigned long long buildHash;
+    unsigned long long iniHash;
+    unsigned long long payloadSize;
+    unsigned long long payloadHash;
+};
+
+static const char CACHE_MAGIC[8] = { 'C', 'P', 'S', 'C', 'A', 'C', 'H', 'E' };
+
+class CacheWriter
+{
+public:
+    string buffer;
+
+    void raw(const void *data, size_t size) { buffer.append((const char *)data, size); }
+    template<typename T> void pod(T value) { raw(&value, sizeof(T)); }
+    void count(size_t n) { pod((unsigned int)n); }
+    void str(const string &s) { count(s.size()); raw(s.data(), s.size()); }
+};
+
+//reads from the mapped file. Any read past the end sets ok=false and returns zeros from then on.
+class CacheReader
+{
+public:
+    bool ok = true;
+
+    CacheReader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+    void raw(void *data, size_t size)
+    {
+        if (!ok || (size_t)(end - pos) < size)
+        {
+            ok = false;
+            memset(data, 0, size);
+            return;
+        }
+        memcpy(data, pos, size);
+        pos += size;
+    }
+    template<typename T> T pod() { T value; raw(&value, sizeof(T)); return value; }
+    //element count of a list; fails if the remaining data cannot hold that many elements
+    size_t count(size_t minElementSize)
+    {
+        size_t n = pod<unsigned int>();
+        if (n * minElementSize > (size_t)(end - pos))
+        {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+    string str()
+    {
+        size_t n = count(1);
+        string s(pos, n);
+        pos += n;
+        return s;
+    }
+    bool atEnd() { return pos == end; }
+
+private:
+    const char *pos;
+    const char *end;
+};
+
+static void writeConfig(CacheWriter &w, const Config &config)
+{
+    w.pod(config.number);
+    w.pod(config.valid);
+    w.str(config.name);
+    w.str(config.includeDeviceId);
+    w.str(config.excludeDeviceId);
+    w.pod(config.options.debug);
+    w.pod(config.options.flipZy);
+    w.pod(config.options.flipAltWinOnAppleKeyboards);
+    w.pod(config.options.LControlLWinBlocksAlphaMapping);
+    w.pod(config.options.processOnlyFirstKeyboard);
+    w.pod(config.options.delayForKeySequenceMS);
+    w.pod(config.options.tappingTermMS);
+    w.pod(config.options.chordTermMS);
+    w.pod(config.options.composeTermMS);
+    w.pod(config.compileTimeUS);
+
+    w.count(config.messages.size());
+    for (const ConfigMessage &message : config.messages)
+    {
+        w.pod((int)message.type);
+        w.str(message.text);
+    }
+
+    const AllMaps &maps = config.maps;
+    w.raw(maps.rewiremap, sizeof(maps.rewiremap));
+    w.raw(maps.alphamap, sizeof(maps.alphamap));
+    w.raw(maps.comboIndex, sizeof(maps.comboIndex));
+
+    w.count(maps.modCombos.size());
+    for (const ModifierCombo &combo : maps.modCombos)
+    {
+        w.pod(combo.vkey);
+        w.pod(combo.deadkey);
+        w.pod(combo.modAnd);
+        w.pod(combo.modOr);
+        w.pod(combo.modNot);
+        w.pod(combo.modTap);
+        w.count(combo.keySequence.ops.size());
+        w.raw(combo.keySequence.ops.data(), combo.keySequence.ops.size() * sizeof(SeqOp));
+    }
+
+    w.count(maps.comboMatches.size());
+    for (const AllMaps::ComboMatch &match : maps.comboMatches)
+    {
+        w.pod(match.deadkey);
+        w.pod(match.modAnd);
+        w.pod(match.modOr);
+        w.pod(match.modNot);
+        w.pod(match.modTap);
+        w.pod(match.combo);
+    }
+
+    w.count(maps.chords.size());
+    for (const AllMaps::Chord &chord : maps.chords)
+    {
+        w.raw(chord.keys, sizeof(chord.keys));
+        w.pod(chord.size);
+        w.count(chord.keySequence.ops.size());
+        w.raw(chord.keySequence.ops.data(), chord.keySequence.ops.size() * sizeof(SeqOp));
+    }
+    w.raw(maps.chordsOfKey, sizeof(maps.chordsOfKey));
+    w.raw(maps.chordsOfSize, sizeof(maps.chordsOfSize));
+    w.raw(maps.layerKeys, sizeof(maps.layerKeys));
+
+    w.raw(maps.composeColumn, sizeof(maps.composeColumn));
+    w.pod(maps.composeColumns);
+    w.count(maps.composeNext.size());
+    w.raw(maps.composeNext.data(), maps.composeNext.size() * sizeof(unsigned short));
+    w.count(maps.composeNodes.size());
+    w.raw(maps.composeNodes.data(), maps.composeNodes.size() * sizeof(AllMaps::ComposeNode));
+    w.count(maps.composeSequences.size());
+    for (const KeySequence &sequence : maps.composeSequences)
+    {
+        w.count(sequence.ops.size());
+        w.raw(sequence.ops.data(), sequence.ops.size() * sizeof(SeqOp));
+    }
+
+    w.raw(maps.compiled.keys, sizeof(maps.compiled.keys));
+    w.count(maps.compiled.comboNodes.size());
+    for (const ComboDecisionNode &node : maps.compiled.comboNodes)
+    {
+        w.pod(node.bit);
+        w.pod(node.ifClear);
+        w.pod(node.ifSet);
+    }
+}
+
+static shared_ptr<const Config> readConfig(CacheReader &r)
+{
+    shared_ptr<Config> config = make_shared<Config>();
+    config->number = r.pod<int>();
+    config->valid = r.pod<bool>();
+    config->name = r.str();
+    config->includeDeviceId = r.str();
+    config->excludeDeviceId = r.str();
+    config->options.debug = r.pod<bool>();
+    config->options.flipZy = r.pod<bool>();
+    config->options.flipAltWinOnAppleKeyboards = r.pod<bool>();
+    config->options.LControlLWinBlocksAlphaMapping = r.pod<bool>();
+    config->options.processOnlyFirstKeyboard = r.pod<bool>();
+    config->options.delayForKeySequenceMS = r.pod<int>();
+    config->options.tappingTermMS = r.pod<int>();
+    config->options.chordTermMS = r.pod<int>();
+    config->options.composeTermMS = r.pod<int>();
+    config->compileTimeUS = r.pod<unsigned long>();
+
+    config->messages.resize(r.count(sizeof(int)));
+    for (ConfigMessage &message : config->messages)
+    {
+        message.type = (CONFIG_MESSAGE_TYPE)r.pod<int>();
+        message.text = r.str();
+    }
+
+    AllMaps &maps = config->maps;
+    r.raw(maps.rewiremap, sizeof(maps.rewiremap));
+    r.raw(maps.alphamap, sizeof(maps.alphamap));
+    r.raw(maps.comboIndex, sizeof(maps.comboIndex));
+
+    maps.modCombos.resize(r.count(sizeof(int)));
+    for (ModifierCombo &combo : maps.modCombos)
+    {
+        combo.vkey = r.pod<int>();
+        combo.deadkey = r.pod<unsigned char>();
+        combo.modAnd = r.pod<unsigned short>();
+        combo.modOr = r.pod<unsigned short>();
+        combo.modNot = r.pod<unsigned short>();
+        combo.modTap = r.pod<unsigned short>();
+        combo.keySequence.ops.resize(r.count(sizeof(SeqOp)));
+        r.raw(combo.keySequence.ops.data(), combo.keySequence.ops.size() * sizeof(SeqOp));
+    }
+
+    maps.comboMatches.resize(r.count(1 + 4 * sizeof(unsigned short) + sizeof(unsigned int)));
+    for (AllMaps::ComboMatch &match : maps.comboMatches)
+    {
+        match.deadkey = r.pod<unsigned char>();
+        match.modAnd = r.pod<unsigned short>();
+        match.modOr = r.pod<unsigned short>();
+        match.modNot = r.pod<unsigned short>();
+        match.modTap = r.pod<unsigned short>();
+        match.combo = r.pod<unsigned int>();
+    }
+
+    maps.chords.resize(r.count(MAX_CHORD_KEYS + 1));
+    for (AllMaps::Chord &chord : maps.chords)
+    {
+        r.raw(chord.keys, sizeof(chord.keys));
+        chord.size = r.pod<unsigned char>();
+        chord.keySequence.ops.resize(r.count(sizeof(SeqOp)));
+        r.raw(chord.keySequence.ops.data(), chord.keySequence.ops.size() * sizeof(SeqOp));
+    }
+    r.raw(maps.chordsOfKey, sizeof(maps.chordsOfKey));
+    r.raw(maps.chordsOfSize, sizeof(maps.chordsOfSize));
+    r.raw(maps.layerKeys, sizeof(maps.layerKeys));
+
+    r.raw(maps.composeColumn, sizeof(maps.composeColumn));
+    maps.composeColumns = r.pod<int>();
+    maps.composeNext.resize(r.count(sizeof(unsigned short)));
+    r.raw(maps.composeNext.data(), maps.composeNext.size() * sizeof(unsigned short));
+    maps.composeNodes.resize(r.count(sizeof(AllMaps::ComposeNode)));
+    r.raw(maps.composeNodes.data(), maps.composeNodes.size() * sizeof(AllMaps::ComposeNode));
+    maps.composeSequences.resize(r.count(sizeof(unsigned int)));
+    for (KeySequence &sequence : maps.composeSequences)
+    {
+        sequence.ops.resize(r.count(sizeof(SeqOp)));
+        r.raw(sequence.ops.data(), sequence.ops.size() * sizeof(SeqOp));
+    }
+
+    r.raw(maps.compiled.keys, sizeof(maps.compiled.keys));
+    maps.compiled.comboNodes.resize(r.count(sizeof(int)));
+    for (ComboDecisionNode &node : maps.compiled.comboNodes)
+    {
+        node.bit = r.pod<unsigned char>();
+        node.ifClear = r.pod<int>();
+        node.ifSet = r.pod<int>();
+    }
+    return config;
+}
+
+bool readConfigCache(const std::string &fileName, unsigned long long iniHash, ConfigCache &cache)
+{
+    MappedFile file(fileName);
+    if (file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    const char *payload = file.data() + sizeof(header);
+    size_t payloadSize = file.size() - sizeof(header);
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header.version != CONFIG_CACHE_VERSION
+        || header.maxVcodes != MAX_VCODES
+        || header.rewireCols != REWIRE_COLS
+        || header.maxConfigs != MAX_CONFIGS
+        || header.buildHash != getBuildHash()
+        || header.iniHash != iniHash
+        || header.payloadSize != payloadSize
+        || header.payloadHash != hashBytes(payload, payloadSize))
+        return false;
+
+    CacheReader r(payload, payloadSize);
+    ConfigCache content;
+    content.iniHash = iniHash;
+    content.sanitizedIniContent.assign(r.str());
+    for (int i = 0; i < MAX_CONFIGS; i++)
+        if (r.pod<bool>())
+            content.configs[i] = readConfig(r);
+
+    if (!r.ok || !r.atEnd())
+        return false;
+    cache = move(content);
+    return true;
+}
+
+bool writeConfigCache(const std::string &fileName, const ConfigCache &cache)
+{
+    CacheWriter w;
+    w.str(cache.sanitizedIniContent.getText());
+    for (int i = 0; i < MAX_CONFIGS; i++)
+    {
+        w.pod((bool)cache.configs[i]);
+        if (cache.configs[i])
+            writeConfig(w, *cache.configs[i]);
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CONFIG_CACHE_VERSION;
+    header.maxVcodes = MAX_VCODES;
+    header.rewireCols = REWIRE_COLS;
+    header.maxConfigs = MAX_CONFIGS;
+    header.buildHash = getBuildHash();
+    header.iniHash = cache.iniHash;
+    header.payloadSize = w.buffer.size();
+    header.payloadHash = hashBytes(w.buffer.data(), w.buffer.size());
+
+    //unique temp name: two capsicains (or two engines) may write the same cache at once
+    string tmpName = fileName + ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+    {
+        ofstream f(tmpName, ios::binary | ios::trunc);
+        f.write((const char *)&header, sizeof(header));
+        f.write(w.buffer.data(), w.buffer.size());
+        if (!f)
+        {
+            f.close();
+            error_code ignored;
+            filesystem::remove(tmpName, ignored);
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmpName, fileName, ec);
+    if (ec)
+    {
+        error_code ignored;
+        filesystem::remove(tmpName, ignored);
+        return false;
+    }
+    return true;
+}
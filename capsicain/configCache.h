@@ -0,0 +1,30 @@
+#pragma once
+
+// Binary cache of the compiled configs, stored next to the ini as <ini>.cache (e.g. capsicain.ini.cache).
+// It is keyed by a hash of the ini text. If the ini did not change since the cache was written,
+// the engine maps the cache file and takes the sanitized ini and all compiled configs from it,
+// instead of normalizing, checking and parsing every section again.
+// Any mismatch (ini edited, other cache format, other capsicain build) only means the ini is parsed
+// as usual and the cache is rewritten once all configs are compiled.
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "engine.h"
+
+#define CONFIG_CACHE_VERSION 8  //increase whenever the layout of the cache or of the compiled config changes
+
+unsigned long long hashIniText(std::string_view iniText);
+std::string getConfigCacheFileName(const std::string &iniFileName);
+
+struct ConfigCache
+{
+    unsigned long long iniHash = 0;
+    IniContent sanitizedIniContent;
+    std::shared_ptr<const Config> configs[MAX_CONFIGS];  //null if not compiled
+};
+
+//false if the file is missing, damaged, or written by another build or for another ini text
+bool readConfigCache(const std::string &fileName, unsigned long long iniHash, ConfigCache &cache);
+//writes to a temp file first, so a reader never sees a half written cache
+bool writeConfigCache(const std::string &fileName, const ConfigCache &cache);
@@ -6,12 +6,9 @@
 #include <fstream>
 #include <sstream>
 #include <iterator>
-#include <windows.h>
-#include <tlhelp32.h>
 #include <algorithm>
 
 #include "configUtils.h"
-#include "capsicain.h"
 #include "constants.h"
 #include "utils.h"
 #include "scancodes.h"
@@ -19,34 +16,125 @@
 
 using namespace std;
 
-//cut comments, tab to space, trim, single blanks, lowercase
+static thread_local std::ostream *configLogStream = nullptr;
+
+std::ostream &configLog()
+{
+    return configLogStream ? *configLogStream : cout;
+}
+
+void setConfigLog(std::ostream *log)
+{
+    configLogStream = log;
+}
+
+//cut comments, tab to space, trim, single blanks, lowercase. Appends the result to out in one pass.
+static void appendNormalizedLine(string &out, string_view line)
+{
+    bool blankPending = false;
+    bool empty = true;
+    for (char c : line)
+    {
+        if (c == '#')
+            break;
+        if (c == ' ' || c == '\t' || c == '\r')  //\r: CRLF ini read on a non-Windows system
+        {
+            blankPending = !empty;
+            continue;
+        }
+        if (blankPending)
+            out += ' ';
+        out += (char)::tolower((unsigned char)c);
+        blankPending = false;
+        empty = false;
+    }
+}
+
 void normalizeLine(string &line)
 {
-    auto idxComment = line.find_first_of('#');
-    if (string::npos != idxComment)
-        line.erase(idxComment);
+    string normalized;
+    appendNormalizedLine(normalized, line);
+    line = normalized;
+}
+
+IniLine tokenizeIniLine(std::string_view line)
+{
+    IniLine tokens = { line, line, string_view() };
+    size_t idx = line.find(' ');
+    if (idx != string_view::npos)
+    {
+        tokens.keyword = line.substr(0, idx);
+        tokens.rest = line.substr(idx + 1);
+    }
+    return tokens;
+}
+
+//split the sanitized text into lines, tokenize them and index the sections
+void IniContent::assign(std::string sanitizedText)
+{
+    text = make_shared<const string>(move(sanitizedText));
+    lines.clear();
+    sections.clear();
+
+    string_view all = *text;
+    IniSection *openSection = nullptr;
+    size_t pos = 0;
+    while (pos < all.size())
+    {
+        size_t eol = all.find('\n', pos);
+        if (eol == string_view::npos)
+            eol = all.size();
+        string_view line = all.substr(pos, eol - pos);
+        pos = eol + 1;
+        if (line.empty())
+            continue;
 
-    std::replace(line.begin(), line.end(), '\t', ' ');
+        if (line[0] == '[')  //any [ ends the current section
+        {
+            if (openSection)
+                openSection->end = lines.size();
+            openSection = nullptr;
+            size_t close = line.find(']');
+            if (close != string_view::npos)
+            {
+                //the first of two sections with the same name wins
+                auto added = sections.emplace(line.substr(1, close - 1), IniSection{ lines.size() + 1, lines.size() + 1 });
+                if (added.second)
+                    openSection = &added.first->second;
+            }
+        }
+        lines.push_back(tokenizeIniLine(line));
+    }
+    if (openSection)
+        openSection->end = lines.size();
+}
 
-    line.erase(0, line.find_first_not_of(' '));
-    line.erase(line.find_last_not_of(' ') + 1);
+void IniContent::clear()
+{
+    assign("");
+}
 
-    std::string::size_type pos;
-    while ((pos = line.find("  ")) != std::string::npos)
-        line.replace(pos, 2, " ");
+const std::string &IniContent::getText() const
+{
+    static const string empty;
+    return text ? *text : empty;
+}
 
-    std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+const IniSection *IniContent::findSection(std::string_view sectionName) const
+{
+    auto section = sections.find(sectionName);
+    return section == sections.end() ? nullptr : &section->second;
 }
 
-int checkSyntax(std::vector<string> iniLines)
+int checkSyntax(const IniContent &ini)
 {
     int errors = 0;
     bool inAlpha = false;
-    for (std::vector<std::string>::iterator t = iniLines.begin(); t != iniLines.end(); t++) 
+    for (const IniLine &line : ini.lines)
     {
-        if (stringStartsWith(*t, "alpha_from"))
+        if (stringStartsWith(line.text, "alpha_from"))
             inAlpha = true;
-        else if (stringStartsWith(*t, "alpha_end"))
+        else if (stringStartsWith(line.text, "alpha_end"))
         {
             inAlpha = false;
             continue;
@@ -55,58 +143,79 @@ int checkSyntax(std::vector<string> iniLines)
             continue;
 
         if (
-            stringStartsWith(*t, "[") ||
-            stringStartsWith(*t, "global") ||
-            stringStartsWith(*t, "include") ||
-            stringStartsWith(*t, "rewire") ||
-            stringStartsWith(*t, "combo") ||
-            stringStartsWith(*t, "option")
+            stringStartsWith(line.text, "[") ||
+            stringStartsWith(line.text, "global") ||
+            stringStartsWith(line.text, "include") ||
+            stringStartsWith(line.text, "rewire") ||
+            stringStartsWith(line.text, "combo") ||
+            stringStartsWith(line.text, "chord") ||
+            stringStartsWith(line.text, "layer") ||
+            stringStartsWith(line.text, "compose") ||
+            stringStartsWith(line.text, "option")
             )
             continue;
 
-        std::cout << "Syntax error: Unknown keyword: " << *t << std::endl;
+        std::cout << "Syntax error: Unknown keyword: " << line.text << std::endl;
         errors++;
     }
     return errors;
 }
 
-// Read .ini file, normalize lines, drop empty lines, drop [Reference* sections
-bool readSanitizeIniFile(std::vector<string> &iniLines)
+// Normalize lines, drop empty lines, drop [Reference* sections. One pass over the text.
+// Returns the number of syntax errors
+int sanitizeIni(std::string_view iniText, IniContent &ini)
 {
-    iniLines.clear();
-    string line;
+    string text;
+    text.reserve(iniText.size());
     bool inReferenceSection = false;
-    ifstream f("capsicain.ini");
-    if (!f.is_open())
-        return false;
-
     bool detectBom = true;  //that nasty UTF BOM that MS loves so much...
-    while (getline(f, line)) 
+    size_t pos = 0;
+    while (pos < iniText.size())
     {
+        size_t eol = iniText.find('\n', pos);
+        if (eol == string_view::npos)
+            eol = iniText.size();
+        string_view rawLine = iniText.substr(pos, eol - pos);
+        pos = eol + 1;
+
         if (detectBom)
         {
             detectBom = false;
-            int i = 0;
-            while (i < line.length() && line[i] < 0)
-                line[i++] = 32;
+            size_t i = 0;
+            while (i < rawLine.size() && rawLine[i] < 0)
+                i++;
+            rawLine.remove_prefix(i);
         }
-        normalizeLine(line);
-        if (line == "")
+
+        size_t lineStart = text.size();
+        appendNormalizedLine(text, rawLine);
+        string_view line(text.data() + lineStart, text.size() - lineStart);
+        if (line.empty())
             continue;
         if (stringStartsWith(line, "[reference"))
             inReferenceSection = true;
-        else if (stringStartsWith(line, "[") && ! stringStartsWith(line, "[ "))
+        else if (stringStartsWith(line, "[") && !stringStartsWith(line, "[ "))
             inReferenceSection = false;
-        if(!inReferenceSection)
-            iniLines.push_back(line);
+        if (inReferenceSection)
+            text.resize(lineStart);
+        else
+            text += '\n';
     }
 
-    if (f.bad())
+    ini.assign(move(text));
+    return checkSyntax(ini);
+}
+
+// Read .ini file, normalize lines, drop empty lines, drop [Reference* sections
+bool readSanitizeIniFile(IniContent &ini, std::string fileName)
+{
+    MappedFile file(fileName);
+    if (!file.isOpen())
     {
-        cout << "Error while reading .ini file";
+        ini.clear();
         return false;
     }
-    int numErrors = checkSyntax(iniLines);
+    int numErrors = sanitizeIni(string_view(file.data(), file.size()), ini);
     if (numErrors>0)
         cout << "**** There are " << numErrors << " errors in your ini file ****";
     return true;
@@ -114,104 +223,87 @@ bool readSanitizeIniFile(std::vector<string> &iniLines)
 
 
 //Returns empty vector if section does not exist, or is empty
-std::vector<std::string> getSectionFromIni(std::string sectionName, std::vector<std::string> iniContent)
+std::vector<IniLine> getSectionFromIni(std::string sectionName, const IniContent &ini)
 {
-    std::vector<std::string> sectionContent;
-    string sectName = stringToLower(sectionName);
-    string line;
-    bool inSection = false;
-
-    for (string line : iniContent)
-    {
-
-        if (stringStartsWith(line, "[" + sectName + "]"))
-            inSection = true;
-        else if (inSection)
-        {
-            if (stringStartsWith(line, "["))
-                break;
-            sectionContent.push_back(line);
-        }
-    }
-    if (inSection && sectionContent.size() == 0)
-        sectionContent.push_back("option configname empty_layer_do_nothing");
-    return sectionContent;
+    static const IniLine emptySection = tokenizeIniLine("option configname empty_layer_do_nothing");
+    const IniSection *section = ini.findSection(stringToLower(sectionName));
+    if (!section)
+        return {};
+    if (section->begin == section->end)
+        return { emptySection };
+    return std::vector<IniLine>(ini.lines.begin() + section->begin, ini.lines.begin() + section->end);
 }
 //Returns all lines starting with tag, with the tag removed, or empty vector if none
-std::vector<std::string> getTaggedLinesFromIni(std::string tag, std::vector<std::string> iniContent)
+std::vector<IniLine> getTaggedLinesFromIni(std::string tag, const std::vector<IniLine> &iniLines)
 {
-    std::vector<std::string> taggedContent;
+    std::vector<IniLine> taggedContent;
     tag = stringToLower(tag);
-    string line;
-    for (string line : iniContent)
+    for (const IniLine &line : iniLines)
     {
-        if (stringCopyFirstToken(line) == tag)
-            taggedContent.push_back(stringGetRestBehindFirstToken(line));
+        if (line.keyword == tag)
+            taggedContent.push_back(tokenizeIniLine(line.rest));
     }
     return taggedContent;
 }
 
-bool configHasKey(string key, vector<string> sectionLines)
+bool configHasKey(string key, const std::vector<IniLine> &sectionLines)
 {
     key = stringToLower(key);
-    for (string line : sectionLines)
+    for (const IniLine &line : sectionLines)
     {
-        if (stringCopyFirstToken(line) == key)
+        if (line.keyword == key)
             return true;
     }
     return false;
 }
 
-bool configHasTaggedKey(std::string tag, std::string key, std::vector<std::string> sectionLines)
+bool configHasTaggedKey(std::string tag, std::string key, const std::vector<IniLine> &sectionLines)
 {
     tag = stringToLower(tag);
     key = stringToLower(key);
-    for (string line : sectionLines)
+    for (const IniLine &line : sectionLines)
     {
-        if (stringCopyFirstToken(line) == tag
-            && stringCopyFirstToken(stringGetRestBehindFirstToken(line)) == key)
+        if (line.keyword == tag
+            && tokenizeIniLine(line.rest).keyword == key)
             return true;
     }
     return false;
 }
 
-bool getStringValueForTaggedKey(string tag, string key, std::string &value, vector<string> sectionLines)
+bool getStringValueForTaggedKey(string tag, string key, std::string &value, const std::vector<IniLine> &sectionLines)
 {
     tag = stringToLower(tag);
     key = stringToLower(key);
-    vector<string> splitline;
     value = "";
-    for (string line : sectionLines)
+    for (const IniLine &line : sectionLines)
     {
-        splitline = stringSplit(line, ' ');
-        if (splitline.size() < 3)
+        IniLine keyValue = tokenizeIniLine(line.rest);
+        if (keyValue.rest.empty())
             continue;
-        if (splitline.at(0) == tag && splitline.at(1) == key)
+        if (line.keyword == tag && keyValue.keyword == key)
         {
-            for (int i = 2; i < splitline.size(); i++)
-                value += splitline.at(i) + " ";
-            normalizeLine(value);
+            value = keyValue.rest;
             return true;
         }
     }
     return false;
 }
 
-bool getStringValueForKey(std::string key, std::string &value, vector<string> sectionLines)
+bool getStringValueForKey(std::string key, std::string &value, const std::vector<IniLine> &sectionLines)
 {
     key = stringToLower(key);
-    for (string line : sectionLines)
+    for (const IniLine &line : sectionLines)
     {
-        if (stringStartsWith(line, key))
+        if (stringStartsWith(line.text, key))
         {
-            value = stringGetRestBehindFirstToken(line);
+            value = line.rest;
             return true;
         }
     }
     return false;
 }
 
-bool getIntValueForTaggedKey(string tag, string key, int &value, vector<string> sectionLines)
+bool getIntValueForTaggedKey(string tag, string key, int &value, const std::vector<IniLine> &sectionLines)
 {
     string strval;
     if (!getStringValueForTaggedKey(tag, key, strval, sectionLines))
@@ -220,7 +312,7 @@ bool getIntValueForTaggedKey(string tag, string key, int &value, vector<string>
     return stringToInt(strval, value);
 }
 
-bool getIntValueForKey(std::string key, int &value, vector<std::string> sectionLines)
+bool getIntValueForKey(std::string key, int &value, const std::vector<IniLine> &sectionLines)
 {
     key = stringToLower(key);
     string strval;
@@ -232,7 +324,7 @@ bool getIntValueForKey(std::string key, int &value, vector<std::string> sectionL
 
 
 // parse "a b c ALPHA_TO x y z"
-bool parseKeywordsAlpha_FromTo(std::string alpha_to, int (&alphamap)[MAX_VCODES], std::string scLabels[])
+bool parseKeywordsAlpha_FromTo(std::string alpha_to, int (&alphamap)[MAX_VCODES])
 {
     size_t idx1 = alpha_to.find(stringToLower(INI_TAG_ALPHA_TO));
     if (idx1 == string::npos)
@@ -245,22 +337,22 @@ bool parseKeywordsAlpha_FromTo(std::string alpha_to, int (&alphamap)[MAX_VCODES]
     vector<string> sto = stringSplit(tmpto, ' ');
     if (sfrom.size() == 0 || sfrom.size() != sto.size())
     {
-        cout << endl << "ERROR: " << INI_TAG_ALPHA_FROM << " and " << INI_TAG_ALPHA_TO << " lists are different size";
+        configLog() << endl << "ERROR: " << INI_TAG_ALPHA_FROM << " and " << INI_TAG_ALPHA_TO << " lists are different size";
         return false;
     }
 
     for (int i = 0; i < sfrom.size(); i++)
     {
-        int ifrom = getVcode(sfrom[i], scLabels);
-        int ito = getVcode(sto[i], scLabels);
+        int ifrom = getVcode(sfrom[i]);
+        int ito = getVcode(sto[i]);
         if (ifrom < 0 || ito < 0)
         {
-            cout << endl << "Unknown scancode labels: " << sfrom[i] << " and " << sto[i];
+            configLog() << endl << "Unknown scancode labels: " << sfrom[i] << " and " << sto[i];
             return false;
         }
         if (alphamap[ifrom] != ifrom)
         {
-            cout << endl << "WARNING: Ignoring redefinition of alpha key: " << sfrom[i] << " to " << sto[i];
+            configLog() << endl << "WARNING: Ignoring redefinition of alpha key: " << sfrom[i] << " to " << sto[i];
         }
         alphamap[(unsigned char)ifrom] = (unsigned char)ito;
     }
@@ -269,33 +361,58 @@ bool parseKeywordsAlpha_FromTo(std::string alpha_to, int (&alphamap)[MAX_VCODES]
 
 // parse "REWIRE A B"  or  "REWIRE A B C D". Does not touch optional keys that are not defined in the line.
 // the // symbol stands for -1 "do nothing with this"
-bool parseKeywordRewire(std::string line, int &keyA, int &keyB, int &keyC, int &keyD, std::string scLabels[])
+static int getTapHoldMode(const string &label)
+{
+    if (label == "speculative") return TAPHOLD_SPECULATIVE;
+    if (label == "deferred") return TAPHOLD_DEFERRED;
+    if (label == "holdonkey") return TAPHOLD_HOLDONKEY;
+    if (label == "permissive") return TAPHOLD_PERMISSIVE;
+    return -1;
+}
+
+bool parseKeywordRewire(std::string line, int &keyA, int &keyB, int &keyC, int &keyD, int &tappingTermMS, int &tapHoldMode)
 {
     vector<string> labels = stringSplit(line, ' ');
+
+    //the last tokens, in any order: tapping term like 180ms, tap-hold mode like permissive
+    int termMS = -1;
+    int mode = -1;
+    while (labels.size() >= 3)
+    {
+        const string &last = labels.back();
+        if (termMS < 0 && last.size() > 2 && last.size() <= 7 && last.compare(last.size() - 2, 2, "ms") == 0
+            && last.find_first_not_of("0123456789") == last.size() - 2)
+            termMS = stoi(last);
+        else if (mode < 0 && getTapHoldMode(last) >= 0)
+            mode = getTapHoldMode(last);
+        else
+            break;
+        labels.pop_back();
+    }
     if (labels.size() < 2 && labels.size() > 4)
     {
-        cout << endl << "ERROR: REWIRE must have 2..4 tokens: " << line;
+        configLog() << endl << "ERROR: REWIRE must have 2..4 tokens: " << line;
         return false;
     }
 
-    int ikeyA = getVcode(labels[0], scLabels);
-    int ikeyB = getVcode(labels[1], scLabels);
+    int ikeyA = getVcode(labels[0]);
+    int ikeyB = getVcode(labels[1]);
     int ikeyC;
     int ikeyD;
 
     bool hasTapConfig = labels.size() >= 3 && labels[2] != "//";
     if (hasTapConfig)
-        ikeyC = getVcode(labels[2], scLabels);
+        ikeyC = getVcode(labels[2]);
 
     bool hasTapHoldConfig = labels.size() >= 4 && labels[3] != "//";
     if (hasTapHoldConfig)
-        ikeyD = getVcode(labels[3], scLabels);
+        ikeyD = getVcode(labels[3]);
 
     if (ikeyA < 0 || ikeyB < 0 || (hasTapConfig && ikeyC < 0) || (hasTapHoldConfig && ikeyD < 0) )
         return false; //invalid key label
     if (ikeyA > 255 && ikeyA != VK_CPS_PAUSE)
     {
-        cout << endl << "INFO: rewiring a virtual key (other than PAUSE) does not make sense. Your keyboard never sends VKeys";
+        configLog() << endl << "INFO: rewiring a virtual key (other than PAUSE) does not make sense. Your keyboard never sends VKeys";
         return false;
     }
 
@@ -305,6 +422,10 @@ bool parseKeywordRewire(std::string line, int &keyA, int &keyB, int &keyC, int &
         keyC = ikeyC;
     if (hasTapHoldConfig)
         keyD = ikeyD;
+    if (termMS >= 0)
+        tappingTermMS = termMS;
+    if (mode >= 0)
+        tapHoldMode = mode;
 
     return true;
 }
@@ -323,7 +444,7 @@ unsigned short parseModString(string modString, char filter)
     return std::stoi(binString, nullptr, 2);
 }
 
-bool parseFunctionCombo(std::string funcParams, std::string * scLabels, std::vector<VKeyEvent> &strokeSeq)
+bool parseFunctionCombo(std::string funcParams, KeySequence &strokeSeq)
 {
     //fix 'NP+ + X'
     bool nppFound = stringReplace(funcParams, "np+", "np@");
@@ -334,20 +455,21 @@ bool parseFunctionCombo(std::string funcParams, std::string * scLabels, std::vec
                 labels[i] = "np+";
 
     int isc;
+    size_t start = strokeSeq.size();
     for (string label : labels)
     {
-        isc = getVcode(label, scLabels);
+        isc = getVcode(label);
         if (isc < 0)
             return false;
-        strokeSeq.push_back({ (unsigned char)isc, true });
+        strokeSeq.press((unsigned char)isc);
     }
     size_t len = strokeSeq.size();
-    for (size_t i = len; i > 0; i--)	//copy upstrokes in reverse order
-        strokeSeq.push_back({ strokeSeq.at(i - 1).vcode,false });
+    for (size_t i = len; i > start; i--)	//copy upstrokes in reverse order
+        strokeSeq.release(getSeqArg(strokeSeq.ops.at(i - 1)));
     return true;
 }
 
-bool parseFunctionModdedkey(std::string funcParams, std::string  scLabels[], std::vector<VKeyEvent> &strokeSeq)
+bool parseFunctionModdedkey(std::string funcParams, KeySequence &strokeSeq)
 {
     //fix 'NP+ + X'
     bool nppFound = stringReplace(funcParams, "np+", "np@");
@@ -359,53 +481,51 @@ bool parseFunctionModdedkey(std::string funcParams, std::string  scLabels[], std
     string param0 = modKeyParams[0];
     if (nppFound)
         param0 = "np+";
-    int vkey = getVcode(param0, scLabels);
+    int vkey = getVcode(param0);
     if (vkey < 0)
         return false;
 
-    strokeSeq.push_back({ VK_CPS_TEMPRELEASEKEYS, true });
+    strokeSeq.add(SEQ_TEMPRELEASEKEYS);
 
     int modsPress = parseModString(modKeyParams[1], '&'); //and (press if up)
                                                           //now disabling the ^ character. All mods are always released
     unsigned short testObsoleteReleaseChar = parseModString(modKeyParams[1], '^'); //not (release if down)
     if (testObsoleteReleaseChar > 0)
     {
-        cout << endl << "WARNING: the '^' release key symbol is now ignored in moddedKey(). All modifiers are always released for moddedKey()";
+        configLog() << endl << "WARNING: the '^' release key symbol is now ignored in moddedKey(). All modifiers are always released for moddedKey()";
     }
 
     //send all "&" modifier down 
     for (int i = 0; i<8; i++)
     {
-        int currentMod = modsPress & (1 << i);
-        if (currentMod > 0)
+        if (modsPress & (1 << i))
         {
-            int mod = getModifierForBitmask(currentMod);
-            strokeSeq.push_back({ mod, true });
+            int mod = getModifierForBit(i);
+            strokeSeq.press(mod);
         }
     }
 
-    strokeSeq.push_back({ (unsigned char)vkey, true });
-    strokeSeq.push_back({ (unsigned char)vkey, false });
+    strokeSeq.press((unsigned char)vkey);
+    strokeSeq.release((unsigned char)vkey);
 
     //send all "&" modifier up
     for (int i = 0; i < 8; i++)
     {
-        int currentMod = modsPress & (1 << i);
-        if (currentMod > 0)
+        if (modsPress & (1 << i))
         {
-            int mod = getModifierForBitmask(currentMod);
-            strokeSeq.push_back({ mod, false });
+            int mod = getModifierForBit(i);
+            strokeSeq.release(mod);
         }
     }
 
-    strokeSeq.push_back({ VK_CPS_TEMPRESTOREKEYS, false });
+    strokeSeq.add(SEQ_TEMPRESTOREKEYS);
     return true;
 }
 
 //parse {deadkey-x} keyLabel  [&|^t ....] > function(param)
 //returns false if the rule is not valid.
 //this translates functions() in the .ini to key sequences (usually with special VK_CPS keys)
-bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std::vector<VKeyEvent> &strokeSequence, std::string scLabels[])
+bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], KeySequence &strokeSequence)
 {
     string strkey = stringCutFirstToken(line);
     if (strkey.length() < 1)
@@ -417,7 +537,7 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
         strkey = strkey.substr(8);
         if (strkey.length() < 1)
             return false;
-        deadKey = getVcode(strkey, scLabels);
+        deadKey = getVcode(strkey);
         if (deadKey < 0 || deadKey > 255)
             return false;
 
@@ -426,7 +546,7 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
             return false;
     }
 
-    int itmpKey = getVcode(strkey, scLabels);
+    int itmpKey = getVcode(strkey);
     if (itmpKey < 0)
         return false;
     key = itmpKey;
@@ -445,23 +565,98 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
     mods[3] = parseModString(mod, '^'); //not 
     mods[4] = parseModString(mod, 't'); //tap
 
+    return parseRuleResult(line, strokeSequence);
+}
+
+// split "J K > func()" into the keys and "func()"
+static bool parseRuleKeys(std::string line, std::vector<int> &keys, std::string &ruleResult)
+{
+    size_t idx = line.find('>');
+    if (idx == string::npos)
+    {
+        configLog() << endl << "ERROR in ini: missing '>' in: " << line;
+        return false;
+    }
+    for (const string &label : stringSplit(line.substr(0, idx), ' '))
+    {
+        if (label.empty())
+            continue;
+        int key = getVcode(label);
+        if (key < 1 || key > 255)
+            return false;
+        keys.push_back(key);
+    }
+    ruleResult = line.substr(idx);
+    ruleResult.erase(std::remove(ruleResult.begin(), ruleResult.end(), ' '), ruleResult.end());
+    return true;
+}
+
+// parse "J K > func()". The keys are pressed together, within the chord term
+bool parseKeywordChord(std::string line, std::vector<int> &keys, KeySequence &strokeSequence)
+{
+    vector<int> chordKeys;
+    string ruleResult;
+    if (!parseRuleKeys(line, chordKeys, ruleResult))
+        return false;
+    for (size_t i = 1; i < chordKeys.size(); i++)
+    {
+        if (find(chordKeys.begin(), chordKeys.begin() + i, chordKeys[i]) != chordKeys.begin() + i)
+        {
+            configLog() << endl << "ERROR: CHORD has a key twice: " << line;
+            return false;
+        }
+    }
+    if (chordKeys.size() < 2 || chordKeys.size() > MAX_CHORD_KEYS)
+    {
+        configLog() << endl << "ERROR: CHORD must have 2.." << MAX_CHORD_KEYS << " keys: " << line;
+        return false;
+    }
+
+    if (!parseRuleResult(ruleResult, strokeSequence))
+        return false;
+    keys = chordKeys;
+    return true;
+}
+
+// parse "APPS F Y > func()". The keys are typed one after the other, within the compose term
+bool parseKeywordCompose(std::string line, std::vector<int> &keys, KeySequence &strokeSequence)
+{
+    vector<int> composeKeys;
+    string ruleResult;
+    if (!parseRuleKeys(line, composeKeys, ruleResult))
+        return false;
+    if (composeKeys.size() < 2 || composeKeys.size() > MAX_COMPOSE_KEYS)
+    {
+        configLog() << endl << "ERROR: COMPOSE must have 2.." << MAX_COMPOSE_KEYS << " keys: " << line;
+        return false;
+    }
+
+    if (!parseRuleResult(ruleResult, strokeSequence))
+        return false;
+    keys = composeKeys;
+    return true;
+}
+
+// parse the "> func(params)" part of a COMBO, CHORD or COMPOSE line, without spaces
+bool parseRuleResult(std::string line, KeySequence &strokeSequence)
+{
     //extract function name + param
     size_t funcIdx1 = line.find_first_of('>') + 1;
-    if (funcIdx1 == string::npos || funcIdx1 < 2)
+    if (funcIdx1 == 0)  //no '>'
     {
-        cout << endl << "ERROR in ini: missing '>' in: " << line;
+        configLog() << endl << "ERROR in ini: missing '>' in: " << line;
         return false;
     }
     size_t funcIdx2 = line.find_first_of('(');
     if (funcIdx2 == string::npos || funcIdx2 < funcIdx1 + 2)
     {
-        cout << endl << "ERROR in ini: missing '(' in: " << line;
+        configLog() << endl << "ERROR in ini: missing '(' in: " << line;
         return false;
     }
     size_t funcIdx3 = line.find_first_of(')');
     if (funcIdx3 == string::npos || funcIdx3 < funcIdx2 + 1)
     {
-        cout << endl << "ERROR in ini: missing ')' in: " << line;
+        configLog() << endl << "ERROR in ini: missing ')' in: " << line;
         return false;
     }
     string funcName = line.substr(funcIdx1, funcIdx2 - funcIdx1);
@@ -469,18 +664,17 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
     string funcParams = line.substr(funcIdx2, funcIdx3 - funcIdx2);
 
     //translate 'function' into a key sequence
-    vector<VKeyEvent> strokeSeq;
+    KeySequence strokeSeq;
     if (funcName == "key")
     {
-        int isc = getVcode(funcParams, scLabels);
+        int isc = getVcode(funcParams);
         if (isc < 0)
             return false;
-        strokeSeq.push_back({ isc, true });
-        strokeSeq.push_back({ isc, false });
+        strokeSeq.pressRelease(isc);
     }
     else if (funcName == "combo")
     {
-        if (!parseFunctionCombo(funcParams, scLabels, strokeSeq))
+        if (!parseFunctionCombo(funcParams, strokeSeq))
             return false;
     }
     else if (funcName == "combontimes")
@@ -490,18 +684,18 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
             return false;
         string combo = funcParams.substr(0, idx);
         string stime = funcParams.substr(idx + 1);
-        if (!parseFunctionCombo(combo, scLabels, strokeSeq))
-            return false;
         int times = stoi(stime);
-        auto len = strokeSeq.size();
-        for (int j = 1; j < times; j++)
-            for (int i = 0; i < len; i++)
-                strokeSeq.push_back(strokeSeq.at(i));
+        if (times > 1)
+            strokeSeq.add(SEQ_REPEAT, times);
+        if (!parseFunctionCombo(combo, strokeSeq))
+            return false;
+        if (times > 1)
+            strokeSeq.add(SEQ_REPEAT_END);
     }
     else if (funcName == "altchar")
     {
-        strokeSeq.push_back({ VK_CPS_TEMPRELEASEKEYS, true }); //temp release LSHIFT if it is currently down
-        strokeSeq.push_back({ SC_LALT , true });
+        strokeSeq.add(SEQ_TEMPRELEASEKEYS); //temp release LSHIFT if it is currently down
+        strokeSeq.press(SC_LALT);
         for (int i = 0; i < funcParams.length(); i++)
         {
             char c = funcParams[i];
@@ -518,18 +712,17 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
             else
                 return false;
 
-            int isc = getVcode(altkey, scLabels);
+            int isc = getVcode(altkey);
             if (isc < 0)
                 return false;
-            strokeSeq.push_back({ (unsigned char)isc, true });
-            strokeSeq.push_back({ (unsigned char)isc, false });
+            strokeSeq.pressRelease((unsigned char)isc);
         }
-        strokeSeq.push_back({ SC_LALT , false });
-        strokeSeq.push_back({ VK_CPS_TEMPRESTOREKEYS, false });
+        strokeSeq.release(SC_LALT);
+        strokeSeq.add(SEQ_TEMPRESTOREKEYS);
     }
     else if (funcName == "moddedkey")
     {
-        if (!parseFunctionModdedkey(funcParams, scLabels, strokeSeq))
+        if (!parseFunctionModdedkey(funcParams, strokeSeq))
             return false;
     }
     else if (funcName == "sequence")
@@ -553,7 +746,7 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
 
             if (stringStartsWith(param, "pause:"))
             {
-                cout << endl << "WARNING: '_pause:10_' is now written as '_sleep:1000_'." << endl << "Ignoring " << param;
+                configLog() << endl << "WARNING: '_pause:10_' is now written as '_sleep:1000_'." << endl << "Ignoring " << param;
                 continue;
             }
             //handle the "sleep:10" items
@@ -563,16 +756,15 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
                 int stime = stoi(sleeptime);
                 if (stime > 30000)
                 {
-                    cout << endl << "Sequence() defines sleep: > 30000 Reducing to 30000 (30 seconds)";
+                    configLog() << endl << "Sequence() defines sleep: > 30000 Reducing to 30000 (30 seconds)";
                     stime = 30000;
                 }
                 if (stime <= 0)
                 {
-                    cout << endl << "Sequence() defines sleep: <=0. Ignoring the pause.";
+                    configLog() << endl << "Sequence() defines sleep: <=0. Ignoring the pause.";
                     continue;
                 }
-                strokeSeq.push_back({ VK_CPS_SLEEP, true });
-                strokeSeq.push_back({ stime, true });
+                strokeSeq.add(SEQ_SLEEP, stime);
                 continue;
             }
             //handle the "configswitch:2" items
@@ -580,32 +772,31 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
                 string configParam = param.substr(CONFIGSWITCH_TAG.length());
                 int configuration = stoi(configParam);
                 if (configuration > 9) {
-                    cout << endl << "Sequence() defines configswitch: > 9. Not switching.";
+                    configLog() << endl << "Sequence() defines configswitch: > 9. Not switching.";
                     continue;
                 }
                 if (configuration < 0) {
-                    cout << endl << "Sequence() defines configswitch: < 0. Not switching.";
+                    configLog() << endl << "Sequence() defines configswitch: < 0. Not switching.";
                     continue;
                 }
-                strokeSeq.push_back({VK_CPS_CONFIGSWITCH, true});
-                strokeSeq.push_back({configuration, true});
+                strokeSeq.add(SEQ_CONFIGSWITCH, configuration);
                 continue;
             }
-            int isc = getVcode(param, scLabels);
+            int isc = getVcode(param);
             if (isc < 0)
             {
-                cout << endl << "WARNING: Unknown key label in sequence(): " << param;
+                configLog() << endl << "WARNING: Unknown key label in sequence(): " << param;
                 return false;
             }
 
             if (downstroke)
             {
-                strokeSeq.push_back({ (unsigned char)isc, true });
+                strokeSeq.press((unsigned char)isc);
                 downkeys[(unsigned char)isc] = true;
             }
             if (upstroke)
             {
-                strokeSeq.push_back({ (unsigned char)isc, false });
+                strokeSeq.release((unsigned char)isc);
                 downkeys[(unsigned char)isc] = false;
             }
         }
@@ -614,18 +805,17 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
         {
             if (downkeys[i])
             {
-                cout << endl << "Sequence() does not release key: " << scLabels[i] << " (discarding this rule)";
+                configLog() << endl << "Sequence() does not release key: " << PRETTY_VK_LABELS[i] << " (discarding this rule)";
                 return false;
             }
         }
     }
     else if (funcName == "deadkey")
     {
-        int isc = getVcode(funcParams, scLabels);
+        int isc = getVcode(funcParams);
         if (isc < 0 || isc > 255)
             return false;
-        strokeSeq.push_back({ VK_CPS_DEADKEY, true });
-        strokeSeq.push_back({ isc, true });
+        strokeSeq.add(SEQ_DEADKEY, isc);
     }
     else if ( ((funcName == "configswitch")) || (funcName == "layerswitch"))
     {
@@ -633,15 +823,14 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
         bool valid = stringToInt(funcParams, isc);
         if (!valid || isc < 0 || isc > 10)
         {
-            cout << endl << "Invalid config switch to: " << funcParams;
+            configLog() << endl << "Invalid config switch to: " << funcParams;
             return false;
         }
-        strokeSeq.push_back({ VK_CPS_CONFIGSWITCH, true });
-        strokeSeq.push_back({ isc, true });
+        strokeSeq.add(SEQ_CONFIGSWITCH, isc);
     }
     else if ((funcName == "configprevious") || (funcName == "layerprevious"))
     {
-        strokeSeq.push_back({ VK_CPS_CONFIGPREVIOUS, true });
+        strokeSeq.press(VK_CPS_CONFIGPREVIOUS);
     }
     else if (funcName == "recordmacro" || funcName == "recordsecretmacro" || funcName == "playmacro")
     {
@@ -649,18 +838,16 @@ bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std
         bool valid = stringToInt(funcParams, macroNum);
         if (!valid || macroNum < 1 || macroNum >= MAX_NUM_MACROS)
         {
-            cout << endl <<  "Invalid macro number : " << funcParams << " (must be 1.."<< MAX_NUM_MACROS-1 <<")";
+            configLog() << endl <<  "Invalid macro number : " << funcParams << " (must be 1.."<< MAX_NUM_MACROS-1 <<")";
             return false;
         }
 
         if(funcName == "recordmacro")
-            strokeSeq.push_back({ VK_CPS_RECORDMACRO, true });
+            strokeSeq.add(SEQ_RECORDMACRO, macroNum);
         else if (funcName == "recordsecretmacro")
-            strokeSeq.push_back({ VK_CPS_RECORDSECRETMACRO, true });
+            strokeSeq.add(SEQ_RECORDSECRETMACRO, macroNum);
         else if (funcName == "playmacro")
-            strokeSeq.push_back({ VK_CPS_PLAYMACRO, true });
-
-        strokeSeq.push_back({ macroNum, true });
+            strokeSeq.add(SEQ_PLAYMACRO, macroNum);
     }
     else 
         return false;
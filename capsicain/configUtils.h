@@ -1,7 +1,12 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <unordered_map>
+#include <ostream>
 #include "constants.h"
+#include "keySequence.h"
 
 const int CPS_ESC_SEQUENCE_TYPE_TEMPALTERMODIFIERS = 1;
 const int CPS_ESC_SEQUENCE_TYPE_SLEEP = 2;
@@ -12,17 +17,62 @@ struct VKeyEvent
     bool isDownstroke = true;
 };
 
-bool readSanitizeIniFile(std::vector<std::string>& iniLines);
-
-std::vector<std::string> getSectionFromIni(std::string sectionName, std::vector<std::string> iniContent);
-std::vector<std::string> getTaggedLinesFromIni(std::string tag, std::vector<std::string> iniContent);
-bool configHasKey(std::string key, std::vector<std::string> iniLines);
-bool configHasTaggedKey(std::string tag, std::string key, std::vector<std::string> sectionLines);
-bool getStringValueForTaggedKey(std::string tag, std::string key, std::string & value, std::vector<std::string> sectionLines);
-bool getStringValueForKey(std::string key, std::string & value, std::vector<std::string> sectionLines);
-bool getIntValueForTaggedKey(std::string tag, std::string key, int & value, std::vector<std::string> sectionLines);
-bool getIntValueForKey(std::string key, int & value, std::vector<std::string> sectionLines);
-bool parseFunctionModdedkey(std::string& funcParams, std::string  scLabels[], std::vector<VKeyEvent>& strokeSeq, bool& retflag);
-bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], std::vector<VKeyEvent> &strokeSequence, std::string scLabels[]);
-bool parseKeywordsAlpha_FromTo(std::string mapFromTo, int(&alphamap)[MAX_VCODES], std::string scLabels[]);
-bool parseKeywordRewire(std::string line, int & keyA, int & keyB, int & keyC, int & keyD, std::string scLabels[]);
+//parser warnings go to cout, or to the stream set for the current thread (the engine collects them per config)
+std::ostream &configLog();
+void setConfigLog(std::ostream *log);
+
+// The sanitized ini: all lines normalized (see normalizeLine) and stored in one shared buffer, without
+// empty lines and [reference*] sections. Lines are handed out as string_views into that buffer, already split
+// into their first token and the rest. The sections are indexed by name while the ini is read, so looking up
+// a section (e.g. for every INCLUDE) does not scan the ini again.
+// Copies are cheap and share the buffer; views stay valid as long as any copy is alive.
+struct IniLine
+{
+    std::string_view text;     //the whole line
+    std::string_view keyword;  //first token
+    std::string_view rest;     //behind the first token, may be empty
+};
+
+struct IniSection
+{
+    size_t begin;  //first line behind the [header]
+    size_t end;    //one behind the last line
+};
+
+struct IniContent
+{
+    std::vector<IniLine> lines;
+
+    size_t size() const { return lines.size(); }
+    void clear();
+    //takes sanitized lines separated by \n
+    void assign(std::string sanitizedText);
+    const std::string &getText() const;
+    const IniSection *findSection(std::string_view sectionName) const;
+
+private:
+    std::shared_ptr<const std::string> text;
+    std::unordered_map<std::string_view, IniSection> sections;
+};
+
+IniLine tokenizeIniLine(std::string_view line);
+
+bool readSanitizeIniFile(IniContent &ini, std::string fileName = "capsicain.ini");
+int sanitizeIni(std::string_view iniText, IniContent &ini);
+
+std::vector<IniLine> getSectionFromIni(std::string sectionName, const IniContent &ini);
+std::vector<IniLine> getTaggedLinesFromIni(std::string tag, const std::vector<IniLine> &iniLines);
+bool configHasKey(std::string key, const std::vector<IniLine> &sectionLines);
+bool configHasTaggedKey(std::string tag, std::string key, const std::vector<IniLine> &sectionLines);
+bool getStringValueForTaggedKey(std::string tag, std::string key, std::string & value, const std::vector<IniLine> &sectionLines);
+bool getStringValueForKey(std::string key, std::string & value, const std::vector<IniLine> &sectionLines);
+bool getIntValueForTaggedKey(std::string tag, std::string key, int & value, const std::vector<IniLine> &sectionLines);
+bool getIntValueForKey(std::string key, int & value, const std::vector<IniLine> &sectionLines);
+bool parseFunctionModdedkey(std::string funcParams, KeySequence &strokeSeq);
+bool parseKeywordCombo(std::string line, int &key, unsigned short(&mods)[5], KeySequence &strokeSequence);
+bool parseKeywordChord(std::string line, std::vector<int> &keys, KeySequence &strokeSequence);
+bool parseKeywordCompose(std::string line, std::vector<int> &keys, KeySequence &strokeSequence);
+bool parseRuleResult(std::string line, KeySequence &strokeSequence);
+bool parseKeywordsAlpha_FromTo(std::string mapFromTo, int(&alphamap)[MAX_VCODES]);
+//'in out [tap|//] [taphold|//] [term] [mode]', term like '180ms', mode speculative|deferred|holdonkey|permissive
+bool parseKeywordRewire(std::string line, int & keyA, int & keyB, int & keyC, int & keyD, int & tappingTermMS, int & tapHoldMode);
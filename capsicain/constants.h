@@ -6,6 +6,8 @@
 #define MAX_VCODES 0x121  //biggest defined code in scancodes.h must be smaller than this
 #define MAX_MACRO_LENGTH 200  //stop recording at some point if it was forgotten.
 #define MAX_NUM_MACROS 21 //max number of stored macros (mapped later to 1..20, and the 'hard' macro 0)
+#define MAX_CONFIGS 11  //config_0 .. config_10; 0 is the disabled config
+#define MAX_INCLUDE_DEPTH 16  //INCLUDE in an included section; stops include loops
 
 //constants
 #define DISABLED_CONFIG_NUMBER  0 // layer 0 does nothing
@@ -13,6 +15,12 @@
 #define AHK_HOTKEY1 SC_F14  //this key triggers supporting AHK script
 #define AHK_HOTKEY2 SC_F15
 
+//files written by ESC commands
+#define LATENCY_FILE_NAME "capsicain.latency.txt"
+#define FLIGHT_FILE_NAME "capsicain.flight.txt"
+#define TRACE_FILE_NAME "capsicain.trace.json"
+#define CAPTURE_FILE_NAME "capsicain.capture"
+
 //defaults
 #define DEFAULT_ACTIVE_CONFIG 1
 #define DEFAULT_ACTIVE_CONFIG_NAME "Config not initialized. Forwarding all keys."
@@ -22,19 +30,44 @@
 #define DEFAULT_DELAY_FOR_AHK_MS 50    //autohotkey is slow
 
 //rewiremap columns
-#define REWIRE_COLS 4
+#define REWIRE_COLS 6
 #define REWIRE_ROWS MAX_VCODES
 //#define REWIRE_IN  0 IN is the row index
 #define REWIRE_OUT 0
 #define REWIRE_TAP 1
 #define REWIRE_DOUBLETAP 2
 #define REWIRE_TAPHOLD 3
+#define REWIRE_TAPPINGTERM 4  //not a key: tapping term of this key in ms
+#define REWIRE_TAPHOLDMODE 5  //not a key: TAPHOLD_ mode of this key, -1 = TAPHOLD_SPECULATIVE
+
+//how a key with IfTapped decides between tap and hold, see Engine::holdBackStroke()
+#define TAPHOLD_SPECULATIVE 0  //press the hold key at once, take it back when the key is tapped
+#define TAPHOLD_DEFERRED 1     //hold back the key and all keys after it until it is released (tap) or its tapping term runs out (hold)
+#define TAPHOLD_HOLDONKEY 2    //like DEFERRED, and pressing another key meanwhile is a hold
+#define TAPHOLD_PERMISSIVE 3   //like DEFERRED, and tapping another key meanwhile (press and release) is a hold
+#define TAPHOLD_LOOKAHEAD_SIZE 16  //strokes held back at most; a full lookahead decides hold
+#define DEFAULT_TAPPING_TERM_MS 200  //for the held back keys, when neither REWIRE nor OPTION TappingTermMS set a term
+#define TAPHOLD_DECIDED_TAP 1
+#define TAPHOLD_DECIDED_HOLD 2
+
+#define MAX_CHORDS 64  //per config; one bit each in AllMaps::chordsOfKey
+#define MAX_CHORD_KEYS 4
+#define DEFAULT_CHORD_TERM_MS 30  //all keys of a chord must be down within this time
+
+#define MAX_LAYERS 8  //momentary layers on top of each other, per keyboard
+
+#define MAX_COMPOSE_KEYS 8  //longest COMPOSE sequence
+#define MAX_COMPOSE_NODES 65535  //per config; nodes of the compose trie are unsigned short
+#define DEFAULT_COMPOSE_TERM_MS 1000  //at most this long from one key of a compose sequence to the next
 
 const std::string INI_TAG_INCLUDE = "INCLUDE";
 const std::string INI_TAG_GLOBAL = "GLOBAL";
 const std::string INI_TAG_OPTIONS = "OPTION";
 const std::string INI_TAG_REWIRE = "REWIRE";
 const std::string INI_TAG_COMBOS = "COMBO";
+const std::string INI_TAG_CHORDS = "CHORD";
+const std::string INI_TAG_LAYERS = "LAYER";
+const std::string INI_TAG_COMPOSE = "COMPOSE";
 const std::string INI_TAG_ALPHA_FROM = "ALPHA_FROM";
 const std::string INI_TAG_ALPHA_TO = "ALPHA_TO";
 const std::string INI_TAG_ALPHA_END = "ALPHA_END";
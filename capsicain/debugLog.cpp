@@ -0,0 +1,212 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "debugLog.h"
+#include "engine.h"
+#include "utils.h"
+
+using namespace std;
+
+DebugLog::DebugLog()
+{
+    logger = thread(&DebugLog::runLogger, this);
+}
+
+DebugLog::~DebugLog()
+{
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        stop = true;
+    }
+    wakeLogger.notify_one();
+    logger.join();
+}
+
+void DebugLog::write(DEBUG_RECORD type, int a0, int a1, int a2, int a3, int a4)
+{
+    size_t h = head.load(memory_order_relaxed);
+    if (h - tail.load(memory_order_acquire) >= DEBUG_LOG_SIZE)
+    {
+        dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    ring[h & (DEBUG_LOG_SIZE - 1)] = { type, { a0, a1, a2, a3, a4 } };
+    head.store(h + 1, memory_order_seq_cst);
+    //the logger only sleeps after a long pause; the first record after it needs a wake up
+    if (loggerSleeping.load(memory_order_seq_cst))
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        wakeLogger.notify_one();
+    }
+}
+
+void DebugLog::flush()
+{
+    size_t h = head.load(memory_order_relaxed);
+    if (tail.load(memory_order_acquire) == h)
+        return;
+    unique_lock<mutex> lock(wakeMutex);
+    flushRequested = true;
+    wakeLogger.notify_one();
+    printed.wait(lock, [this, h] { return tail.load(memory_order_acquire) >= h; });
+    flushRequested = false;
+}
+
+void DebugLog::runLogger()
+{
+    //one stream for all records, so hex / dec carry over from record to record like they did on cout
+    ostringstream out;
+    int idlePolls = 0;
+    while (true)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        size_t h = head.load(memory_order_acquire);
+        if (t != h)
+        {
+            for (; t != h; t++)
+                format(out, ring[t & (DEBUG_LOG_SIZE - 1)]);
+            unsigned int lost = dropped.exchange(0, memory_order_relaxed);
+            if (lost > 0)
+                out << endl << "(debug log full: " << dec << lost << " lines dropped)";
+            cout << out.str() << std::flush;
+            out.str("");
+            tail.store(t, memory_order_release);
+            idlePolls = 0;
+            if (flushRequested)
+            {
+                lock_guard<mutex> lock(wakeMutex);
+                printed.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock<mutex> lock(wakeMutex);
+        if (stop)
+            return;
+        if (idlePolls < DEBUG_LOG_IDLE_POLLS)
+        {
+            idlePolls++;
+            wakeLogger.wait_for(lock, chrono::milliseconds(DEBUG_LOG_POLL_MS), [this] { return stop || flushRequested; });
+        }
+        else
+        {
+            loggerSleeping.store(true, memory_order_seq_cst);
+            wakeLogger.wait(lock, [this] { return stop || flushRequested || head.load(memory_order_seq_cst) != tail.load(memory_order_relaxed); });
+            loggerSleeping = false;
+            idlePolls = 0;
+        }
+    }
+}
+
+//the same text the engine printed directly before
+void DebugLog::format(ostream &out, const DebugRecord &record)
+{
+    const int *a = record.args;
+    switch (record.type)
+    {
+    case DEBUG_IDLE_KEY:
+        out << ". ";
+        break;
+    case DEBUG_IGNORE_SECOND_BOARD:
+        out << endl << "Ignore 2nd board (" << a[0] << ") scancode: " << a[1];
+        break;
+    case DEBUG_IGNORE_NOT_INCLUDED:
+        out << endl << "Ignore board, deviceId is not included with this config";
+        break;
+    case DEBUG_IGNORE_EXCLUDED:
+        out << endl << "Ignore board, deviceId is excluded in this config";
+        break;
+    case DEBUG_HARD_ESC:
+        out << endl << "(Hard ESC" << (a[0] ? "v " : "^ ") << ")";
+        break;
+    case DEBUG_STOP_RECORDING:
+        out << endl << "Stop recording macro #" << a[0];
+        break;
+    case DEBUG_REWIRED_TO_NOP:
+        out << " (r2NOP)";
+        break;
+    case DEBUG_INPUT:
+        out << endl
+            << "(" << setw(5) << dec << a[0] << " m) "
+            << " ["
+            << hex << setw(2) << a[1] << " " << a[2]
+            << "= " << setw(8) << (a[4] == a[3] ? "" : string(PRETTY_VK_LABELS[a[3]]) + " > ")
+            << setw(8) << getPrettyVKLabel(a[4]) << setw(2) << left << getSymbolForIKStrokeState((unsigned short)a[2]) << right
+            << "] ";
+        break;
+    case DEBUG_MODIFIERS:
+        out << "[M:" << setw(4) << (a[0] > 0 ? stringIntToHex(a[0], 0) : "")
+            << " T:" << setw(4) << (a[1] > 0 ? stringIntToHex(a[1], 0) : "")
+            << " D:" << setw(6) << (a[2] > 0 ? getPrettyVKLabel(a[2]) : "")
+            << "] ";
+        break;
+    case DEBUG_MAPPING_TIME:
+        out << "  (" << setw(5) << dec << a[0] << " u)";
+        break;
+    case DEBUG_TAP_STATE:
+        out << (a[0] ? " (tap slow)" : "");
+        out << (a[1] ? " (tap)" : "");
+        IFTRACE if (a[2])
+            out << " (TapHold:" << hex << a[3] << ")";
+        if (a[4] >= 0)
+            out << " (TapHoldKey: " << hex << a[4] << ")";
+        break;
+    case DEBUG_TAPPING_TERM_EXPIRED:
+        out << endl << "tapping term expired: " << PRETTY_VK_LABELS[a[0]] << " is held";
+        break;
+    case DEBUG_HELD_BACK:
+        out << endl << "held back: " << PRETTY_VK_LABELS[a[0]] << (a[1] ? " down" : " up") << " (" << dec << a[2] << " waiting)";
+        break;
+    case DEBUG_TAPHOLD_DECIDED:
+        out << endl << PRETTY_VK_LABELS[a[0]] << (a[1] ? " is tapped" : " is held") << ", replaying the held back keys";
+        break;
+    case DEBUG_CHORD:
+        out << endl << "chord: " << PRETTY_VK_LABELS[a[0]] << " + " << PRETTY_VK_LABELS[a[1]] << (a[2] > 2 ? " + ..." : "");
+        break;
+    case DEBUG_COMPOSE:
+        out << endl << "compose: " << PRETTY_VK_LABELS[a[0]] << " .. " << PRETTY_VK_LABELS[a[1]] << " (" << a[2] << " strokes)";
+        break;
+    case DEBUG_LAYER:
+        if (a[1] != 0)
+            out << endl << "layer on: " << PRETTY_VK_LABELS[a[0]] << " -> config " << a[1] << " (" << a[2] << " layers)";
+        else
+            out << endl << "layer off: " << PRETTY_VK_LABELS[a[0]] << " (" << a[2] << " layers)";
+        break;
+    case DEBUG_PAUSE_KEY:
+        out << endl << "INFO: Pause key combo (E1 LCTRL NUMLOCK) -> virtual key PAUSE";
+        break;
+    case DEBUG_RESULT_KEY:
+        if (a[0] != a[1])
+            out << "  --  " << PRETTY_VK_LABELS[a[1]] << getSymbolForIKStrokeState((unsigned short)a[2]);
+        else
+            out << "  -->";
+        break;
+    case DEBUG_SEQUENCE:
+        out << "  --> SEQUENCE (" << dec << a[0] << ")  ";
+        break;
+    case DEBUG_START_RECORDING:
+        out << endl << "Start recording " << (a[1] ? "secret" : "") << "macro #" << a[0] << endl;
+        break;
+    case DEBUG_SEND_E4:
+        out << " {sending E4} ";
+        break;
+    case DEBUG_BLOCKED_UP:
+        out << " {blocked " << PRETTY_VK_LABELS[a[0]] << " UP: was not down.}";
+        break;
+    case DEBUG_BLOCKED_NOP:
+        out << endl << "{blocked NOP}";
+        break;
+    case DEBUG_WINKEY_NO_MENU:
+        out << " { test WINKEY NO MENU send shift down up" << "}";
+        break;
+    case DEBUG_SENT:
+        out << " {" << PRETTY_VK_LABELS[a[0]] << (a[1] ? "v" : "^") << " #" << a[2] << "}";
+        break;
+    case DEBUG_SHIFT_DOWN_UP:
+        out << " { LSHFv^ to deactivateWinkeyStartmenu } ";
+        break;
+    }
+}
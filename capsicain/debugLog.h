@@ -0,0 +1,85 @@
+#pragma once
+
+// Debug output of the key pipeline, off the key thread.
+// The engine thread writes fixed size binary records into a lock-free single producer / single consumer ring.
+// A logger thread formats them and prints them with cout, so debug mode costs the key thread a few stores per line
+// instead of the formatting and the console write (which made key processing ~100x slower).
+// While keys come in, the logger polls the ring; after a second without records it sleeps until the next one.
+// A full ring drops records (never blocks the key thread) and the logger reports how many were lost.
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ostream>
+
+enum DEBUG_RECORD
+{
+    DEBUG_IDLE_KEY = 0,             //key while config 0 is active
+    DEBUG_IGNORE_SECOND_BOARD,      //device, scancode
+    DEBUG_IGNORE_NOT_INCLUDED,
+    DEBUG_IGNORE_EXCLUDED,
+    DEBUG_HARD_ESC,                 //isDownstroke
+    DEBUG_STOP_RECORDING,           //macro number
+    DEBUG_REWIRED_TO_NOP,
+    DEBUG_INPUT,                    //ms since the previous key, stroke code, stroke state, scancode, vcode
+    DEBUG_MODIFIERS,                //modifierDown, modifierTapped, activeDeadkey
+    DEBUG_MAPPING_TIME,             //microseconds
+    DEBUG_TAP_STATE,                //tappedSlow, tapped, tapHoldMake, stroke code, tap-and-hold scancode or -1
+    DEBUG_TAPPING_TERM_EXPIRED,     //scancode
+    DEBUG_HELD_BACK,                //scancode, isDownstroke, strokes held back
+    DEBUG_TAPHOLD_DECIDED,          //scancode, tapped
+    DEBUG_CHORD,                    //first key, second key, number of keys
+    DEBUG_COMPOSE,                  //first key, last key, strokes held back
+    DEBUG_LAYER,                    //layer key, config (0: layer released), layers on the stack
+    DEBUG_PAUSE_KEY,
+    DEBUG_RESULT_KEY,               //scancode, vcode, stroke state
+    DEBUG_SEQUENCE,                 //sequence size
+    DEBUG_START_RECORDING,          //macro number, isSecret
+    DEBUG_SEND_E4,
+    DEBUG_BLOCKED_UP,               //scancode
+    DEBUG_BLOCKED_NOP,
+    DEBUG_WINKEY_NO_MENU,
+    DEBUG_SENT,                     //vcode, isDownstroke, keysDownSentCounter
+    DEBUG_SHIFT_DOWN_UP,
+};
+
+#define DEBUG_RECORD_ARGS 5
+#define DEBUG_LOG_SIZE 4096  //records; power of two
+#define DEBUG_LOG_POLL_MS 10
+#define DEBUG_LOG_IDLE_POLLS 100  //polls without records before the logger waits to be woken up
+
+struct DebugRecord
+{
+    DEBUG_RECORD type;
+    int args[DEBUG_RECORD_ARGS];
+};
+
+class DebugLog
+{
+public:
+    DebugLog();
+    ~DebugLog();  //prints everything that is still in the ring
+
+    //key thread only
+    void write(DEBUG_RECORD type, int a0 = 0, int a1 = 0, int a2 = 0, int a3 = 0, int a4 = 0);
+    //blocks until everything written so far is printed. Use before direct cout output, to keep the order.
+    void flush();
+
+private:
+    DebugRecord ring[DEBUG_LOG_SIZE];
+    alignas(64) std::atomic<size_t> head{ 0 };  //next record to write; only the key thread writes it
+    alignas(64) std::atomic<size_t> tail{ 0 };  //next record to print; only the logger writes it
+    std::atomic<bool> loggerSleeping{ false };
+    std::atomic<bool> flushRequested{ false };
+    std::atomic<unsigned int> dropped{ 0 };
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeLogger;
+    std::condition_variable printed;
+    bool stop = false;
+    std::thread logger;
+
+    void runLogger();
+    static void format(std::ostream &out, const DebugRecord &record);
+};
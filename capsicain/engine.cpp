@@ -0,0 +1,2953 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <sstream>
+
+#include "engine.h"
+#include "configCache.h"
+#include "constants.h"
+#include "modifiers.h"
+#include "scancodes.h"
+#include "utils.h"
+
+using namespace std;
+
+static const struct Globals defaultGlobals;
+static const struct Options defaultOptions;
+static const struct GlobalState defaultGlobalState;
+static const struct ModifierState defaultModifierState;
+static const struct LoopState defaultLoopState;
+
+//identity of a combo rule (vkey, deadkey, and, or, not, tap); used to detect duplicates while parsing
+struct ComboKey
+{
+    int vkey;
+    unsigned short mods[5];
+    bool operator==(const ComboKey &other) const
+    {
+        return vkey == other.vkey && memcmp(mods, other.mods, sizeof(mods)) == 0;
+    }
+};
+struct ComboKeyHash
+{
+    size_t operator()(const ComboKey &k) const
+    {
+        size_t h = k.vkey;
+        for (unsigned short m : k.mods)
+            h = h * 31 + m;
+        return h;
+    }
+};
+
+//the parser functions in configUtils write their warnings to configLog(); while a config is parsed they go
+//into this buffer, and from there into the messages of the config in the order they were written
+static thread_local ostringstream parserLog;
+static void collectParserLog(Config &config)
+{
+    if (parserLog.tellp() > 0)
+    {
+        config.info(parserLog.str());
+        parserLog.str("");
+    }
+}
+
+std::chrono::steady_clock::time_point SteadyClock::now()
+{
+    return std::chrono::steady_clock::now();
+}
+void SteadyClock::sleepMS(unsigned int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+//plain sleeps wake up late by up to a scheduler tick. Sleep until shortly before, then yield until it is time.
+void SteadyClock::sleepUntil(std::chrono::steady_clock::time_point time)
+{
+    const std::chrono::milliseconds spinTime(2);
+    if (time - std::chrono::steady_clock::now() > spinTime)
+        std::this_thread::sleep_until(time - spinTime);
+    while (std::chrono::steady_clock::now() < time)
+        std::this_thread::yield();
+}
+
+Engine::Engine(EngineOutput &output, EngineClock &clock, EngineHost &host)
+    : output(output), clock(clock), host(host), scheduler(output, clock, latency)
+{
+    shared_ptr<Config> empty = make_shared<Config>();
+    initializeAllMaps(empty->maps);
+    currentConfig = empty;
+    options.delayForKeySequenceMS = output.getDefaultKeySequenceDelayMS();
+}
+
+Engine::~Engine()
+{
+    stopCompileWorker();
+}
+
+void Engine::error(string txt)
+{
+    debugLog.flush();
+    cout << endl << "ERROR: " << txt << endl;
+    errorLog += "\r\n" + txt;
+}
+
+string getTimestamp()
+{
+    auto start = std::chrono::system_clock::now();
+    auto legacyStart = std::chrono::system_clock::to_time_t(start);
+    char tmBuff[30];
+#ifdef _WIN32
+    ctime_s(tmBuff, sizeof(tmBuff), &legacyStart);
+#else
+    ctime_r(&legacyStart, tmBuff);
+#endif
+    return tmBuff;
+}
+
+string getPrettyVKLabelPadded(int vcode, int resultLength)
+{
+    string label(PRETTY_VK_LABELS[vcode]);
+    if (resultLength > label.size())
+        label.insert(0, resultLength - label.size(), ' ');
+    return label;
+}
+string getPrettyVKLabel(int vcode)
+{
+    return string(PRETTY_VK_LABELS[vcode]);
+}
+
+void Engine::InterceptionSendCurrentKeystroke()
+{
+    flightRecorder.current().exit = FLIGHT_EXIT_FORWARDED;
+    scheduler.send(interceptionState.interceptionDevice, &interceptionState.currentIKstroke, 1);
+}
+
+bool Engine::loadIni()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!readIni())
+        return false;
+
+    parseIniGlobals();
+    debugLog.flush();
+    IFDEBUG if (configsFromCache) cout << endl << "Compiled configs are loaded from " << getConfigCacheFileName(iniFileName);
+    switchConfig(globals.activeConfigOnStartup, true);
+    profiler.iniLoadTimeUS = (unsigned long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    startCompileWorker();
+    return true;
+}
+
+//read the ini into sanitizedIniContent and forget all compiled configs.
+//If the config cache was written for this exact ini text, the sanitized ini and the compiled configs come from the cache.
+bool Engine::readIni()
+{
+    stopCompileWorker();
+    for (int i = 0; i < MAX_CONFIGS; i++)
+        atomic_store(&compiledConfigs[i], shared_ptr<const Config>());
+    sanitizedIniContent.clear();
+    configsFromCache = false;
+    writeConfigCacheWhenCompiled = false;
+
+    MappedFile iniFile(iniFileName);
+    if (!iniFile.isOpen())
+        return false;
+    string_view iniText(iniFile.data(), iniFile.size());
+    iniHash = hashIniText(iniText);
+
+    ConfigCache cache;
+    if (useConfigCache && readConfigCache(getConfigCacheFileName(iniFileName), iniHash, cache))
+    {
+        sanitizedIniContent = move(cache.sanitizedIniContent);
+        for (int i = 0; i < MAX_CONFIGS; i++)
+            atomic_store(&compiledConfigs[i], cache.configs[i]);
+        configsFromCache = true;
+        return true;
+    }
+
+    int numErrors = sanitizeIni(iniText, sanitizedIniContent);
+    if (numErrors > 0)
+        cout << "**** There are " << numErrors << " errors in your ini file ****";
+    writeConfigCacheWhenCompiled = useConfigCache && numErrors == 0;  //no cache for a broken ini, so the errors show on every start
+    return true;
+}
+
+void Engine::run(EngineInput &input)
+{
+    InterceptionDevice device;
+    InterceptionKeyStroke stroke;
+    while (true)
+    {
+        INPUT_RESULT result = input.receiveUntil(device, stroke, getTimerDeadline());
+        if (result == INPUT_CLOSED)
+            break;
+        if (result == INPUT_TIMEOUT)
+            processTimers(clock.now());
+        else if (result == INPUT_DEVICE_REMOVED)
+            deviceRemoved(device);
+        else if (!processStroke(device, stroke, input.lastStrokeTime()))
+            break;
+    }
+    finishInput();
+    debugLog.flush();
+}
+
+void Engine::flushOutput()
+{
+    scheduler.waitUntilIdle();
+}
+
+void Engine::finishInput()
+{
+    //resolving a held back key can start the next timer (its tapping term), so repeat until none is left
+    for (chrono::steady_clock::time_point deadline = getTimerDeadline(); deadline != chrono::steady_clock::time_point::max(); deadline = getTimerDeadline())
+        processTimers(deadline);
+    flushOutput();
+}
+
+//park the tap history and modifiers of the previous keyboard, take out the ones of this keyboard.
+//Only runs when the keyboard changes, so the pipeline keeps working on interceptionState / modifierState.
+void Engine::switchDeviceState(InterceptionDevice device)
+{
+    if (device < 0 || device > INTERCEPTION_MAX_DEVICE)
+        device = 0;
+    if (device == loadedDevice)
+        return;
+
+    DeviceState &parked = deviceStates[loadedDevice];
+    parked.currentIKstroke = interceptionState.currentIKstroke;
+    parked.previousIKstroke1 = interceptionState.previousIKstroke1;
+    parked.previousIKstroke2 = interceptionState.previousIKstroke2;
+    swap(parked.modifierState, modifierState);
+
+    DeviceState &loaded = deviceStates[device];
+    interceptionState.currentIKstroke = loaded.currentIKstroke;
+    interceptionState.previousIKstroke1 = loaded.previousIKstroke1;
+    interceptionState.previousIKstroke2 = loaded.previousIKstroke2;
+    swap(loaded.modifierState, modifierState);
+    loadedDevice = device;
+}
+
+void Engine::deviceRemoved(InterceptionDevice device)
+{
+    if (device < 1 || device > INTERCEPTION_MAX_DEVICE)
+        return;
+    OutputScheduler::Batch batch(scheduler);
+    //held back keys of this keyboard were never sent; they would come down after it is gone
+    if (device == loadedDevice)
+    {
+        lookahead.key = -1;
+        lookahead.count = 0;
+        lookahead.deadline = chrono::steady_clock::time_point::max();
+        chordState.count = 0;
+        chordState.candidates = 0;
+        chordState.deadline = chrono::steady_clock::time_point::max();
+        composeState.node = 0;
+        composeState.count = 0;
+        composeState.deadline = chrono::steady_clock::time_point::max();
+    }
+    switchDeviceState(device);
+    debugLog.flush();
+    for (int i = 0; i < 255; i++)
+    {
+        if (globalState.keysDownSent[i] && globalState.keysDownSentBy[i] == device)
+            sendVKeyEvent({ i, false });
+    }
+    interceptionState.currentIKstroke = { SC_NOP, 0 };
+    interceptionState.previousIKstroke1 = { SC_NOP, 0 };
+    interceptionState.previousIKstroke2 = { SC_NOP, 0 };
+    modifierState = defaultModifierState;
+    deviceStates[device] = DeviceState();
+    IFDEBUG cout << endl << "keyboard " << device << " removed";
+}
+
+//everything about the current keyboard that does not change from key to key: hardware id, Apple keyboard,
+//GLOBAL DeviceConfig, include/excludeDeviceId. The key loop only looks at the result.
+void Engine::describeDevice(DeviceState &deviceState)
+{
+    deviceState.described = true;
+    deviceState.hardwareId = stringToLower(host.getHardwareId(loadedDevice));
+    const string &id = deviceState.hardwareId;
+    deviceState.isAppleKeyboard = (id.find("vid_05ac") != string::npos) || (id.find("vid&000205ac") != string::npos);
+    globalState.deviceIdKeyboard = id;
+    globalState.deviceIsAppleKeyboard = deviceState.isAppleKeyboard;
+
+    debugLog.flush();
+    IFDEBUG cout << endl << endl << "getHardwareId:" << id << " / Apple keyboard: " << deviceState.isAppleKeyboard;
+
+    deviceState.configNumber = -1;
+    deviceState.config.reset();
+    for (const DeviceConfigRule &rule : globals.deviceConfigs)
+    {
+        if (id.find(rule.deviceIdPart) == string::npos)
+            continue;
+        if (rule.config != DISABLED_CONFIG_NUMBER)
+        {
+            shared_ptr<const Config> config = getCompiledConfig(rule.config);
+            if (!config->valid)
+            {
+                cout << endl << "ERROR: GLOBAL DeviceConfig " << rule.deviceIdPart << ": config " << rule.config << " does not exist";
+                break;
+            }
+            applyConfigOptions(*config);
+            deviceState.config = config;
+        }
+        deviceState.configNumber = rule.config;
+        cout << endl << "keyboard " << id << " uses config " << rule.config
+            << " = " << (deviceState.config ? deviceState.config->name : DISABLED_CONFIG_NAME) << endl;
+        break;
+    }
+
+    const Config &config = deviceState.config ? *deviceState.config : *currentConfig;
+    deviceState.ignoredBy = 0;
+    if (!config.includeDeviceId.empty() && id.find(config.includeDeviceId) == string::npos)
+        deviceState.ignoredBy = DEBUG_IGNORE_NOT_INCLUDED;
+    else if (!config.excludeDeviceId.empty() && id.find(config.excludeDeviceId) != string::npos)
+        deviceState.ignoredBy = DEBUG_IGNORE_EXCLUDED;
+}
+
+//CORE LOOP body
+bool Engine::processStroke(InterceptionDevice device, InterceptionKeyStroke stroke, chrono::steady_clock::time_point strokeTime)
+{
+    //all output of this stroke goes out together
+    OutputScheduler::Batch batch(scheduler);
+
+    //each keyboard has its own tap history and modifier state
+    switchDeviceState(device);
+
+    //remember previous two keys to detect tapping and Pause sequence
+    //convert with convertIkstroke2VKeyEvent(interceptionState.previousIKstroke1) before using, or you get problems with codes >=0x80
+    interceptionState.previousIKstroke2 = interceptionState.previousIKstroke1;
+    interceptionState.previousIKstroke1 = interceptionState.currentIKstroke;
+
+    interceptionState.interceptionDevice = device;
+    interceptionState.currentIKstroke = stroke;
+
+    //timestamps for the latency histograms
+    chrono::steady_clock::time_point receivedAt = clock.now();
+    if (strokeTime == chrono::steady_clock::time_point())
+        strokeTime = receivedAt;
+    //timers that ran out before this stroke, in case the input could not wake us up for them
+    processTimers(strokeTime);
+    profiler.timepointPreviousKeyEvent = profiler.timepointLoopStart;
+    profiler.timepointLoopStart = receivedAt;
+    FlightRecord &flight = flightRecorder.begin(device, stroke, receivedAt, globalState.secretSequenceRecording);
+    flight.config = globalState.activeConfig;
+    if (capture.isActive() && !globalState.secretSequenceRecording)
+        capture.write(device, stroke, strokeTime);  //the time the tapping terms see, so a replay decides the same
+
+    //low level debugging, show incoming raw key
+    IFTRACE printIKStrokeState(interceptionState.currentIKstroke);
+
+    //clear loop state
+    loopState = defaultLoopState;
+    loopState.strokeTime = strokeTime;
+
+    //copy InterceptionKeyStroke (unpleasant to use) to plain VKeyEvent
+    VKeyEvent originalVKeyEvent = convertIkstroke2VKeyEvent(interceptionState.currentIKstroke);
+    loopState.scancode = originalVKeyEvent.vcode;  //scancode is write-once (except for the AppleWinAlt option)
+    loopState.vcode = loopState.scancode;          //vcode may be altered below
+    loopState.isDownstroke = originalVKeyEvent.isDownstroke;
+
+    //if GLOBAL capsicainEnableDisable is configured, it toggles the ON/OFF state
+    if (globals.capsicainOnOffKey != -1)
+    {
+        if (processOnOffKey())
+            return true;
+    }
+    //if disabled, just forward
+    if (!globalState.capsicainOn)
+    {
+        InterceptionSendCurrentKeystroke();
+        return true;
+    }
+
+    IFDEBUG if(globalState.activeConfig == 0) debugLog.write(DEBUG_IDLE_KEY);
+
+    //ignore secondary keyboard?
+    if (options.processOnlyFirstKeyboard 
+        && (interceptionState.previousInterceptionDevice != 0)
+        && (interceptionState.previousInterceptionDevice != interceptionState.interceptionDevice))
+    {
+        IFDEBUG debugLog.write(DEBUG_IGNORE_SECOND_BOARD, interceptionState.interceptionDevice, interceptionState.currentIKstroke.code);
+        InterceptionSendCurrentKeystroke();
+        return true;
+    }
+
+    //device id changed / check for Apple Keyboard
+    DeviceState &deviceState = deviceStates[loadedDevice];
+    if (!deviceState.described)
+        describeDevice(deviceState);
+    if (interceptionState.previousInterceptionDevice == 0    //startup
+        || interceptionState.previousInterceptionDevice != interceptionState.interceptionDevice)  //keyboard changed
+    {
+        globalState.deviceIdKeyboard = deviceState.hardwareId;
+        globalState.deviceIsAppleKeyboard = deviceState.isAppleKeyboard;
+        debugLog.flush();
+        //detail to debug the "new device after sleep, reboot after 10 new devices"
+        cout << endl
+            << "<" << endl
+            << "new keyboard: " << (globalState.deviceIsAppleKeyboard ? "Apple keyboard" : "IBM keyboard") << endl
+            << "new keyboard count: " << ++interceptionState.newKeyboardCounter << endl
+            << "keyboard device id: " << globalState.deviceIdKeyboard << endl
+            << "interceptionDevice: " << interceptionState.interceptionDevice << endl
+            << getTimestamp()
+            << ">" << endl;
+
+        interceptionState.previousInterceptionDevice = interceptionState.interceptionDevice;
+    }
+
+    //the config of this keyboard
+    strokeConfig = deviceState.config ? deviceState.config.get() : currentConfig.get();
+    if (deviceState.configNumber >= 0)
+        flight.config = deviceState.configNumber;
+
+    //sanity check
+    if (interceptionState.currentIKstroke.code >= 0x80)
+    {
+        error("Received unexpected extended Interception Key Stroke code > 0x79: " + to_string(interceptionState.currentIKstroke.code));
+        cout << endl << "Please open a ticket on github";
+        return true;
+    }
+    if (interceptionState.currentIKstroke.code == 0)
+    {
+        error("Received unexpected SC_NOP Key Stroke code 0. Ignoring this.");
+        return true;
+    }
+
+    //ESC Commands
+    if (loopState.scancode == SC_ESCAPE)
+    {
+        IFDEBUG debugLog.write(DEBUG_HARD_ESC, loopState.isDownstroke);
+        globalState.realEscapeIsDown = loopState.isDownstroke;
+
+        //stop macro recording?
+        if (globalState.recordingMacro > 0)
+        {
+            IFDEBUG debugLog.write(DEBUG_STOP_RECORDING, globalState.recordingMacro);
+            //wrap macro in tokens to tmprelease / restore keys, to deal with the physical 'Ctrl down' that started the macro
+            if (globalState.recordedMacros[globalState.recordingMacro].size() > 0)
+                globalState.secretSequenceRecording = false;
+            {
+                KeySequence &macro = globalState.recordedMacros[globalState.recordingMacro];
+                macro.add(SEQ_TEMPRESTOREKEYS);
+                macro.ops.insert(macro.ops.begin(), makeSeqOp(SEQ_TEMPRELEASEKEYS, 0));
+            }
+            globalState.recordingMacro = -1;
+            host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+            return true;
+        }
+    }
+    else if (globalState.realEscapeIsDown && loopState.isDownstroke)
+    {
+        flight.exit = FLIGHT_EXIT_COMMAND;
+        debugLog.flush();
+        return host.processCommand(loopState.scancode);
+    }
+
+    
+    //Config 0: standard keyboard, no further processing, just forward everything
+    if (globalState.activeConfig == DISABLED_CONFIG_NUMBER || deviceState.configNumber == DISABLED_CONFIG_NUMBER)
+    {
+        InterceptionSendCurrentKeystroke();
+        return true;
+    }
+
+    //consider include/exclude deviceID options
+    if (deviceState.ignoredBy != 0)
+    {
+        IFDEBUG debugLog.write((DEBUG_RECORD)deviceState.ignoredBy);
+        InterceptionSendCurrentKeystroke();
+        return true;
+    }
+
+
+
+    //flip Win+Alt only for Apple keyboards.
+    if (options.flipAltWinOnAppleKeyboards && deviceState.isAppleKeyboard)
+    {
+        switch (loopState.vcode)
+        {
+        case SC_LALT: loopState.vcode = SC_LWIN; break;
+        case SC_LWIN: loopState.vcode = SC_LALT; break;
+        case SC_RALT: loopState.vcode = SC_RWIN; break;
+        case SC_RWIN: loopState.vcode = SC_RALT; break;
+        }
+
+        loopState.scancode = loopState.vcode;       //only time where scancode is rewritten. Simplifies tapping and rewiring
+    }
+
+    //Handle Sysrq, ScrLock, Pause, NumLock
+    if (!processMessyKeys())
+        return true;
+    flight.scancode = loopState.scancode;
+    flight.at[FLIGHT_DECODED] = clock.now();
+
+    //layer key, or a key of a layer?
+    if (selectLayer(flight))
+        return true;
+    //part of a chord?
+    if (detectChord(flight, receivedAt))
+        return true;
+    //part of a compose sequence?
+    if (detectCompose(flight, receivedAt))
+        return true;
+    //wait for an undecided tap-hold key?
+    if (holdBackStroke(flight, receivedAt))
+        return true;
+
+    processDecodedStroke(flight, receivedAt);
+    return true;
+}
+
+//back half of the pipeline: tapping, rewire, modifiers, mapping, send.
+//loopState holds the decoded stroke, strokeConfig its config.
+void Engine::processDecodedStroke(FlightRecord &flight, chrono::steady_clock::time_point receivedAt)
+{
+    //Tapdance
+    detectTapping();
+    //slow tap breaks tapping
+    if (loopState.tappedSlow)
+        modifierState.modifierTapped = 0;
+
+    //hard rewire all REWIREd keys
+    processRewireScancodeToVirtualcode();
+    flight.vcodeRewired = loopState.vcode;
+    flight.at[FLIGHT_REWIRED] = clock.now();
+    if (loopState.vcode == SC_NOP)   //rewired to NOP to disable keys
+    {
+        IFDEBUG debugLog.write(DEBUG_REWIRED_TO_NOP);
+        return;
+    }
+
+    IFDEBUG debugLog.write(DEBUG_INPUT, (int)(timeBetweenTimepointsUS(profiler.timepointPreviousKeyEvent, profiler.timepointLoopStart) / 1000),
+        interceptionState.currentIKstroke.code, interceptionState.currentIKstroke.state, loopState.scancode, loopState.vcode);
+
+    //evaluate modifiers
+    processModifierState();
+    flight.modifierDown = modifierState.modifierDown;
+    flight.modifierTapped = modifierState.modifierTapped;
+    flight.activeDeadkey = modifierState.activeDeadkey;
+    flight.at[FLIGHT_MODIFIERS] = clock.now();
+
+    IFDEBUG debugLog.write(DEBUG_MODIFIERS, modifierState.modifierDown, modifierState.modifierTapped, modifierState.activeDeadkey);
+
+    if (interpretConfig)
+    {
+        //evaluate modified keys
+        processCombos();
+
+        //alphakeys: basic character key layout. Don't remap the Ctrl combos?
+        processMapAlphaKeys();
+    }
+    else
+        processCompiledMapping();  //same as the two steps above, one table lookup
+
+    //break tapped state?
+    if (!isModifier(loopState.vcode))
+        modifierState.modifierTapped = 0;
+
+    chrono::steady_clock::time_point decidedAt = clock.now();
+    LATENCY_OUTCOME outcome = getLatencyOutcome();
+    latency.record(LATENCY_DECISION, outcome, decidedAt - receivedAt);
+    IFDEBUG debugLog.write(DEBUG_MAPPING_TIME, (int)timeBetweenTimepointsUS(receivedAt, decidedAt));
+    flight.at[FLIGHT_MAPPED] = decidedAt;
+    flight.outcome = outcome;
+    recordFlightResult(flight);
+
+    //the first stroke that goes out for this key carries the timestamps to the output thread
+    scheduler.tagNextStroke({ receivedAt, decidedAt, outcome, true });
+    sendResultingKeyOrSequence();
+    scheduler.tagNextStroke({});  //nothing was sent (blocked key)
+    flight.at[FLIGHT_QUEUED] = clock.now();
+    flight.exit = FLIGHT_EXIT_MAPPED;
+
+    IFDEBUG debugLog.write(DEBUG_TAP_STATE, loopState.tappedSlow, loopState.tapped, loopState.tapHoldMake,
+        interceptionState.currentIKstroke.code, modifierState.tapState[loopState.scancode] == TAPSTATE_TAPHELD ? loopState.scancode : -1);
+}
+
+bool Engine::processOnOffKey()
+{
+    //handle the @#$ Pause key
+    bool pauseKeyTriggeredOnOff = false;
+    if (globals.capsicainOnOffKey == VK_CPS_PAUSE)
+    {
+        //drop all E1 LCTRL
+        if (interceptionState.currentIKstroke.state > 3
+            && interceptionState.currentIKstroke.code == SC_LCTRL)
+        {
+            IFTRACE cout << endl << "dropping E2 LCTRL";
+            return true;
+        }
+
+        if (loopState.scancode == SC_NUMLOCK
+            && interceptionState.previousIKstroke1.code == SC_LCTRL
+            && interceptionState.previousIKstroke1.state > 3)
+        {
+            pauseKeyTriggeredOnOff = true;
+        }
+    }
+
+    //toggle ON/OFF ?
+    if (loopState.scancode == globals.capsicainOnOffKey || pauseKeyTriggeredOnOff)
+    {
+        if (loopState.isDownstroke)
+        {
+            globalState.capsicainOn = !globalState.capsicainOn;
+            host.updateTrayIcon(globalState.capsicainOn, globalState.recordingMacro >= 0, globalState.activeConfig);
+            if (globalState.capsicainOn)
+            {
+                reset();
+                cout << endl << endl << "[" << getPrettyVKLabel(globals.capsicainOnOffKey) << "] -> Capsicain ON";
+                cout << endl << "active config: " << globalState.activeConfig << " = " << globalState.activeConfigName;
+            }
+            else
+                cout << endl << endl << "[" << getPrettyVKLabel(globals.capsicainOnOffKey) << "] -> Capsicain OFF";
+        }
+        IFTRACE cout << endl << pauseKeyTriggeredOnOff;
+        //forward only the three keys that have LEDs, to signal the state of capsicain
+        if (globals.capsicainOnOffKey == SC_NUMLOCK
+            || globals.capsicainOnOffKey == SC_SCRLOCK
+            || globals.capsicainOnOffKey == SC_CAPS)
+        {
+            IFTRACE cout << "OnOff event: setting LED for: " << getPrettyVKLabel(globals.capsicainOnOffKey);
+            host.setLED(globals.capsicainOnOffKey, globalState.capsicainOn);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+//handle PRINT, SCRLOCK, PAUSE, NUMLOCK, E1, Exit and Break signals
+//return false = drop the key
+bool Engine::processMessyKeys()
+{
+    //Alt+Print = ALTPRINT, map to PRINT?
+    if (loopState.vcode == SC_ALTPRINT)
+    {
+        IFTRACE cout << endl << SC_ALTPRINT;
+        if (globals.translateMessyKeys)
+            loopState.vcode = SC_PRINT;
+    }
+
+    //Ctrl+NumLock -> pause signal
+    if  (globals.protectConsole
+            && loopState.vcode == SC_NUMLOCK
+            && IS_LCTRL_DOWN
+            && host.isConsoleForeground()
+        )
+    {
+        if (loopState.isDownstroke)
+            cout << endl << "INFO: Ctrl+NumLock detected, which is the 'Pause console' signal. Discarding it so capsicain does not freeze.";
+        return false;
+    }
+
+    //Ctrl+ScrLock -> exit signal
+    if  (globals.protectConsole 
+            && loopState.vcode == SC_SCRLOCK
+            && IS_LCTRL_DOWN
+            && host.isConsoleForeground()
+        )
+    {
+        if (loopState.isDownstroke)
+            cout << endl << "INFO: Ctrl+ScrLock detected, which is the 'Exit console' signal. Discarding it so capsicain does not exit.";
+        return false;
+    }
+
+    //Ctrl+Pause produces SC_BREAK = Exit signal
+    if (loopState.vcode == SC_BREAK)
+    {
+        IFTRACE cout << endl << "Ctrl+Pause=BREAK";
+        //drop SC_BREAK ?
+        if (globals.protectConsole
+            && IS_LCTRL_DOWN 
+            && host.isConsoleForeground())
+        {
+            if (loopState.isDownstroke)
+                cout << endl << "INFO: Ctrl+Pause detected, which is the BREAK signal. Discarding it so capsicain does not exit.";
+            return false;
+        }
+
+        //map break to pause
+        if(globals.translateMessyKeys)
+            loopState.vcode = VK_CPS_PAUSE;
+    }
+
+    //translate unmodified pause key sequence to PAUSE (E1 LCTRL NUMLOCK)
+    if (globals.translateMessyKeys)
+    {
+        if (interceptionState.currentIKstroke.state > 3)
+        {
+            if (loopState.vcode == SC_LCTRL)
+            {
+                return false;  //drop the ctrl key
+            }
+            else
+            {
+                cout << endl << endl << "??? Extended escape code not handled. What is this key???"
+                    << "Please open a ticket on github";
+                return false;
+            }
+        }
+
+        if (interceptionState.previousIKstroke1.state > 3)
+        {
+            if (interceptionState.previousIKstroke1.code != SC_LCTRL)
+            {
+                cout << endl << "??? unexpected E1 escape sequence. What kind of key is this?";
+                return false;
+            }
+
+            if (loopState.vcode == SC_NUMLOCK)
+            {
+                IFDEBUG if (loopState.isDownstroke)
+                    debugLog.write(DEBUG_PAUSE_KEY);
+                loopState.vcode = VK_CPS_PAUSE;
+            }
+        }
+    }
+
+    return true;
+}
+
+//index of the only bit set in x (de Bruijn multiplication)
+static int singleBitIndex(unsigned long long x)
+{
+    static const int INDEX[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4, 62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6 };
+    return INDEX[(x * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+//LAYER key config: while the key is held, the compiled config is a layer on top of the config of the keyboard.
+//A key press takes the topmost layer that does something with the key; transparent keys fall through to the
+//layers below, down to the config of the keyboard. The key keeps that config until it is released, so keys that
+//are down while a layer comes or goes are released where they were pressed.
+//Nothing is parsed or reset: modifier and tap state stay, push and pop are a few stores.
+//Returns true if the stroke was a layer key.
+bool Engine::selectLayer(FlightRecord &flight)
+{
+    ModifierState &m = modifierState;
+    int key = loopState.scancode;
+
+    //autorepeat and release of a layer key. The stack is MAX_LAYERS deep at most
+    for (int i = m.layerCount - 1; i >= 0; i--)
+    {
+        if (m.layers[i].key != key)
+            continue;
+        if (!loopState.isDownstroke)
+        {
+            IFDEBUG debugLog.write(DEBUG_LAYER, key, 0, m.layerCount - 1);
+            for (; i < m.layerCount - 1; i++)
+                m.layers[i] = m.layers[i + 1];
+            m.layerCount--;
+        }
+        flight.exit = FLIGHT_EXIT_STOPPED;
+        return true;
+    }
+
+    const Config *config = m.keyConfig[key];
+    if (!loopState.isDownstroke)
+        m.keyConfig[key] = nullptr;
+    else if (!config)  //new press
+    {
+        config = strokeConfig;
+        for (int i = m.layerCount - 1; i >= 0; i--)
+        {
+            if (!m.layers[i].config->maps.compiled.keys[key].transparent)
+            {
+                config = m.layers[i].config;
+                break;
+            }
+        }
+
+        int layer = config->maps.layerKeys[key];
+        if (layer != 0)
+        {
+            flight.exit = FLIGHT_EXIT_STOPPED;
+            const Config *layerConfig = getCompiledConfig(layer).get();  //all compiled configs stay until reset()
+            if (!layerConfig->valid)
+                error("LAYER " + string(PRETTY_VK_LABELS[key]) + ": config " + to_string(layer) + " does not exist");
+            else if (m.layerCount >= MAX_LAYERS)
+                error("Too many layers (max " + to_string(MAX_LAYERS) + "), ignoring LAYER " + string(PRETTY_VK_LABELS[key]));
+            else
+            {
+                m.layers[m.layerCount++] = { (unsigned char)key, layerConfig };
+                IFDEBUG debugLog.write(DEBUG_LAYER, key, layer, m.layerCount);
+            }
+            return true;
+        }
+        m.keyConfig[key] = config;
+    }
+
+    if (config && config != strokeConfig)
+    {
+        strokeConfig = config;
+        flight.config = config->number;
+    }
+    return false;
+}
+
+//CHORD: keys pressed together give something else, like CHORD J K > key(ESC).
+//A key that starts a chord is held back, and so is each next key that still fits one.
+//When all keys of a chord are down (and no longer chord starts with them), the chord is sent; the release of its keys is swallowed.
+//Anything else (a release, a key that fits no chord, the chord term is over) sends a complete chord,
+//or lets the held back keys go on unchanged. Each key costs one AND over the chord bitmasks, however many chords there are.
+//Returns true if the stroke was held back or swallowed.
+bool Engine::detectChord(FlightRecord &flight, chrono::steady_clock::time_point receivedAt)
+{
+    ChordState &cs = chordState;
+    const AllMaps &allMaps = strokeConfig->maps;
+    int key = loopState.scancode;
+    if (cs.count > 0 && !modifierState.usedKeyDown[key])
+    {
+        unsigned long long candidates = cs.candidates & allMaps.chordsOfKey[key];
+        bool isNewPress = loopState.isDownstroke && !modifierState.isKeyDown(key) && loadedDevice == cs.device;
+        for (int i = 0; i < cs.count; i++)
+            if (cs.strokes[i].loop.scancode == key)
+                isNewPress = false;  //autorepeat
+        if (isNewPress && candidates != 0)
+        {
+            cs.strokes[cs.count++] = { loadedDevice, interceptionState.currentIKstroke, loopState, strokeConfig, flight.config, receivedAt, flight.at[FLIGHT_DECODED] };
+            cs.candidates = candidates;
+            flight.exit = FLIGHT_EXIT_HELD;
+            IFDEBUG debugLog.write(DEBUG_HELD_BACK, key, true, cs.count);
+            if (candidates == (candidates & allMaps.chordsOfSize[cs.count]))
+                fireChord(flight);
+            return true;
+        }
+        finishChord();
+    }
+
+    if (modifierState.usedKeyDown[key])  //autorepeat and release of a key of a chord or compose sequence that was sent
+    {
+        if (!loopState.isDownstroke)
+            modifierState.usedKeyDown[key] = false;
+        return true;
+    }
+
+    //a new press of a chord key starts one. Not while a tap-hold key or a compose sequence is held back, their keys must stay in order
+    if (!loopState.isDownstroke || modifierState.isKeyDown(key) || allMaps.chordsOfKey[key] == 0 || lookahead.key >= 0 || composeState.node != 0)
+        return false;
+    cs.device = loadedDevice;
+    cs.candidates = allMaps.chordsOfKey[key];
+    cs.deadline = loopState.strokeTime + chrono::milliseconds(strokeConfig->options.chordTermMS);
+    cs.count = 0;
+    cs.strokes[cs.count++] = { loadedDevice, interceptionState.currentIKstroke, loopState, strokeConfig, flight.config, receivedAt, flight.at[FLIGHT_DECODED] };
+    flight.exit = FLIGHT_EXIT_HELD;
+    IFDEBUG debugLog.write(DEBUG_HELD_BACK, key, true, cs.count);
+    return true;
+}
+
+//the held back keys of a chord cannot get more: send the chord if it is complete, else let them go on unchanged
+void Engine::finishChord()
+{
+    ChordState &cs = chordState;
+    if (cs.count == 0)
+        return;
+    const HeldStroke &last = cs.strokes[cs.count - 1];
+    if ((cs.candidates & last.config->maps.chordsOfSize[cs.count]) != 0)
+    {
+        fireChord(beginFlight(last));
+        return;
+    }
+    vector<HeldStroke> held(cs.strokes, cs.strokes + cs.count);
+    cs.count = 0;
+    cs.candidates = 0;
+    cs.deadline = chrono::steady_clock::time_point::max();
+    replayHeldStrokes(held, 0);
+}
+
+//send the complete chord in chordState, in place of its keys. flight is the record of its last key
+void Engine::fireChord(FlightRecord &flight)
+{
+    ChordState &cs = chordState;
+    int count = cs.count;
+    const AllMaps &allMaps = cs.strokes[count - 1].config->maps;
+    const AllMaps::Chord &chord = allMaps.chords[singleBitIndex(cs.candidates & allMaps.chordsOfSize[count])];
+    cs.count = 0;  //the strokes stay where they are until the next chord
+    cs.candidates = 0;
+    cs.deadline = chrono::steady_clock::time_point::max();
+    IFDEBUG debugLog.write(DEBUG_CHORD, chord.keys[0], chord.keys[1], chord.size);
+    sendInPlaceOfHeld(flight, cs.strokes, count, chord.keySequence);
+}
+
+//COMPOSE k1 k2 ... > result: the keys typed one after the other give the result. With a key of its own first, like
+//COMPOSE APPS F Y > sequence(...), it is a leader key. The keys are held back while they walk down the compose trie.
+//A sequence is sent when its last key comes down; if longer ones start with it, when the next key fits none of them
+//or the compose term is over. Keys that complete no sequence go on unchanged and in order, followed by the key that did not fit.
+//Returns true if the stroke was held back.
+bool Engine::detectCompose(FlightRecord &flight, chrono::steady_clock::time_point receivedAt)
+{
+    ComposeState &cs = composeState;
+    int key = loopState.scancode;
+    if (cs.node != 0)
+    {
+        const AllMaps &allMaps = cs.config->maps;
+        if (loadedDevice == cs.device)
+        {
+            if (!loopState.isDownstroke && !cs.keyDown[key])
+            {
+                //pressed before the sequence started (Shift of a shifted first key): the held keys go first, or it overtakes them
+                finishCompose();
+                return false;
+            }
+            if (loopState.isDownstroke && cs.keyDown[key])
+                return true;  //autorepeat
+            int next = loopState.isDownstroke ? allMaps.composeNext[cs.node * allMaps.composeColumns + allMaps.composeColumn[key]] : cs.node;
+            if (next != 0)
+            {
+                cs.strokes[cs.count++] = { loadedDevice, interceptionState.currentIKstroke, loopState, strokeConfig, flight.config, receivedAt, flight.at[FLIGHT_DECODED] };
+                cs.keyDown.set(key, loopState.isDownstroke);
+                flight.exit = FLIGHT_EXIT_HELD;
+                IFDEBUG debugLog.write(DEBUG_HELD_BACK, key, loopState.isDownstroke, cs.count);
+                if (loopState.isDownstroke)
+                {
+                    cs.node = next;
+                    cs.deadline = loopState.strokeTime + chrono::milliseconds(cs.config->options.composeTermMS);
+                    if (!allMaps.composeNodes[next].hasNext)
+                        fireCompose(flight);
+                }
+                return true;
+            }
+        }
+        finishCompose();
+    }
+
+    //a new press of the first key of a sequence starts one. Not while a tap-hold key is held back, its keys must stay in order
+    const AllMaps &allMaps = strokeConfig->maps;
+    int next = allMaps.composeNext[allMaps.composeColumn[key]];
+    if (!loopState.isDownstroke || next == 0 || modifierState.isKeyDown(key) || lookahead.key >= 0)
+        return false;
+    cs.device = loadedDevice;
+    cs.config = strokeConfig;
+    cs.node = next;
+    cs.deadline = loopState.strokeTime + chrono::milliseconds(strokeConfig->options.composeTermMS);
+    cs.keyDown.reset();
+    cs.keyDown.set(key);
+    cs.count = 0;
+    cs.strokes[cs.count++] = { loadedDevice, interceptionState.currentIKstroke, loopState, strokeConfig, flight.config, receivedAt, flight.at[FLIGHT_DECODED] };
+    flight.exit = FLIGHT_EXIT_HELD;
+    IFDEBUG debugLog.write(DEBUG_HELD_BACK, key, true, cs.count);
+    return true;
+}
+
+//the compose sequence cannot go on: send it if a sequence ends here, else let its keys go on unchanged
+void Engine::finishCompose()
+{
+    ComposeState &cs = composeState;
+    if (cs.node == 0)
+        return;
+    if (cs.config->maps.composeNodes[cs.node].sequence >= 0)
+    {
+        fireCompose(beginFlight(cs.strokes[cs.count - 1]));
+        return;
+    }
+    vector<HeldStroke> held(cs.strokes, cs.strokes + cs.count);
+    cs.node = 0;
+    cs.count = 0;
+    cs.deadline = chrono::steady_clock::time_point::max();
+    replayHeldStrokes(held, 0);
+}
+
+//send the sequence that ends at the node of composeState, in place of its keys. flight is the record of the last one
+void Engine::fireCompose(FlightRecord &flight)
+{
+    ComposeState &cs = composeState;
+    int count = cs.count;
+    const AllMaps &allMaps = cs.config->maps;
+    const KeySequence &keySequence = allMaps.composeSequences[allMaps.composeNodes[cs.node].sequence];
+    cs.node = 0;
+    cs.count = 0;  //the strokes stay where they are until the next sequence
+    cs.deadline = chrono::steady_clock::time_point::max();
+    IFDEBUG debugLog.write(DEBUG_COMPOSE, cs.strokes[0].loop.scancode, cs.strokes[count - 1].loop.scancode, count);
+    sendInPlaceOfHeld(flight, cs.strokes, count, keySequence);
+}
+
+//send keySequence in place of held back strokes (a chord, a compose sequence). flight is the record of the last one.
+//The keys among them that are still down are used up: their autorepeat and release are swallowed.
+void Engine::sendInPlaceOfHeld(FlightRecord &flight, const HeldStroke *held, int count, const KeySequence &keySequence)
+{
+    const HeldStroke &last = held[count - 1];
+    chrono::steady_clock::time_point receivedAt = last.receivedAt;
+
+    LiveContext live = saveLiveContext();
+    switchDeviceState(last.device);
+    interceptionState.interceptionDevice = last.device;
+    strokeConfig = last.config;
+    loopState = last.loop;
+    loopState.resultingKeySequence = keySequence;
+    for (int i = 0; i < count; i++)
+        modifierState.usedKeyDown.set(held[i].loop.scancode, held[i].loop.isDownstroke);
+
+    //like any other key press, it ends the tap candidate and breaks tapped modifiers
+    ModifierState &m = modifierState;
+    if (m.tapCandidate >= 0 && m.tapState[m.tapCandidate] == TAPSTATE_PRESSED)
+        m.tapState[m.tapCandidate] = TAPSTATE_HELD;
+    m.tapCandidate = -1;
+    m.tapCandidateDeadline = chrono::steady_clock::time_point::max();
+    m.modifierTapped = 0;
+
+    chrono::steady_clock::time_point decidedAt = clock.now();
+    LATENCY_OUTCOME outcome = getLatencyOutcome();
+    latency.record(LATENCY_DECISION, outcome, decidedAt - receivedAt);
+    flight.at[FLIGHT_MAPPED] = decidedAt;
+    flight.outcome = outcome;
+    recordFlightResult(flight);
+    scheduler.tagNextStroke({ receivedAt, decidedAt, outcome, true });
+    sendResultingKeyOrSequence();
+    scheduler.tagNextStroke({});
+    flight.at[FLIGHT_QUEUED] = clock.now();
+    flight.exit = FLIGHT_EXIT_MAPPED;
+    restoreLiveContext(live);
+}
+
+//REWIRE ... deferred|holdonkey|permissive, for a press of the key. Only keys with IfTapped have a mode
+int Engine::getTapHoldMode(int scancode)
+{
+    const AllMaps &allMaps = strokeConfig->maps;
+    const int *rewire = interpretConfig ? allMaps.rewiremap[scancode] : allMaps.compiled.keys[scancode].rewire;
+    if (rewire[REWIRE_TAP] < 0 || rewire[REWIRE_TAPHOLDMODE] < 0)
+        return TAPHOLD_SPECULATIVE;
+    if (scancode == modifierState.lastTap && rewire[REWIRE_TAPHOLD] >= 0)  //pressed again right after its tap: tap-and-hold, nothing to decide
+        return TAPHOLD_SPECULATIVE;
+    return rewire[REWIRE_TAPHOLDMODE];
+}
+
+//Lookahead for tap-hold keys that do not guess (TAPHOLD_DEFERRED and up).
+//Their press, and every stroke after it, waits here until the key is decided:
+//  released: tap. Tapping term over, lookahead full: hold.
+//  HOLDONKEY: another key pressed: hold. PERMISSIVE: another key pressed and released: hold.
+//Then the strokes go through the rest of the pipeline in their order, see resolveLookahead().
+//Nothing waits while no such key is down. Returns true if the stroke was held back.
+bool Engine::holdBackStroke(FlightRecord &flight, chrono::steady_clock::time_point receivedAt)
+{
+    Lookahead &la = lookahead;
+    int key = loopState.scancode;
+    bool isLookaheadKey = la.key == key && la.device == loadedDevice;
+    if (la.key < 0)
+    {
+        //only a new press starts it
+        if (!loopState.isDownstroke || modifierState.isKeyDown(key))
+            return false;
+        int mode = getTapHoldMode(key);
+        if (mode == TAPHOLD_SPECULATIVE)
+            return false;
+        int term = getTappingTermMS(key);
+        la.key = key;
+        la.device = loadedDevice;
+        la.mode = mode;
+        la.deadline = loopState.strokeTime + chrono::milliseconds(term >= 0 ? term : DEFAULT_TAPPING_TERM_MS);
+        la.count = 0;
+    }
+    else if (isLookaheadKey && loopState.isDownstroke)  //autorepeat of the undecided key
+    {
+        flight.exit = FLIGHT_EXIT_STOPPED;
+        return true;
+    }
+
+    la.strokes[la.count++] = { loadedDevice, interceptionState.currentIKstroke, loopState, strokeConfig, flight.config, receivedAt, flight.at[FLIGHT_DECODED] };
+    flight.exit = FLIGHT_EXIT_HELD;
+    IFDEBUG debugLog.write(DEBUG_HELD_BACK, key, loopState.isDownstroke, la.count);
+
+    int decision = 0;
+    if (la.count == 1)
+        return true;
+    if (isLookaheadKey)
+        decision = TAPHOLD_DECIDED_TAP;
+    else if (la.mode == TAPHOLD_HOLDONKEY && loopState.isDownstroke && !modifierState.isKeyDown(key))
+        decision = TAPHOLD_DECIDED_HOLD;
+    else if (la.mode == TAPHOLD_PERMISSIVE && !loopState.isDownstroke)
+    {
+        for (int i = 1; i < la.count - 1 && decision == 0; i++)
+        {
+            const HeldStroke &other = la.strokes[i];
+            if (other.device == loadedDevice && other.loop.scancode == key && other.loop.isDownstroke)
+                decision = TAPHOLD_DECIDED_HOLD;
+        }
+    }
+    if (decision == 0 && la.count == TAPHOLD_LOOKAHEAD_SIZE)
+        decision = TAPHOLD_DECIDED_HOLD;
+    if (decision != 0)
+        resolveLookahead(decision);
+    return true;
+}
+
+//Tap: the key's release goes first, as a tap. Hold: its press goes first, as if it had never waited.
+//Then all other held back strokes, in order. They may start the next lookahead.
+void Engine::resolveLookahead(int decision)
+{
+    if (lookahead.key < 0)
+        return;
+    vector<HeldStroke> held(lookahead.strokes, lookahead.strokes + lookahead.count);
+    if (decision == TAPHOLD_DECIDED_TAP)
+    {
+        for (size_t i = 1; i < held.size(); i++)
+        {
+            if (held[i].device == lookahead.device && held[i].loop.scancode == lookahead.key)
+            {
+                held[0] = held[i];  //the release is the tap; the press never happened
+                held.erase(held.begin() + i);
+                break;
+            }
+        }
+    }
+    IFDEBUG debugLog.write(DEBUG_TAPHOLD_DECIDED, lookahead.key, decision == TAPHOLD_DECIDED_TAP);
+    lookahead.key = -1;
+    lookahead.count = 0;
+    lookahead.deadline = chrono::steady_clock::time_point::max();
+    replayHeldStrokes(held, decision);
+}
+
+//run held back strokes through the stages behind the one that held them, in order. decision is for the first one.
+//The stroke that is coming in (if any) goes on afterwards with its own keyboard, config and loop state.
+void Engine::replayHeldStrokes(const vector<HeldStroke> &held, int decision)
+{
+    LiveContext live = saveLiveContext();
+    for (size_t i = 0; i < held.size(); i++)
+        replayHeldStroke(held[i], i == 0 ? decision : 0);
+    restoreLiveContext(live);
+}
+
+Engine::LiveContext Engine::saveLiveContext()
+{
+    return { loadedDevice, interceptionState.interceptionDevice, strokeConfig, loopState, resetCount };
+}
+
+void Engine::restoreLiveContext(const LiveContext &live)
+{
+    switchDeviceState(live.device);
+    interceptionState.interceptionDevice = live.interceptionDevice;
+    strokeConfig = resetCount == live.resetCount ? live.config : currentConfig.get();
+    loopState = live.loop;
+}
+
+//a new flight record for a held back stroke, as far as it got when it was held
+FlightRecord &Engine::beginFlight(const HeldStroke &held)
+{
+    FlightRecord &flight = flightRecorder.begin(held.device, held.stroke, held.receivedAt, globalState.secretSequenceRecording);
+    flight.config = held.flightConfig;
+    flight.scancode = held.loop.scancode;
+    flight.at[FLIGHT_DECODED] = held.decodedAt;
+    return flight;
+}
+
+void Engine::replayHeldStroke(const HeldStroke &held, int decision)
+{
+    switchDeviceState(held.device);
+    InterceptionKeyStroke liveStroke = interceptionState.currentIKstroke;  //the history of this keyboard is already past this stroke
+    interceptionState.interceptionDevice = held.device;
+    interceptionState.currentIKstroke = held.stroke;
+    loopState = held.loop;
+    loopState.tapHoldDecision = decision;
+    strokeConfig = held.config;
+
+    FlightRecord &flight = beginFlight(held);
+    if (decision != 0 || !holdBackStroke(flight, held.receivedAt))
+        processDecodedStroke(flight, held.receivedAt);
+
+    interceptionState.currentIKstroke = liveStroke;
+}
+
+//the tapping term of the physical key: REWIRE ... 180ms, else OPTION TappingTermMS. -1: no limit
+int Engine::getTappingTermMS(int scancode)
+{
+    const AllMaps &allMaps = strokeConfig->maps;
+    int term = interpretConfig ? allMaps.rewiremap[scancode][REWIRE_TAPPINGTERM] : allMaps.compiled.keys[scancode].rewire[REWIRE_TAPPINGTERM];
+    return term >= 0 ? term : strokeConfig->options.tappingTermMS;
+}
+
+chrono::steady_clock::time_point Engine::getTimerDeadline() const
+{
+    return min({ modifierState.tapCandidateDeadline, modifierState.lastTapDeadline, lookahead.deadline, chordState.deadline, composeState.deadline });
+}
+
+void Engine::processTimers(chrono::steady_clock::time_point time)
+{
+    OutputScheduler::Batch batch(scheduler);
+    //the keys of a chord did not all come down within the chord term
+    if (chordState.deadline <= time)
+        finishChord();
+    //no next key of the compose sequence within the compose term
+    if (composeState.deadline <= time)
+        finishCompose();
+    //the held back key is still down after its tapping term
+    if (lookahead.deadline <= time)
+        resolveLookahead(TAPHOLD_DECIDED_HOLD);
+    //the key is still down after its tapping term: it is held, its release will not be a tap
+    if (modifierState.tapCandidateDeadline <= time)
+    {
+        modifierState.tapCandidateExpired = true;
+        modifierState.tapCandidateDeadline = chrono::steady_clock::time_point::max();
+        if (modifierState.tapState[modifierState.tapCandidate] == TAPSTATE_PRESSED)
+            modifierState.tapState[modifierState.tapCandidate] = TAPSTATE_HELD;
+        IFDEBUG debugLog.write(DEBUG_TAPPING_TERM_EXPIRED, modifierState.tapCandidate);
+    }
+    //too late to turn the last tap into tap-and-hold
+    if (modifierState.lastTapDeadline <= time)
+    {
+        if (modifierState.tapState[modifierState.lastTap] == TAPSTATE_TAPPED)
+            modifierState.tapState[modifierState.lastTap] = TAPSTATE_IDLE;
+        modifierState.lastTap = -1;
+        modifierState.lastTapDeadline = chrono::steady_clock::time_point::max();
+    }
+}
+
+//A key is tapped when it is released before its tapping term ran out, and no other key was pressed meanwhile.
+//Releases of other keys do not matter, so rolling over from another key still taps.
+//Without a tapping term, the autorepeat ends a tap (a key held that long is 'tapped slow').
+void Engine::detectTapping()
+{
+    ModifierState &m = modifierState;
+    int key = loopState.scancode;
+    if (loopState.tapHoldDecision == TAPHOLD_DECIDED_TAP)  //release of a held back key; its press never came through here
+    {
+        int term = getTappingTermMS(key);
+        m.tapState[key] = TAPSTATE_TAPPED;
+        m.tapCandidate = -1;
+        m.tapCandidateDeadline = chrono::steady_clock::time_point::max();
+        loopState.tapped = true;
+        m.lastTap = key;
+        m.lastTapDeadline = term >= 0 ? loopState.strokeTime + chrono::milliseconds(term) : chrono::steady_clock::time_point::max();
+        return;
+    }
+    if (loopState.isDownstroke)
+    {
+        if (m.isKeyDown(key))  //autorepeat
+        {
+            if (key == m.tapCandidate)
+            {
+                m.tapCandidateRepeated = true;
+                if (m.tapState[key] == TAPSTATE_PRESSED && getTappingTermMS(key) < 0)
+                    m.tapState[key] = TAPSTATE_HELD;
+            }
+            return;
+        }
+
+        //a new press ends the tap candidate before it, and the chance to tap-and-hold any key but this one
+        if (m.tapCandidate >= 0 && m.tapState[m.tapCandidate] == TAPSTATE_PRESSED)
+            m.tapState[m.tapCandidate] = TAPSTATE_HELD;
+        if (m.lastTap >= 0 && m.tapState[m.lastTap] == TAPSTATE_TAPPED)
+            m.tapState[m.lastTap] = TAPSTATE_IDLE;
+        m.tapState[key] = TAPSTATE_PRESSED;
+
+        //Tap and hold Make? (tapped, then pressed again within the term)
+        loopState.tapHoldMake = (key == m.lastTap);
+        m.lastTap = -1;
+        m.lastTapDeadline = chrono::steady_clock::time_point::max();
+
+        int term = getTappingTermMS(key);
+        m.tapCandidate = key;
+        m.tapCandidateRepeated = false;
+        m.tapCandidateExpired = false;
+        m.tapCandidateDeadline = term >= 0 ? loopState.strokeTime + chrono::milliseconds(term) : chrono::steady_clock::time_point::max();
+        if (loopState.tapHoldDecision == TAPHOLD_DECIDED_HOLD)  //the lookahead decided: its release is no tap
+        {
+            m.tapState[key] = TAPSTATE_HELD;
+            m.tapCandidate = -1;
+            m.tapCandidateDeadline = chrono::steady_clock::time_point::max();
+        }
+        return;
+    }
+
+    //a tap-and-hold key stays TAPHELD until processRewireScancodeToVirtualcode() released it
+    if (m.tapState[key] != TAPSTATE_TAPHELD)
+        m.tapState[key] = TAPSTATE_IDLE;
+    if (key != m.tapCandidate)
+        return;
+
+    int term = getTappingTermMS(key);
+    bool slow = m.tapCandidateExpired || (term < 0 && m.tapCandidateRepeated);
+    loopState.tapped = !slow;
+    loopState.tappedSlow = slow;
+    m.tapCandidate = -1;
+    m.tapCandidateDeadline = chrono::steady_clock::time_point::max();
+    if (loopState.tapped)
+    {
+        if (m.tapState[key] == TAPSTATE_IDLE)
+            m.tapState[key] = TAPSTATE_TAPPED;
+        m.lastTap = key;
+        m.lastTapDeadline = term >= 0 ? loopState.strokeTime + chrono::milliseconds(term) : chrono::steady_clock::time_point::max();
+    }
+
+    //cannot detect tapHold Break here. This is done by ProcessRewire()
+}
+
+void Engine::processModifierState()
+{
+    unsigned short modBitmask = getModifierBitmaskForVcode(loopState.vcode);
+
+    //set internal modifier state
+    if (loopState.isDownstroke)
+        modifierState.modifierDown |= modBitmask;
+    else
+        modifierState.modifierDown &= ~modBitmask;
+
+    //Default tapping logic without specific rules
+    //Tapped mod key sets tapped bitmask. You can combine mod-taps (like tap-Ctrl then tap-Alt).
+    if (loopState.tapped)
+        modifierState.modifierTapped |= modBitmask;
+}
+
+//handle all REWIRE configs. Rewire to new vcode; check for Tapped rules
+void Engine::processRewireScancodeToVirtualcode()
+{
+    //ignore auto-repeating tapHold key
+    TAPSTATE &tapState = modifierState.tapState[loopState.scancode];
+    if (tapState == TAPSTATE_TAPHELD && loopState.isDownstroke)
+    {
+        loopState.vcode = SC_NOP;
+        return;
+    }
+
+    const AllMaps &allMaps = strokeConfig->maps;
+    //OUT is looked up for the vcode (messy keys may have translated it), tap rules for the physical key
+    const int *rewire = interpretConfig ? allMaps.rewiremap[loopState.scancode] : allMaps.compiled.keys[loopState.scancode].rewire;
+    int rewoutkey = interpretConfig ? allMaps.rewiremap[loopState.vcode][REWIRE_OUT] : allMaps.compiled.keys[loopState.vcode].rewire[REWIRE_OUT];
+    if (rewoutkey >= 0)
+    {
+        //Rewire
+        loopState.vcode = rewoutkey;
+
+        //tapped?
+        int rewtapkey = rewire[REWIRE_TAP];
+        if (loopState.tapped && rewtapkey >= 0)  //ifTapped definition applies
+        {
+            //rewired tap (like TAB to TAB) clears all previous modifier taps. Good rule? Consider that maybe "outkey tapped" detection happens(?)
+            modifierState.modifierTapped = 0;
+
+            //release the preceding "rewired on press" result, only for hardware keys (e.g. "rewire Tab Shift Tab": Shift down was sent when tap arrives)
+            if (loopState.tapHoldDecision != TAPHOLD_DECIDED_TAP)  //held back: it was never pressed
+                loopState.resultingKeySequence.release(rewoutkey);
+            //clear the 'modifier down' state for preceding "to mod" def
+            if (isModifier(loopState.vcode))
+            {
+                unsigned short modBitmask = getModifierBitmaskForVcode(loopState.vcode);
+                if (modBitmask != 0)
+                    modifierState.modifierDown &= ~modBitmask; //undo previous key down, e.g. clear internal 'MOD10 is down'
+            }
+            //send ifTapped key
+            loopState.vcode = rewtapkey;
+            loopState.resultingKeySequence.pressRelease(rewtapkey);
+        }
+
+        //tapHold Make?
+        if (loopState.tapHoldMake)
+        {
+            int rewtapholdkey = rewire[REWIRE_TAPHOLD];
+            if (rewtapholdkey >= 0)
+            {
+                tapState = TAPSTATE_TAPHELD;  //any number of keys can be tap-and-held at once
+                if(rewtapholdkey <= 255) //send make only for real keys
+                    loopState.resultingKeySequence.press(rewtapholdkey);
+                loopState.vcode = rewtapholdkey;
+
+                //clear the preceding tapped state(s)
+                int rewtappedkey = rewire[REWIRE_TAP];
+                //1. Tap&Hold of a key rewired to modifier always first triggers the generic "modifier tapped"
+                unsigned short modBitmask1 = getModifierBitmaskForVcode(rewoutkey);
+                if (modBitmask1 != 0)
+                    modifierState.modifierTapped &= ~modBitmask1;
+                //2. Explicit "Rewire in out ifTapped" (should probably never combine ifTapped with ifTappedAndHold, but not sure)
+                unsigned short modBitmask2 = getModifierBitmaskForVcode(rewtappedkey);
+                if (modBitmask2 != 0)
+                    modifierState.modifierTapped &= ~modBitmask2;
+
+                IFTRACE cout << endl << "Make taphold rewired: " << hex << rewtapholdkey;
+            }
+        }
+        //tapHold Break?
+        if (!loopState.isDownstroke && tapState == TAPSTATE_TAPHELD)
+        {
+            int rewtapholdkey = rewire[REWIRE_TAPHOLD];
+            if (rewtapholdkey >= 0)
+            {
+                tapState = loopState.tapped ? TAPSTATE_TAPPED : TAPSTATE_IDLE;
+                if (rewtapholdkey < 255) //send break only for real keys
+                    loopState.resultingKeySequence.release(rewtapholdkey);
+                else
+                    loopState.vcode = SC_NOP;
+                loopState.vcode = rewtapholdkey;
+                IFTRACE cout << endl << "Break taphold rewired: " << hex << rewtapholdkey;
+            }
+            else
+            {
+                tapState = TAPSTATE_IDLE;
+                error("BUG: undefined tapHold should never have been stored");
+            }
+        }
+    }
+
+    //update the internal modifier state
+    loopState.isModifier = isModifier(loopState.vcode) ? true : false;
+}
+
+
+void Engine::processCombos()
+{
+    //tmp test let rewired tappings be processed further
+    SeqOp break_tapped_modifier = makeSeqOp(SEQ_RELEASE, SC_NOP); //hack to remember 'release shift first'
+    if (!loopState.isDownstroke)
+    {
+        if (loopState.tapped && loopState.resultingKeySequence.size() > 0)
+        {
+            //the release of the rewired key. A held back tap key (deferred, holdonkey, permissive) was never pressed:
+            //then ops[0] is the press of the tap key, which the combo replaces
+            if (getSeqOpcode(loopState.resultingKeySequence.ops.at(0)) == SEQ_RELEASE)
+                break_tapped_modifier = loopState.resultingKeySequence.ops.at(0);
+        }
+        else //this check breaks 'x []' : // || (modifierState.modifierDown == 0 && modifierState.modifierTapped == 0 && modifierState.activeDeadkey == 0))
+            
+            return;
+    }
+
+    const AllMaps &allMaps = strokeConfig->maps;
+    int combo = scanCombos(allMaps, loopState.vcode, modifierState.modifierDown, modifierState.modifierTapped, modifierState.activeDeadkey);
+    if (combo >= 0)
+    {
+        loopState.resultingKeySequence = allMaps.modCombos[combo].keySequence;
+        loopState.combo = combo;
+        if (getSeqArg(break_tapped_modifier) != SC_NOP)
+        {
+            loopState.resultingKeySequence.ops.push_back(break_tapped_modifier);
+        }
+        modifierState.modifierTapped = 0;
+    }
+    if(!loopState.isModifier)
+        modifierState.activeDeadkey = 0;
+}
+
+void Engine::processMapAlphaKeys()
+{
+    if (loopState.isModifier ||
+        (options.LControlLWinBlocksAlphaMapping && (IS_LCTRL_DOWN || IS_LWIN_DOWN)))
+    {
+        return;
+    }
+
+    loopState.vcode = strokeConfig->maps.alphamap[loopState.vcode];
+
+    if (options.flipZy)
+    {
+        switch (loopState.vcode)
+        {
+        case SC_Y:		loopState.vcode = SC_Z;		break;
+        case SC_Z:		loopState.vcode = SC_Y;		break;
+        }
+    }
+}
+
+//processCombos() + processMapAlphaKeys() on the compiled config
+void Engine::processCompiledMapping()
+{
+    if (loopState.vcode < 0 || loopState.vcode >= MAX_VCODES)
+        return;
+    const AllMaps &allMaps = strokeConfig->maps;
+    const CompiledKey &key = allMaps.compiled.keys[loopState.vcode];
+
+    SeqOp break_tapped_modifier = makeSeqOp(SEQ_RELEASE, SC_NOP);
+    bool lookupCombo = true;
+    if (!loopState.isDownstroke)
+    {
+        if (loopState.tapped && loopState.resultingKeySequence.size() > 0)
+        {
+            //only the release of the rewired key, see processCombos()
+            if (getSeqOpcode(loopState.resultingKeySequence.ops.at(0)) == SEQ_RELEASE)
+                break_tapped_modifier = loopState.resultingKeySequence.ops.at(0);
+        }
+        else
+            lookupCombo = false;
+    }
+
+    if (lookupCombo)
+    {
+        int leaf = decideCombo(allMaps.compiled, loopState.vcode,
+            comboStateWord(modifierState.modifierDown, modifierState.modifierTapped, modifierState.activeDeadkey));
+        int combo = -1;
+        if (leaf == COMBO_SCAN)
+            combo = scanCombos(allMaps, loopState.vcode, modifierState.modifierDown, modifierState.modifierTapped, modifierState.activeDeadkey);
+        else if (leaf != COMBO_NONE)
+            combo = COMBO_OF_LEAF(leaf);
+
+        if (combo >= 0)
+        {
+            loopState.resultingKeySequence = allMaps.modCombos[combo].keySequence;
+            loopState.combo = combo;
+            if (getSeqArg(break_tapped_modifier) != SC_NOP)
+                loopState.resultingKeySequence.ops.push_back(break_tapped_modifier);
+            modifierState.modifierTapped = 0;
+        }
+        if (!loopState.isModifier)
+            modifierState.activeDeadkey = 0;
+    }
+
+    if (loopState.isModifier ||
+        (options.LControlLWinBlocksAlphaMapping && (IS_LCTRL_DOWN || IS_LWIN_DOWN)))
+    {
+        return;
+    }
+    loopState.vcode = key.alpha[options.flipZy ? 1 : 0];
+}
+
+void Engine::getHardwareId()
+{
+    describeDevice(deviceStates[loadedDevice]);
+}
+
+//reads all GLOBALs from ini, no matter where they are
+void Engine::parseIniGlobals()
+{
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_GLOBAL, sanitizedIniContent.lines);
+
+    for (const IniLine &line : sectLines)
+    {
+        string_view token = line.keyword;
+        if (token == "debugonstartup")
+            options.debug = true;
+        else if (token == "capsicainonoffkey")
+        {
+            int key = getVcode(line.rest);
+            if (key < 0)
+                cout << "ERROR: unknown key label: " << line.text << endl;
+            else if (key > 255 && key != VK_CPS_PAUSE)
+                cout << "ERROR: virtual key makes no sense: " << line.text << endl;
+            else
+                globals.capsicainOnOffKey = key;
+        }
+        else if (token == "iniversion")
+            globals.iniVersion = line.rest;
+        else if (token == "startminimized")
+            globals.startMinimized = true;
+        else if (token == "startintraybar")
+            globals.startInTraybar = true;
+        else if (token == "startahk")
+            globals.startAHK = true;
+        else if (token == "donttranslatemessykeys")
+            globals.translateMessyKeys = false;
+        else if (token == "dontprotectconsole")
+            globals.protectConsole = false;
+        else if (token == "deactivatewinkeystartmenu")
+            globals.deactivateWinkeyStartmenu = true;
+        else if (token == "deviceconfig")
+        {
+            //the config number is the last token, the device id part may contain spaces
+            size_t split = line.rest.find_last_of(' ');
+            int config = -1;
+            if (split == string_view::npos || !stringToInt(string(line.rest.substr(split + 1)), config)
+                || config < 0 || config >= MAX_CONFIGS)
+                cout << endl << "ERROR: expected 'GLOBAL DeviceConfig <part of the device id> <config number>': " << line.text;
+            else
+                globals.deviceConfigs.push_back({ string(line.rest.substr(0, split)), config });
+        }
+        else if ((token == "activeconfigonstartup") || (token == "activelayeronstartup"))
+            cout << endl;
+        else
+            cout << endl << "WARNING: unknown GLOBAL " << token;
+    }
+
+    if (!getIntValueForTaggedKey(INI_TAG_GLOBAL, "ActiveConfigOnStartup", globals.activeConfigOnStartup, sanitizedIniContent.lines))
+    {
+        //backward compat for "layer"
+        if (getIntValueForTaggedKey(INI_TAG_GLOBAL, "ActiveLayerOnStartup", globals.activeConfigOnStartup, sanitizedIniContent.lines))
+        {
+            cout << endl << "INFO: Use 'GLOBAL activeConfigOnStartup' instead of 'GLOBAL activeLayerOnStartup'";
+        }
+        else
+        {
+            cout << endl << "No ini setting for 'GLOBAL activeConfigOnStartup'. Setting default config " << globals.activeConfigOnStartup;
+        }
+    }
+}
+
+// Parses the OPTIONS in the given section.
+// Returns false if section does not exist.
+bool Engine::parseIniOptions(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_OPTIONS, assembledIni);
+    config.name = INI_TAG_OPTIONS+" configName is undefined";
+
+    for (const IniLine &line : sectLines)
+    {
+        string_view token = line.keyword;
+        if (token == "configname")
+        {
+            config.name = line.rest;
+        }
+        else if (token == "layername")  //back compat, deprecated
+        {
+            config.name = line.rest;
+            config.info("\nINFO: Option LAYERname is deprecated. Use Option CONFIGname instead.");
+        }
+        else if (token == "debug")
+        {
+            config.options.debug = true;
+        }
+        else if (token == "flipzy")
+        {
+            config.options.flipZy = true;
+        }
+        else if (token == "altalttoalt")
+        {
+            config.info("\n" + INI_TAG_OPTIONS + " AltAltToAlt is obsolete. You can do this now with 'REWIRE LALT MOD12 // LALT'");
+        }
+        else if (token == "flipaltwinonapplekeyboards")
+        {
+            config.options.flipAltWinOnAppleKeyboards = true;
+        }
+        else if (token == "lcontrollwinblocksalphamapping")
+        {
+            config.options.LControlLWinBlocksAlphaMapping = true;
+        }
+        else if (token == "processonlyfirstkeyboard")
+        {
+            config.options.processOnlyFirstKeyboard = true;
+        }
+        else if (token == "includedeviceid")
+        {
+            config.includeDeviceId = line.rest;
+            config.info("\nINFO: this layer is active for devices whose ID contains '" + config.includeDeviceId + "'");
+        }
+        else if (token == "excludedeviceid")
+        {
+            config.excludeDeviceId = line.rest;
+            config.info("\nINFO: this layer is active for devices whose ID does NOT contain '" + config.excludeDeviceId + "'");
+        }
+        else if (token == "delayforkeysequencems")
+        {
+            int delay;
+            if (getIntValueForKey("delayForKeySequenceMS", delay, sectLines))
+                config.options.delayForKeySequenceMS = delay;
+        }
+        else if (token == "tappingtermms")
+        {
+            int term;
+            if (getIntValueForKey("tappingTermMS", term, sectLines))
+                config.options.tappingTermMS = term;
+        }
+        else if (token == "chordtermms")
+        {
+            int term;
+            if (getIntValueForKey("chordTermMS", term, sectLines) && term > 0)
+                config.options.chordTermMS = term;
+        }
+        else if (token == "composetermms")
+        {
+            int term;
+            if (getIntValueForKey("composeTermMS", term, sectLines) && term > 0)
+                config.options.composeTermMS = term;
+        }
+        else if (token == "shiftshifttoshiftlock")
+        {
+            config.info(string("\nWARNING: this is obsolete: OPTION shiftShiftToShiftLock")
+                + "\n  Put this into your .ini instead: "
+                + "\n    COMBO  LSHF   [& ....] > key(CAPSOFF)"
+                + "\n    COMBO  RSHF[.&] > key(CAPSON)\n");
+        }
+        else
+        {
+            config.info("\nWARNING: ignoring unknown OPTION " + string(line.text) + "\n");
+        }
+    }
+
+    return true;
+}
+
+//fill the rewiremap array
+//return # of valid rewires
+void Engine::parseIniRewires(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_REWIRE, assembledIni);
+    AllMaps &allMaps = config.maps;
+
+    int tagCounter = 0;
+    int keyIn, keyOut, keyTap, keyTapHold, tappingTermMS, tapHoldMode;
+    for (const IniLine &line : sectLines)
+    {
+        keyTap = -1;
+        keyTapHold = -1;
+        tappingTermMS = -1;
+        tapHoldMode = -1;
+        bool parsed = parseKeywordRewire(string(line.text), keyIn, keyOut, keyTap, keyTapHold, tappingTermMS, tapHoldMode);
+        collectParserLog(config);
+        if (parsed)
+        {
+            //duplicate?
+            if (allMaps.rewiremap[keyIn][REWIRE_OUT] >= 0)
+            {
+                config.info("\nWARNING: ignoring redefinition of " + INI_TAG_REWIRE + " "
+                    + string(PRETTY_VK_LABELS[keyIn]) + " " + string(PRETTY_VK_LABELS[keyOut]) + " " + (keyTap >= 0 ? string(PRETTY_VK_LABELS[keyTap]) : ""));
+                continue;
+            }
+
+            if (!isModifier(keyOut) && keyTap > 0)
+                config.info("\nWARNING: 'If-Tapped' definition only makes sense for modifiers: " + INI_TAG_REWIRE + " " + string(line.text));
+            if (tapHoldMode > TAPHOLD_SPECULATIVE && keyTap < 0)
+                config.info("\nWARNING: a tap-hold mode needs an 'If-Tapped' key: " + INI_TAG_REWIRE + " " + string(line.text));
+
+            tagCounter++;
+            allMaps.rewiremap[keyIn][REWIRE_OUT] = keyOut;
+            allMaps.rewiremap[keyIn][REWIRE_TAP] = keyTap;
+            allMaps.rewiremap[keyIn][REWIRE_TAPHOLD] = keyTapHold;
+            allMaps.rewiremap[keyIn][REWIRE_TAPPINGTERM] = tappingTermMS;
+            allMaps.rewiremap[keyIn][REWIRE_TAPHOLDMODE] = tapHoldMode;
+        }
+        else
+            config.error("Bad Rewire / key mapping: " + string(line.text));
+    }
+    config.debug("\nRewire Definitions: " + to_string(tagCounter));
+}
+
+bool Engine::parseIniCombos(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    AllMaps &allMaps = config.maps;
+    allMaps.modCombos.clear();
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_COMBOS, assembledIni);
+    if (sectLines.size() == 0)
+        return false;
+
+    unsigned short mods[5] = { 0 }; //deadkey, and, or, not, tap
+    KeySequence keySequence;
+    unordered_map<ComboKey, size_t, ComboKeyHash> definedCombos;  //duplicate detection
+    definedCombos.reserve(sectLines.size());
+
+    for (const IniLine &line : sectLines)
+    {
+        int key;
+        bool parsed = parseKeywordCombo(string(line.text), key, mods, keySequence);
+        collectParserLog(config);
+        if (parsed)
+        {
+            ComboKey comboKey = { key, mods[0], mods[1], mods[2], mods[3], mods[4] };
+            auto known = definedCombos.find(comboKey);
+            if (known != definedCombos.end())
+            {
+                //warn only if the combos are different
+                if(!(allMaps.modCombos[known->second].keySequence == keySequence))
+                    config.info("\nWARNING: Ignoring redefinition of Combo: " + string(line.text));
+            }
+            else
+            {
+                definedCombos[comboKey] = allMaps.modCombos.size();
+                allMaps.modCombos.push_back({ key, (unsigned char) mods[0], mods[1], mods[2], mods[3], mods[4], keySequence });
+            }
+        }
+        else
+            config.error("Cannot parse combo rule: " + string(line.text));
+    }
+    indexCombos(allMaps);
+    return true;
+}
+
+//CHORD rules and their bitmask tables
+void Engine::parseIniChords(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    AllMaps &allMaps = config.maps;
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_CHORDS, assembledIni);
+    for (const IniLine &line : sectLines)
+    {
+        vector<int> keys;
+        KeySequence keySequence;
+        bool parsed = parseKeywordChord(string(line.text), keys, keySequence);
+        collectParserLog(config);
+        if (!parsed)
+        {
+            config.error("Cannot parse chord rule: " + string(line.text));
+            continue;
+        }
+        if (allMaps.chords.size() >= MAX_CHORDS)
+        {
+            config.error("Too many chords (max " + to_string(MAX_CHORDS) + "), ignoring: " + string(line.text));
+            continue;
+        }
+
+        //the same keys in another order?
+        unsigned long long same = allMaps.chordsOfSize[keys.size()];
+        for (int key : keys)
+            same &= allMaps.chordsOfKey[key];
+        if (same != 0)
+        {
+            config.info("\nWARNING: Ignoring redefinition of Chord: " + string(line.text));
+            continue;
+        }
+
+        unsigned long long bit = 1ULL << allMaps.chords.size();
+        AllMaps::Chord chord = { };
+        for (int key : keys)
+        {
+            chord.keys[chord.size++] = (unsigned char)key;
+            allMaps.chordsOfKey[key] |= bit;
+        }
+        allMaps.chordsOfSize[chord.size] |= bit;
+        chord.keySequence = keySequence;
+        allMaps.chords.push_back(chord);
+    }
+}
+
+//LAYER key config
+void Engine::parseIniLayers(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    AllMaps &allMaps = config.maps;
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_LAYERS, assembledIni);
+    for (const IniLine &line : sectLines)
+    {
+        int key = getVcode(line.keyword);
+        int layer = -1;
+        if (key < 0 || key > 255 || !stringToInt(string(line.rest), layer) || layer <= DISABLED_CONFIG_NUMBER || layer >= MAX_CONFIGS)
+        {
+            config.error("Bad Layer definition (LAYER key config, config 1.." + to_string(MAX_CONFIGS - 1) + "): " + string(line.text));
+            continue;
+        }
+        if (allMaps.layerKeys[key] != 0)
+        {
+            config.info("\nWARNING: Ignoring redefinition of Layer: " + string(line.text));
+            continue;
+        }
+        allMaps.layerKeys[key] = (unsigned char)layer;
+    }
+}
+
+//COMPOSE rules, compiled into the compose trie
+void Engine::parseIniComposes(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    AllMaps &allMaps = config.maps;
+    vector<IniLine> sectLines = getTaggedLinesFromIni(INI_TAG_COMPOSE, assembledIni);
+    vector<vector<int>> sequenceKeys;
+    vector<KeySequence> sequences;
+    vector<string> sequenceLines;
+    for (const IniLine &line : sectLines)
+    {
+        vector<int> keys;
+        KeySequence keySequence;
+        bool parsed = parseKeywordCompose(string(line.text), keys, keySequence);
+        collectParserLog(config);
+        if (!parsed)
+        {
+            config.error("Cannot parse compose rule: " + string(line.text));
+            continue;
+        }
+        sequenceKeys.push_back(keys);
+        sequences.push_back(keySequence);
+        sequenceLines.push_back(string(line.text));
+    }
+    if (sequences.size() == 0)
+        return;
+
+    //the table needs the number of columns, so all keys get theirs first
+    for (const vector<int> &keys : sequenceKeys)
+        for (int key : keys)
+            if (allMaps.composeColumn[key] == 0)
+                allMaps.composeColumn[key] = (unsigned char)allMaps.composeColumns++;  //at most 255 scancodes + column 0
+    int columns = allMaps.composeColumns;
+    allMaps.composeNext.assign(columns, 0);
+
+    for (size_t s = 0; s < sequences.size(); s++)
+    {
+        int node = 0;
+        for (int key : sequenceKeys[s])
+        {
+            size_t edge = (size_t)node * columns + allMaps.composeColumn[key];
+            if (allMaps.composeNext[edge] == 0)
+            {
+                if (allMaps.composeNodes.size() >= MAX_COMPOSE_NODES)
+                {
+                    node = -1;
+                    break;
+                }
+                allMaps.composeNext[edge] = (unsigned short)allMaps.composeNodes.size();
+                allMaps.composeNodes[node].hasNext = true;
+                allMaps.composeNodes.push_back({ -1, false });
+                allMaps.composeNext.resize(allMaps.composeNext.size() + columns, 0);
+            }
+            node = allMaps.composeNext[edge];
+        }
+        if (node < 0)
+            config.error("Too many compose rules, ignoring: " + sequenceLines[s]);
+        else if (allMaps.composeNodes[node].sequence >= 0)
+            config.info("\nWARNING: Ignoring redefinition of Compose: " + sequenceLines[s]);
+        else
+        {
+            allMaps.composeNodes[node].sequence = (int)allMaps.composeSequences.size();
+            allMaps.composeSequences.push_back(sequences[s]);
+        }
+    }
+}
+
+//bucket the combos by vkey so processCombos() only tests the candidates for the current key
+void Engine::indexCombos(AllMaps &allMaps)
+{
+    unsigned int counts[MAX_VCODES + 1] = { };
+    for (const ModifierCombo &combo : allMaps.modCombos)
+        counts[combo.vkey + 1]++;
+    for (int vk = 0; vk < MAX_VCODES; vk++)
+        counts[vk + 1] += counts[vk];
+    memcpy(allMaps.comboIndex, counts, sizeof(counts));
+
+    allMaps.comboMatches.resize(allMaps.modCombos.size());
+    for (unsigned int i = 0; i < allMaps.modCombos.size(); i++)
+    {
+        const ModifierCombo &combo = allMaps.modCombos[i];
+        allMaps.comboMatches[counts[combo.vkey]++] = { combo.deadkey, combo.modAnd, combo.modOr, combo.modNot, combo.modTap, i };
+    }
+}
+
+bool Engine::parseIniAlphaLayout(const std::vector<IniLine> &assembledIni, Config &config)
+{
+    string tagFrom = stringToLower(INI_TAG_ALPHA_FROM);
+    string tagEnd = stringToLower(INI_TAG_ALPHA_END);
+
+    string mapFromTo = "";
+    bool inMapFromTo = false;
+    for (const IniLine &line : assembledIni)
+    {
+        string_view firstToken = line.keyword;
+        if (firstToken == tagFrom)
+        {
+            if (inMapFromTo)
+            {
+                config.error("Bad " + INI_TAG_ALPHA_FROM + ".." + INI_TAG_ALPHA_TO + "definition - received second "+ INI_TAG_ALPHA_FROM +". Forgot the "+INI_TAG_ALPHA_END+"?");
+                return false;
+            }
+            inMapFromTo = true;
+            mapFromTo = string(line.rest) + " ";
+        }
+        else if (firstToken == tagEnd)
+        {
+            inMapFromTo = false;
+            bool parsed = parseKeywordsAlpha_FromTo(mapFromTo, config.maps.alphamap);
+            collectParserLog(config);
+            if (!parsed)
+                config.error("Cannot parse the " + INI_TAG_ALPHA_FROM + ".." + INI_TAG_ALPHA_TO + " alpha definition");
+        }
+        else if (inMapFromTo)
+        {
+            mapFromTo += string(line.text) + " ";
+        }
+    }
+    return true;
+}
+
+//insert all the INCLUDEd sub-sections into the base config section
+std::vector<IniLine> Engine::assembleConfig(const IniContent &iniContent, int configNumber, Config &config)
+{
+    string sectionName = "config_" + to_string(configNumber);
+    vector<IniLine> section = getSectionFromIni(sectionName, iniContent);
+
+    if (section.size() == 0)
+    {
+        sectionName = "layer_" + to_string(configNumber);
+        section = getSectionFromIni(sectionName, iniContent);
+
+        if (section.size() > 0)
+            config.info("\nINFO: section [layer_x]  should now be named  [config_x]");
+    }
+
+    vector<IniLine> assembledIni;
+    assembledIni.reserve(section.size());
+    for (const IniLine &line : section)
+    {
+        if (line.keyword == "include" && !line.rest.empty())
+            includeSection(iniContent, line.rest, assembledIni, 1, config);
+        else
+            assembledIni.push_back(line);
+    }
+    return assembledIni;
+}
+
+//append an INCLUDEd sub-section, with the sub-sections it includes itself
+void Engine::includeSection(const IniContent &iniContent, std::string_view sectionName, std::vector<IniLine> &assembledIni, int depth, Config &config)
+{
+    string subSectionName(sectionName);
+    if (depth > MAX_INCLUDE_DEPTH)
+    {
+        config.error("Subsection [" + subSectionName + "] is included more than " + to_string(MAX_INCLUDE_DEPTH) + " levels deep. Does it include itself?");
+        return;
+    }
+    vector<IniLine> subsection = getSectionFromIni(subSectionName, iniContent);
+    if (subsection.size() == 0)
+    {
+        config.error("Subsection [" + subSectionName + "] does not exist or is empty)");
+        return;
+    }
+    config.debug("\ninserting sub-section: " + subSectionName + " (" + to_string(subsection.size()) + " lines)");
+    for (const IniLine &line : subsection)
+    {
+        if (line.keyword == "include" && !line.rest.empty())
+            includeSection(iniContent, line.rest, assembledIni, depth + 1, config);
+        else
+            assembledIni.push_back(line);
+    }
+}
+
+std::vector<IniLine> Engine::assembleConfig(int config)
+{
+    Config messages;
+    vector<IniLine> assembledIni = assembleConfig(sanitizedIniContent, config, messages);
+    printConfigMessages(messages);
+    return assembledIni;
+}
+
+void Engine::initializeAllMaps(AllMaps &allMaps)
+{
+    allMaps.modCombos.clear();
+    allMaps.comboMatches.clear();
+    memset(allMaps.comboIndex, 0, sizeof(allMaps.comboIndex));
+
+    //resetAlphamap()
+    {
+        for (int i = 0; i < MAX_VCODES; i++)  //initialize to "map to same char"
+            allMaps.alphamap[i] = i;
+    }
+
+    //resetRewiremap()
+    {
+        for (int r = 0; r < REWIRE_ROWS; r++)
+            for (int c = 0; c < REWIRE_COLS; c++)
+                allMaps.rewiremap[r][c] = -1;
+    }
+
+    compileConfig(allMaps);
+}
+
+
+//parses and compiles one config of the sanitized ini. Touches no engine state, runs on the compile worker too.
+std::shared_ptr<const Config> Engine::parseProcessIniConfig(const IniContent &iniContent, int configNumber)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    shared_ptr<Config> config = make_shared<Config>();
+    config->number = configNumber;
+    initializeAllMaps(config->maps);
+
+    if (iniContent.size() == 0)
+    {
+        config->info("\nCapsicain.ini is missing or empty.");
+        return config;
+    }
+
+    vector<IniLine> assembledConfig = assembleConfig(iniContent, configNumber, *config);
+    if (assembledConfig.size() == 0)
+    {
+        config->info("\nNo valid configuration for Config " + to_string(configNumber));
+        return config;
+    }
+
+    config->debug("\nAssembled config #" + to_string(configNumber) + " : " + to_string(assembledConfig.size()) + " lines");
+
+    setConfigLog(&parserLog);
+    parseIniOptions(assembledConfig, *config);
+
+    parseIniRewires(assembledConfig, *config);
+
+    parseIniCombos(assembledConfig, *config);
+    config->debug("\nCombo  Definitions: " + to_string(config->maps.modCombos.size()));
+
+    parseIniChords(assembledConfig, *config);
+    if (config->maps.chords.size() > 0)
+        config->debug("\nChord  Definitions: " + to_string(config->maps.chords.size()));
+
+    parseIniLayers(assembledConfig, *config);
+
+    parseIniComposes(assembledConfig, *config);
+    if (config->maps.composeSequences.size() > 0)
+        config->debug("\nCompose Definitions: " + to_string(config->maps.composeSequences.size()) + " (" + to_string(config->maps.composeNodes.size()) + " trie nodes)");
+
+    parseIniAlphaLayout(assembledConfig, *config);
+    {
+        int remapped = 0;
+        for (int i = 0; i < MAX_VCODES; i++)
+            if (i != config->maps.alphamap[i])
+                remapped++;
+        config->debug("\nAlpha  Definitions: " + to_string(remapped));
+    }
+    collectParserLog(*config);
+    setConfigLog(nullptr);
+
+    compileConfig(config->maps);
+    config->debug("\nCompiled combo decision nodes: " + to_string(config->maps.compiled.comboNodes.size()));
+
+    config->valid = true;
+    config->compileTimeUS = (unsigned long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return config;
+}
+
+//the compiled config, compiled right now if the worker did not get to it yet
+std::shared_ptr<const Config> Engine::getCompiledConfig(int configNumber)
+{
+    if (configNumber < 0 || configNumber >= MAX_CONFIGS)
+        return parseProcessIniConfig(IniContent(), configNumber);
+
+    shared_ptr<const Config> config = atomic_load(&compiledConfigs[configNumber]);
+    if (!config)
+    {
+        config = parseProcessIniConfig(sanitizedIniContent, configNumber);
+        atomic_store(&compiledConfigs[configNumber], config);
+    }
+    return config;
+}
+
+//compile all configs in the background so switching to them is only a pointer swap.
+//Then write them to the config cache, so the next start does not have to compile anything.
+void Engine::startCompileWorker()
+{
+    stopCompileWorker();
+    compileWorkerStop = false;
+    string cacheFileName = writeConfigCacheWhenCompiled ? getConfigCacheFileName(iniFileName) : "";
+    compileWorker = thread([this](IniContent iniContent, unsigned long long iniHash, string cacheFileName)
+        {
+            for (int configNumber = 1; configNumber < MAX_CONFIGS && !compileWorkerStop; configNumber++)
+            {
+                if (atomic_load(&compiledConfigs[configNumber]))
+                    continue;
+                shared_ptr<const Config> config = parseProcessIniConfig(iniContent, configNumber);
+                shared_ptr<const Config> notYetCompiled;  //keep the one switchConfig() may have compiled meanwhile
+                atomic_compare_exchange_strong(&compiledConfigs[configNumber], &notYetCompiled, config);
+            }
+
+            if (cacheFileName.empty() || compileWorkerStop)
+                return;
+            ConfigCache cache;
+            cache.iniHash = iniHash;
+            cache.sanitizedIniContent = move(iniContent);
+            for (int configNumber = 1; configNumber < MAX_CONFIGS; configNumber++)
+                cache.configs[configNumber] = atomic_load(&compiledConfigs[configNumber]);
+            writeConfigCache(cacheFileName, cache);
+        }, sanitizedIniContent, iniHash, cacheFileName);
+}
+
+void Engine::waitForCompileWorker()
+{
+    if (compileWorker.joinable())
+        compileWorker.join();
+}
+
+void Engine::stopCompileWorker()
+{
+    compileWorkerStop = true;
+    if (compileWorker.joinable())
+        compileWorker.join();
+}
+
+void Engine::printConfigMessages(const Config &config)
+{
+    for (const ConfigMessage &message : config.messages)
+    {
+        switch (message.type)
+        {
+        case CONFIG_MESSAGE_INFO:
+            cout << message.text;
+            break;
+        case CONFIG_MESSAGE_DEBUG:
+            debugLog.flush();
+            IFDEBUG cout << message.text;
+            break;
+        case CONFIG_MESSAGE_ERROR:
+            error(message.text);
+            break;
+        }
+    }
+}
+
+//OPTIONs are switched on by a config, and stay on until reload
+void Engine::applyConfigOptions(const Config &config)
+{
+    if (config.options.debug) options.debug = true;
+    if (config.options.flipZy) options.flipZy = true;
+    if (config.options.flipAltWinOnAppleKeyboards) options.flipAltWinOnAppleKeyboards = true;
+    if (config.options.LControlLWinBlocksAlphaMapping) options.LControlLWinBlocksAlphaMapping = true;
+    if (config.options.processOnlyFirstKeyboard) options.processOnlyFirstKeyboard = true;
+    if (config.options.delayForKeySequenceMS >= 0) options.delayForKeySequenceMS = config.options.delayForKeySequenceMS;
+}
+
+//make a compiled config the active one. Returns false if the config is not valid.
+bool Engine::activateConfig(int configNumber)
+{
+    shared_ptr<const Config> config = getCompiledConfig(configNumber);
+    applyConfigOptions(*config);
+
+    printConfigMessages(*config);
+    if (!config->valid)
+        return false;
+
+    currentConfig = config;
+    globalState.activeConfigName = config->name;
+    return true;
+}
+
+void Engine::switchConfig(int config, bool forceReloadSameConfig)
+{
+    if (!forceReloadSameConfig && config == globalState.activeConfig)
+        return;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int oldConfig = globalState.activeConfig;
+    reset();
+
+    if (config == DISABLED_CONFIG_NUMBER)
+    {
+        globalState.activeConfig = DISABLED_CONFIG_NUMBER;
+        globalState.activeConfigName = DISABLED_CONFIG_NAME;
+    }
+    else if (activateConfig(config))
+    {
+        globalState.activeConfig = config;
+        globalState.previousConfig = oldConfig;
+        printOptions();
+    }
+    else if (activateConfig(oldConfig))
+    {
+        cout << endl << endl << "Keeping the current config";
+    }
+    else
+    {
+        cout << endl << endl << "ERROR: CANNOT RELOAD CURRENT CONFIG? Switching to config 0";
+        globalState.activeConfig = DISABLED_CONFIG_NUMBER;
+        globalState.activeConfigName = DISABLED_CONFIG_NAME;
+    }
+
+    profiler.lastConfigSwitchUS = (unsigned long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    if (profiler.lastConfigSwitchUS > profiler.worstConfigSwitchUS)
+        profiler.worstConfigSwitchUS = profiler.lastConfigSwitchUS;
+
+    host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+    cout << endl << endl << "ACTIVE CONFIG: " << globalState.activeConfig << " = " << globalState.activeConfigName;
+}
+
+void Engine::resetCapsNumScrollLock()
+{ 
+    //set NumLock, release CapsLock+Scrolllock
+    KeySequence sequence;
+    scheduler.waitUntilIdle();  //the OS state is only up to date when all keys are out
+    if (!output.isLockKeyOn(SC_NUMLOCK))
+        sequence.pressRelease(SC_NUMLOCK);
+    if (output.isLockKeyOn(SC_CAPS))
+        sequence.pressRelease(SC_CAPS);
+    if (output.isLockKeyOn(SC_SCRLOCK) && globals.capsicainOnOffKey != SC_SCRLOCK)  //don't mess with ScrLock when it is the enable/disable key
+        sequence.pressRelease(SC_SCRLOCK);
+    if (sequence.size() != 0)
+        playKeySequence(sequence);
+}
+
+void Engine::reset()
+{
+    releaseAllSentKeys();
+
+    loopState = defaultLoopState;
+    modifierState = defaultModifierState;
+    lookahead.key = -1;  //the held back keys are dropped; none of them was sent
+    lookahead.count = 0;
+    lookahead.deadline = chrono::steady_clock::time_point::max();
+    chordState.count = 0;
+    chordState.candidates = 0;
+    chordState.deadline = chrono::steady_clock::time_point::max();
+    composeState.node = 0;
+    composeState.count = 0;
+    composeState.deadline = chrono::steady_clock::time_point::max();
+    resetCount++;
+    for (DeviceState &deviceState : deviceStates)
+    {
+        deviceState.modifierState = defaultModifierState;
+        deviceState.described = false;  //config and include/exclude may have changed
+    }
+
+    GlobalState tmp = globalState; //some settings shall survive the reset
+    globalState = defaultGlobalState;
+    globalState.deviceIdKeyboard = tmp.deviceIdKeyboard;
+    globalState.activeConfig = tmp.activeConfig;
+    globalState.activeConfigName = tmp.activeConfigName;
+    globalState.previousConfig = tmp.previousConfig;
+    for(int i=0;i<MAX_NUM_MACROS;i++)
+        globalState.recordedMacros[i] = tmp.recordedMacros[i];
+}
+
+//Reset and reload the ini from scratch
+void Engine::reload()
+{
+    globals = defaultGlobals;
+    options = defaultOptions;
+    options.delayForKeySequenceMS = output.getDefaultKeySequenceDelayMS();
+
+    readIni();
+
+    parseIniGlobals();
+    switchConfig(globalState.activeConfig, true);
+    startCompileWorker();
+}
+
+//Release all keys to 'up' that have been sent out as 'down'
+void Engine::releaseAllSentKeys()
+{
+    debugLog.flush();
+    IFDEBUG cout << endl << "Resetting all sent DOWN keys to UP: " << endl;
+    for (int i = 0; i < 255; i++)
+    {
+        if (globalState.keysDownSent[i])
+        {
+            sendVKeyEvent({ i, false });
+        }
+    }
+}
+
+
+void Engine::printOptions()
+{
+    cout
+        << endl << endl << "OPTIONs"
+        << endl << (options.debug ? "ON :" : "off: --") << " debug output for each key event"
+        << endl << (options.flipZy ? "ON :" : "off: --") << " Z <-> Y"
+        << endl << (options.flipAltWinOnAppleKeyboards ? "ON :" : "off: --") << " Alt <-> Win for Apple keyboards"
+        << endl << (options.LControlLWinBlocksAlphaMapping ? "ON :" : "off: --") << " Left Control and Win block alpha key mapping ('Ctrl + C is never changed')"
+        << endl << (options.processOnlyFirstKeyboard ? "ON :" : "off: --") << " Process only the keyboard that sent the first key"
+        << endl
+        ;
+}
+
+void Engine::printStatus()
+{
+    int numMakeSent = 0;
+    for (int i = 0; i < 255; i++)
+    {
+        if (globalState.keysDownSent[i])
+            numMakeSent++;
+    }
+    cout << "STATUS" << endl << endl
+        << "Capsicain version: " << VERSION << endl
+        << "ini version: " << globals.iniVersion << endl
+        << "active config: " << globalState.activeConfig << " = " << globalState.activeConfigName << endl
+        << "Capsicain on/off key: [" << (globals.capsicainOnOffKey >= 0 ? getPrettyVKLabel(globals.capsicainOnOffKey) : "(not defined)") << "]" << endl
+        << "keyboard device id: " << globalState.deviceIdKeyboard << endl
+        << "Apple keyboard: " << globalState.deviceIsAppleKeyboard << endl
+        << "delay between keys in sequences (ms): " << options.delayForKeySequenceMS << endl
+        << "number of keys-down sent: " << dec <<   numMakeSent << endl
+        << "config switch time (microseconds): last " << dec << profiler.lastConfigSwitchUS << ", worst " << profiler.worstConfigSwitchUS
+        << ", compile time of the active config " << currentConfig->compileTimeUS << endl
+        << "ini load time (microseconds): " << profiler.iniLoadTimeUS << (configsFromCache ? " (compiled configs from cache)" : " (ini parsed)") << endl
+        << (errorLog.length() > 1 ? "ERROR LOG contains entries" : "clean error log") << " (" << dec << errorLog.length() << " chars)"
+        ;
+
+    cout << endl << endl;
+    latency.printSummary(cout);
+
+    printOptions();
+}
+
+bool Engine::processCommonCommand(int scancode)
+{
+    switch (scancode)
+    {
+    case SC_0:
+    {
+        cout << endl << "CONFIG CHANGE: " << DISABLED_CONFIG_NUMBER;
+        switchConfig(DISABLED_CONFIG_NUMBER, false);
+        break;
+    }
+    case SC_1:
+    case SC_2:
+    case SC_3:
+    case SC_4:
+    case SC_5:
+    case SC_6:
+    case SC_7:
+    case SC_8:
+    case SC_9:
+    {
+        int config = scancode - 1;
+        cout << endl << "CONFIG CHANGE: " << config;
+        switchConfig(config, false);
+        break;
+    }
+    case SC_BACK:
+    {
+        cout << endl << endl << "::RESET STATE and latency histograms";
+        reset();
+        latency.requestReset();
+        resetCapsNumScrollLock();
+        break;
+    }
+    case SC_W:
+        options.flipAltWinOnAppleKeyboards = !options.flipAltWinOnAppleKeyboards;
+        cout << "Flip ALT<>WIN for Apple boards: " << (options.flipAltWinOnAppleKeyboards ? "ON" : "OFF") << endl;
+        break;
+    case SC_Z:
+        options.flipZy = !options.flipZy;
+        cout << "Flip Z<>Y mode: " << (options.flipZy ? "ON" : "OFF");
+        break;
+    case SC_E:
+        cout << "ERROR LOG: " << endl << errorLog << endl;
+        break;
+    case SC_R:
+        cout << "RELOAD INI";
+        reload();
+        getHardwareId();
+        cout << endl << (globalState.deviceIsAppleKeyboard ? "APPLE keyboard (flipping Win<>Alt)" : "PC keyboard");
+        break;
+    case SC_I:
+    {
+        cout << "INI filtered for config " << globalState.activeConfigName;
+        vector<IniLine> tmpAssembledConfig = assembleConfig(globalState.activeConfig);
+        for (const IniLine &line : tmpAssembledConfig)
+            cout << endl << line.text;
+        break;
+    }
+    case SC_S:
+        printStatus();
+        break;
+    case SC_F:
+    {
+        //the files only name the typed keys in debug mode; they may contain passwords
+        bool withKeys = options.debug;
+        flightRecorder.print(cout, 20, true);
+        ofstream flightFile(FLIGHT_FILE_NAME, ios::trunc);
+        flightRecorder.print(flightFile, FLIGHT_RECORDER_SIZE, withKeys);
+        cout << endl << "FLIGHT RECORDER -> " << FLIGHT_FILE_NAME << ": " << (flightFile ? "OK" : "cannot write the file");
+        cout << endl << "trace -> " << TRACE_FILE_NAME << ": " << (flightRecorder.writeTrace(TRACE_FILE_NAME, withKeys) ? "OK (open in ui.perfetto.dev)" : "cannot write the file");
+        if (withKeys)
+            cout << endl << "WARNING: debug mode is on, the files contain the last " << FLIGHT_RECORDER_SIZE << " keys you typed, passwords included. Delete them when done.";
+        else
+            cout << endl << "The files leave out which keys were typed. [ESC]+[D] debug mode includes them.";
+        break;
+    }
+    case SC_G:
+        if (capture.isActive())
+        {
+            capture.stop();
+            cout << "CAPTURE stopped: " << dec << capture.count() << " strokes in " << CAPTURE_FILE_NAME;
+        }
+        else if (capture.start(CAPTURE_FILE_NAME, getIniHash(), clock.now()))
+            cout << "CAPTURE all input to " << CAPTURE_FILE_NAME << ". [ESC]+[G] again to stop. Replay with capsicain_replay.";
+        else
+            cout << "CAPTURE: cannot write " << CAPTURE_FILE_NAME;
+        host.showCapture(capture.isActive());
+        break;
+    case SC_P:
+        cout << "LATENCY histograms -> " << LATENCY_FILE_NAME << ": " << (latency.writeFile(LATENCY_FILE_NAME) ? "OK" : "cannot write the file");
+        break;
+    case SC_D:
+        options.debug = !options.debug;
+        cout << "DEBUG mode: " << (options.debug ? "ON" : "OFF");
+        break;
+    case SC_J:
+        cout << "MACRO 0 START RECORDING";
+        globalState.recordingMacro = 0;
+        globalState.recordedMacros[0].clear();
+        host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+        break;
+    case SC_K:
+        if (globalState.recordingMacro == 0)
+        {
+            vector<SeqOp> &macro = globalState.recordedMacros[0].ops;
+            while (macro.size() > 0 && getSeqOpcode(macro.back()) == SEQ_PRESS)  //remove all key down at the end, caused by pressing ESC+K
+                macro.pop_back();
+            while (macro.size()>0 && getSeqOpcode(macro.front()) != SEQ_PRESS)  //remove all key-up at the beginning, caused by releasing the shortcut ESC+J
+                macro.erase(macro.begin());
+            cout << "MACRO 0 STOP RECORDING (" << globalState.recordedMacros[0].size() << ")";
+        }
+        else
+            cout << "MACRO 0 RECORDING ALREADY STOPPED";
+
+        globalState.recordingMacro = -1;
+        host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+        break;
+    case SC_L:
+        cout << "MACRO 0 PLAYBACK";
+        playKeySequence(globalState.recordedMacros[0]);
+        break;
+    case SC_C:
+        cout << "List of all Key Labels for scancodes" << endl
+             << "------------------------------------" << endl;
+        for (int i = 0; i <= 255; i++)
+            cout << "sc " << uppercase << hex << i << " = " << PRETTY_VK_LABELS[i] << endl;
+        cout << nouppercase << dec;
+        break;
+    case SC_COMMA:
+        if (options.delayForKeySequenceMS >= 1)
+            options.delayForKeySequenceMS -= 1;
+        cout << "delay between characters in key sequences (ms): " << dec << options.delayForKeySequenceMS;
+        break;
+    case SC_DOT:
+        if (options.delayForKeySequenceMS <= 100)
+            options.delayForKeySequenceMS += 1;
+        cout << "delay between characters in key sequences (ms): " << dec << options.delayForKeySequenceMS;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+void printIKStrokeState(InterceptionKeyStroke iks)
+{
+    cout << endl << "IKS: " << hex << iks.code
+        << " " << iks.state
+        << " = " << getPrettyVKLabel(iks.code)
+        << " i" << iks.information;
+}
+
+//what kind of result the latency of this key counts for
+LATENCY_OUTCOME Engine::getLatencyOutcome()
+{
+    int presses = 0;
+    for (SeqOp op : loopState.resultingKeySequence.ops)
+    {
+        SEQ_OPCODE opcode = getSeqOpcode(op);
+        if (opcode == SEQ_PRESS)
+            presses++;
+        else if (opcode != SEQ_RELEASE)
+            return LATENCY_SEQUENCE;
+    }
+    if (presses > 1)
+        return LATENCY_SEQUENCE;
+    if (loopState.combo >= 0)
+        return LATENCY_COMBO;
+    if (presses > 0 || loopState.vcode != loopState.scancode)
+        return LATENCY_REWIRE;
+    return LATENCY_PASSTHROUGH;
+}
+
+//what the mapping decided, for the flight recorder
+void Engine::recordFlightResult(FlightRecord &record)
+{
+    record.vcodeMapped = loopState.vcode;
+    record.combo = loopState.combo;
+    record.sequenceSize = (unsigned short)loopState.resultingKeySequence.size();
+    record.firstKeyOut = loopState.vcode;
+    if (loopState.resultingKeySequence.size() > 0)
+    {
+        record.firstKeyOut = -1;
+        for (SeqOp op : loopState.resultingKeySequence.ops)
+        {
+            SEQ_OPCODE opcode = getSeqOpcode(op);
+            if (opcode == SEQ_SECRET)
+                break;
+            if (opcode == SEQ_PRESS || opcode == SEQ_RELEASE)
+            {
+                record.firstKeyOut = getSeqArg(op);
+                break;
+            }
+        }
+    }
+}
+
+void normalizeIKStroke(InterceptionKeyStroke &ikstroke) {
+    if (ikstroke.code > 0x7F) {
+        ikstroke.code &= 0x7F;
+        ikstroke.state |= 2;
+    }
+}
+
+InterceptionKeyStroke convertVkeyEvent2ikstroke(VKeyEvent vkstroke)
+{
+    InterceptionKeyStroke iks = { (unsigned short) vkstroke.vcode, 0 };
+
+    if (vkstroke.vcode >= 0xFF)
+    {
+        cout << endl << "BUG: trying to send an interception keystroke > xFF";
+        iks.code = SC_NOP;
+    }
+
+    if (vkstroke.vcode >= 0x80)
+    {
+        iks.code = static_cast<unsigned short>(vkstroke.vcode & 0x7F);
+        iks.state |= 2;
+    }
+    if (!vkstroke.isDownstroke)
+        iks.state |= 1;
+
+    return iks;
+}
+
+VKeyEvent convertIkstroke2VKeyEvent(InterceptionKeyStroke ikStroke)
+{
+    VKeyEvent strk;
+    strk.vcode = ikStroke.code;
+    if ((ikStroke.state & 2) == 2)
+        strk.vcode |= 0x80;
+    strk.isDownstroke = ikStroke.state & 1 ? false : true;
+    return strk;
+}
+
+//handle all special Capsicain VCodes that have no "second key param". Trigger events on downstroke only
+void Engine::sendCapsicainCodeHandler(VKeyEvent keyEvent)
+{
+    if (!keyEvent.isDownstroke)
+        return;
+
+    IFTRACE cout << endl << "(CPS code: " << getPrettyVKLabelPadded(keyEvent.vcode, 0) << ")";
+
+    switch (keyEvent.vcode)
+    {
+    case VK_CPS_CAPSON:
+    {
+        scheduler.waitUntilIdle();
+        if (!output.isLockKeyOn(SC_CAPS))
+        {
+            sendVKeyEvent({ SC_CAPS, true });
+            sendVKeyEvent({ SC_CAPS, false });
+        }
+        break;
+    }
+    case VK_CPS_CAPSOFF:
+    {
+        scheduler.waitUntilIdle();
+        if (output.isLockKeyOn(SC_CAPS))
+        {
+            sendVKeyEvent({ SC_CAPS, true });
+            sendVKeyEvent({ SC_CAPS, false });
+        }
+        break;
+    }
+    case VK_CPS_CONFIGPREVIOUS:
+    {
+        switchConfig(globalState.previousConfig, false);
+        break;
+    }
+    case VK_CPS_OBFUSCATED_SEQUENCE_START:
+    {
+        globalState.secretSequencePlayback = true;
+        break;
+    }
+    case VK_CPS_PAUSE:
+        if (globals.protectConsole && host.isConsoleForeground())
+        {
+            debugLog.flush();
+            cout << endl << endl << "INFO: Discarding the PAUSE key. " << endl 
+                << "      This would freeze Capsicain which is currently the active window (and this would stop your keyboard)";
+            break;
+        }
+        
+        //manually send a PAUSE sequence with E1 escape (iks state 4/5)
+        IFTRACE cout << endl << "sending the Pause key sequence E1 LCTRL NUMLOCK";
+        InterceptionKeyStroke iks_cont = {SC_LCTRL,4,0};
+        scheduler.send(interceptionState.interceptionDevice, &iks_cont, 1);
+        InterceptionKeyStroke iks_numl = { SC_NUMLOCK,0,0 };
+        scheduler.send(interceptionState.interceptionDevice, &iks_numl, 1);
+        iks_cont.state = 5;
+        scheduler.send(interceptionState.interceptionDevice, &iks_cont, 1);
+        iks_numl.state = 1;
+        scheduler.send(interceptionState.interceptionDevice, &iks_numl, 1);
+
+        break;
+    }
+}
+
+void Engine::sendResultingKeyOrSequence()
+{
+    if (loopState.resultingKeySequence.size() > 0)
+    {
+        playKeySequence(loopState.resultingKeySequence);
+    }
+    else
+    {
+        IFDEBUG debugLog.write(DEBUG_RESULT_KEY, loopState.scancode, loopState.vcode, interceptionState.currentIKstroke.state);
+        {
+            sendVKeyEvent({ loopState.vcode, loopState.isDownstroke });
+        }
+    }
+}
+
+//Send out all keys in a sequence
+//Sequences are created for anything that requires more than one key event, like AltChar(123)
+//Runs the sequence bytecode, see keySequence.h
+void Engine::playKeySequence(const KeySequence &sequence)
+{
+    if (sequence.size() == 0) 
+    {
+        cout << endl << "BUG? keySequence.size == 0" << endl;
+        return;
+    }
+
+    unsigned int delayBetweenKeyEventsMS = options.delayForKeySequenceMS;
+
+    //active SEQ_REPEAT loops: where the body starts, how many more times to play it
+    struct RepeatFrame
+    {
+        size_t bodyStart;
+        int remaining;
+    } repeats[SEQ_MAX_REPEAT_NESTING];
+    int repeatDepth = 0;
+
+    IFDEBUG
+        if (!globalState.secretSequencePlayback && getSeqOpcode(sequence.ops.at(0)) != SEQ_SECRET)
+             debugLog.write(DEBUG_SEQUENCE, (int)sequence.size());
+
+    for (size_t pc = 0; pc < sequence.ops.size(); pc++)
+    {
+        SeqOp op = sequence.ops[pc];
+        int arg = getSeqArg(op);
+
+        switch (getSeqOpcode(op))
+        {
+        case SEQ_PRESS:
+        case SEQ_RELEASE:
+        {
+            int vc = globalState.secretSequencePlayback ? deObfuscateVKey(arg) : arg;
+            sendVKeyEvent({ vc, getSeqOpcode(op) == SEQ_PRESS });
+            if (vc == AHK_HOTKEY1 || vc == AHK_HOTKEY2)
+                scheduler.pause(DEFAULT_DELAY_FOR_AHK_MS);
+            else
+                scheduler.pause(delayBetweenKeyEventsMS);
+            break;
+        }
+        case SEQ_SLEEP:
+            IFTRACE cout << endl << "seq sleep: " << arg;
+            scheduler.pause(arg);
+            break;
+        case SEQ_REPEAT:
+            if (repeatDepth >= SEQ_MAX_REPEAT_NESTING)
+            {
+                error("Key sequence repeats are nested too deep. Playing the inner sequence once.");
+                break;
+            }
+            repeats[repeatDepth++] = { pc + 1, arg - 1 };
+            break;
+        case SEQ_REPEAT_END:
+            if (repeatDepth > 0)
+            {
+                RepeatFrame &frame = repeats[repeatDepth - 1];
+                if (frame.remaining > 0)
+                {
+                    frame.remaining--;
+                    pc = frame.bodyStart - 1;
+                }
+                else
+                    repeatDepth--;
+            }
+            break;
+        case SEQ_TEMPRELEASEKEYS: //release and remember all keys that are physically down
+            for (int i = 0; i <= 255; i++)
+            {
+                globalState.keysDownTempReleased[i] = globalState.keysDownSent[i];
+                if (globalState.keysDownSent[i])
+                    sendVKeyEvent({ i, false });
+            }
+            if (globalState.keysDownSentCounter != 0)
+                error("BUG: keysDownSentCounter != 0");
+            break;
+        case SEQ_TEMPRESTOREKEYS: //restore all keys that were down before 'SEQ_TEMPRELEASEKEYS'
+            for (int i = 0; i <= 255; i++)
+            {
+                if (globalState.keysDownTempReleased[i])
+                {
+                    sendVKeyEvent({ i, true });
+                    globalState.keysDownTempReleased[i] = false;
+                }
+            }
+            break;
+        case SEQ_DEADKEY:
+            IFTRACE cout << endl << "seq deadkey: " << getPrettyVKLabelPadded(arg, 0);
+            modifierState.activeDeadkey = arg;
+            break;
+        case SEQ_CONFIGSWITCH:
+            IFTRACE cout << endl << "seq configswitch: " << arg;
+            switchConfig(arg, false);
+            break;
+        case SEQ_RECORDMACRO:
+        case SEQ_RECORDSECRETMACRO:
+        {
+            int macroNum = arg;
+            bool isSecret = getSeqOpcode(op) == SEQ_RECORDSECRETMACRO;
+
+            if (macroNum < 1 || macroNum >= MAX_NUM_MACROS)
+            {
+                debugLog.flush();
+                cout << endl << "ERROR in .ini: bad number for macro. Must be 1.." << MAX_NUM_MACROS - 1;
+            }
+            else if (globalState.recordingMacro != -1)
+            {
+                debugLog.flush();
+                cout << endl << "INFO: a macro is already being recorded: #" << globalState.recordingMacro;
+            }
+            else
+            {
+                IFDEBUG debugLog.write(DEBUG_START_RECORDING, macroNum, isSecret);
+                globalState.recordingMacro = macroNum;
+                globalState.recordedMacros[macroNum].clear();
+
+                if (isSecret)
+                {
+                    globalState.secretSequenceRecording = true;
+                    globalState.recordedMacros[macroNum].add(SEQ_SECRET);
+                }
+            }
+            host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+            break;
+        }
+        case SEQ_PLAYMACRO:
+        {
+            IFTRACE cout << endl << "seq playmacro: " << arg;
+            int macnum = arg;
+
+            if (macnum < 1 || macnum >= MAX_NUM_MACROS)
+            {
+                debugLog.flush();
+                cout << endl << "ERROR: bad number for macro. Must be 1.." << MAX_NUM_MACROS - 1;
+            }
+            else
+            {
+                if (globalState.recordedMacros[macnum].size() == 0)
+                {
+                    debugLog.flush();
+                    cout << endl << "INFO macro #" << macnum << " has not been recorded before.";
+                }
+                else
+                {
+                    playKeySequence(globalState.recordedMacros[macnum]);
+                    globalState.secretSequencePlayback = false;
+                }
+            }
+            break;
+        }
+        case SEQ_SECRET:
+            globalState.secretSequencePlayback = true;
+            break;
+        default:
+            error("BUG: unknown key sequence opcode " + to_string(getSeqOpcode(op)));
+        }
+    }
+
+    if (repeatDepth != 0)
+        error("BUG: key sequence repeat without end");
+}
+
+
+void Engine::sendVKeyEvent(VKeyEvent keyEvent)
+{
+    IFTRACE cout << endl << "sendVkeyEvent(" << keyEvent.vcode << ")";
+    if (keyEvent.vcode < 0)
+    {
+        cout << endl << "BUG: vcode<0";
+        return;
+    }
+    if (keyEvent.vcode == 0)
+    {
+        debugLog.write(DEBUG_BLOCKED_NOP);  //not only in debug mode; through the log to keep the order
+        return;
+    }
+    if (keyEvent.vcode > 0xFF || keyEvent.vcode == VK_CPS_PAUSE)
+    {
+        sendCapsicainCodeHandler(keyEvent);
+        return;
+    }
+
+    unsigned char scancode = (unsigned char) keyEvent.vcode;
+
+    if (scancode == 0xE4)  //what was that for?
+        IFDEBUG debugLog.write(DEBUG_SEND_E4);
+
+    if (!keyEvent.isDownstroke &&  !globalState.keysDownSent[scancode])  //ignore up when key is already up
+    {
+        IFDEBUG debugLog.write(DEBUG_BLOCKED_UP, scancode);
+        return;
+    }
+
+    //Cancel the tapped LWIN opening the pesky Start menu
+    if (globals.deactivateWinkeyStartmenu
+        && scancode == SC_LWIN && !keyEvent.isDownstroke && globalState.keysDownSent[SC_LWIN]
+        && ( globalState.lastSentKeyEvent.vcode == SC_LWIN)
+        )
+    {
+        IFDEBUG debugLog.write(DEBUG_WINKEY_NO_MENU);
+        SendShiftDownUp();
+    }
+
+    //consistency check
+    if (globalState.keysDownSent[scancode] == 0 && keyEvent.isDownstroke)
+        globalState.keysDownSentCounter++;
+    else if (globalState.keysDownSent[scancode] == 1 && !keyEvent.isDownstroke)
+        globalState.keysDownSentCounter--;
+
+    globalState.keysDownSent[scancode] = keyEvent.isDownstroke;
+    if (keyEvent.isDownstroke)
+        globalState.keysDownSentBy[scancode] = loadedDevice;
+
+    //handle live macro recording
+    if (globalState.recordingMacro >= 0)
+    {
+        if (globalState.recordedMacros[globalState.recordingMacro].size() >= MAX_MACRO_LENGTH -2)  //macro getting too big
+        {
+            globalState.recordingMacro = -1;
+            globalState.secretSequenceRecording = false;
+            host.updateTrayIcon(true, globalState.recordingMacro >= 0, globalState.activeConfig);
+            debugLog.flush();
+            cout << endl << endl << "Macro Length > " << MAX_MACRO_LENGTH << ". Forgotten Macro?" << "Stop recording macro #" << globalState.recordingMacro << endl << endl;
+        }
+        else
+        { 
+            //drop upstroke from the starting shortcut?
+            if (keyEvent.isDownstroke || globalState.recordedMacros[globalState.recordingMacro].size() > 0 )
+            {
+                //store the macro obfuscated?
+                int vcode = globalState.secretSequenceRecording ? obfuscateVKey(keyEvent.vcode) : keyEvent.vcode;
+                globalState.recordedMacros[globalState.recordingMacro].add(keyEvent.isDownstroke ? SEQ_PRESS : SEQ_RELEASE, vcode);
+            }
+        }
+    }
+    
+    InterceptionKeyStroke iks = convertVkeyEvent2ikstroke(keyEvent);
+    //hide secret macro recording?
+    IFDEBUG
+        if(!globalState.secretSequencePlayback)
+            debugLog.write(DEBUG_SENT, keyEvent.vcode, keyEvent.isDownstroke, globalState.keysDownSentCounter);
+
+    scheduler.send(interceptionState.interceptionDevice, &iks, 1);
+    globalState.lastSentKeyEvent = keyEvent;
+
+    //restore LEDs for ON/OFF indication?
+    if (globals.capsicainOnOffKey >0 
+        && keyEvent.isDownstroke
+        && (globals.capsicainOnOffKey == SC_NUMLOCK || globals.capsicainOnOffKey == SC_SCRLOCK || globals.capsicainOnOffKey == SC_CAPS)
+        && (keyEvent.vcode == SC_NUMLOCK || keyEvent.vcode == SC_SCRLOCK || keyEvent.vcode == SC_CAPS ) 
+        //does ESC reset ScrLock on some KBs? In that case re-enable ESC check  || keyEvent.vcode == SC_ESCAPE)
+        )
+    {
+        scheduler.waitUntilIdle();
+        clock.sleepMS(50); //give Windows time to register e.g. NumLock key event, since soon we will query its state
+        host.setLED(globals.capsicainOnOffKey, true);
+    }
+}
+
+//send shift down+up keystrokes; used to break the hardwired tapped Win -> start menu combo
+void Engine::SendShiftDownUp()
+{
+    IFDEBUG debugLog.write(DEBUG_SHIFT_DOWN_UP);
+    InterceptionKeyStroke iks[2] = { convertVkeyEvent2ikstroke({ SC_LSHIFT, true }), convertVkeyEvent2ikstroke({ SC_LSHIFT, false }) };
+    scheduler.send(interceptionState.interceptionDevice, iks, 2);
+}
+
+
+string getSymbolForIKStrokeState(unsigned short state)
+{
+    switch (state)
+    {
+    case 0b000: return "v";
+    case 0b001: return "^";
+    case 0b010: return "v*";
+    case 0b011: return "^*";
+    case 0b100: return "v**";
+    case 0b101: return "^**";
+    case 0b001000: return "??TERMSRV_SET_LED down??";
+    case 0b001001: return "??TERMSRV_SET_LED up??";
+    case 0b010000: return "??TERMSRV_SHADOW down??";
+    case 0b010001: return "??TERMSRV_SHADOW up??";
+    case 0b100000: return "??TERMSRV_VKPACKET down??";
+    case 0b100001: return "??TERMSRV_VKPACKET up??";
+    }
+    return "???" + to_string(state);
+}
+
+int obfuscateVKey(int vk)
+{
+    return vk ^ 0b0101010101010101;
+}
+int deObfuscateVKey(int vk)
+{
+    return vk ^ 0b0101010101010101;
+}
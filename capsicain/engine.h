@@ -0,0 +1,597 @@
+#pragma once
+
+// The platform independent key processing pipeline.
+// Everything that touches the OS (Interception driver, console, tray, LEDs, Sleep) goes through
+// the EngineInput / EngineOutput / EngineClock / EngineHost interfaces below, so the engine builds
+// and runs headless (see CMakeLists.txt and headless.cpp).
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <bitset>
+
+#include "interception.h"  //only for the InterceptionKeyStroke / InterceptionDevice types
+#include "constants.h"
+#include "configUtils.h"
+#include "scancodes.h"
+#include "compiledConfig.h"
+#include "outputScheduler.h"
+#include "latencyStats.h"
+#include "debugLog.h"
+#include "flightRecorder.h"
+#include "inputCapture.h"
+
+#define IFDEBUG if(options.debug && !globalState.secretSequenceRecording)
+#define IFTRACE if(false)  //set to (true) for extra detail output
+
+enum KEYSTATE
+{
+    KEYSTATE_DOWN = 0,
+    KEYSTATE_UP = 1,
+    KEYSTATE_E0_DOWN = 2,
+    KEYSTATE_E0_UP = 3,
+    KEYSTATE_E1_DOWN = 4,
+    KEYSTATE_E1_UP = 5
+};
+
+
+enum INPUT_RESULT
+{
+    INPUT_STROKE,
+    INPUT_TIMEOUT,
+    INPUT_CLOSED,
+    INPUT_DEVICE_REMOVED  //the keyboard was unplugged, or its device number goes to a new one. No stroke.
+};
+
+//where the keys come from. Windows: Interception driver
+class EngineInput
+{
+public:
+    virtual ~EngineInput() {}
+    //blocks until the next stroke arrives. Returns false if the input is closed.
+    virtual bool receive(InterceptionDevice &device, InterceptionKeyStroke &stroke) = 0;
+    //like receive(), but gives up at deadline. An input that cannot wait with a timeout ignores the deadline.
+    virtual INPUT_RESULT receiveUntil(InterceptionDevice &device, InterceptionKeyStroke &stroke, std::chrono::steady_clock::time_point deadline)
+    {
+        return receive(device, stroke) ? INPUT_STROKE : INPUT_CLOSED;
+    }
+    //when the hardware stamped the last received stroke, in steady_clock time. time_point() if the input does not know.
+    virtual std::chrono::steady_clock::time_point lastStrokeTime() { return std::chrono::steady_clock::time_point(); }
+};
+
+//where the keys go to. Windows: Interception driver
+class EngineOutput
+{
+public:
+    virtual ~EngineOutput() {}
+    virtual void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) = 0;
+    //state of the locking keys as the OS sees it. scancode is SC_CAPS, SC_NUMLOCK or SC_SCRLOCK
+    virtual bool isLockKeyOn(int scancode) = 0;
+    //pause between the strokes of a key sequence when the config does not set delayForKeySequenceMS.
+    //An output that cannot lose strokes sent back to back needs none.
+    virtual unsigned int getDefaultKeySequenceDelayMS() { return DEFAULT_DELAY_FOR_KEY_SEQUENCE_MS; }
+};
+
+class EngineClock
+{
+public:
+    virtual ~EngineClock() {}
+    virtual std::chrono::steady_clock::time_point now() = 0;
+    virtual void sleepMS(unsigned int ms) = 0;
+    //used by the output scheduler for the pauses in key sequences; should not wake up late
+    virtual void sleepUntil(std::chrono::steady_clock::time_point time) = 0;
+};
+
+//wall clock, real sleeps
+class SteadyClock : public EngineClock
+{
+public:
+    std::chrono::steady_clock::time_point now() override;
+    void sleepMS(unsigned int ms) override;
+    void sleepUntil(std::chrono::steady_clock::time_point time) override;
+};
+
+//everything else the engine needs from the application around it. Defaults do nothing.
+class EngineHost
+{
+public:
+    virtual ~EngineHost() {}
+    //raw hardware id of the device, "UNKNOWN_ID" if it cannot be determined
+    virtual std::string getHardwareId(InterceptionDevice device) { return "UNKNOWN_ID"; }
+    //capsicain console is the active window (Pause/Break would freeze it)
+    virtual bool isConsoleForeground() { return false; }
+    virtual void updateTrayIcon(bool enabled, bool recording, int activeConfig) {}
+    virtual void setLED(int scancode, bool on) {}
+    //the input capture (ESC+G) started or stopped. It records every key, so it must not run unnoticed.
+    virtual void showCapture(bool active) {}
+    //[ESC] + key command. Return false to stop capsicain. Engine::processCommonCommand() has the ones all hosts share.
+    virtual bool processCommand(int scancode) { return true; }
+};
+
+//GLOBAL DeviceConfig <part of the device id> <config>
+struct DeviceConfigRule
+{
+    std::string deviceIdPart;
+    int config;
+};
+
+//only written on ini load
+struct Globals
+{
+    std::string iniVersion = "unnamed version - add 'iniVersion xyz123' to capsicain.ini";
+    int activeConfigOnStartup = DEFAULT_ACTIVE_CONFIG;
+    bool startMinimized = false;
+    bool startInTraybar = false;
+    bool startAHK = false;
+    int capsicainOnOffKey = -1;
+    bool protectConsole = true; //drop Pause and Break signals when console is foreground
+    bool translateMessyKeys = true; //translate various DOS keys (e.g. Ctrl+Pause=SC_Break -> SC_Pause, Alt+Print=SC_altprint -> sc_print)
+    bool deactivateWinkeyStartmenu = false;
+    std::vector<DeviceConfigRule> deviceConfigs;  //first match wins
+};
+
+//can be toggled with ESC commands
+struct Options
+{
+    bool debug = false;
+    int delayForKeySequenceMS = DEFAULT_DELAY_FOR_KEY_SEQUENCE_MS;
+    bool flipZy = false;
+    bool flipAltWinOnAppleKeyboards = false;
+    bool LControlLWinBlocksAlphaMapping = false;
+    bool processOnlyFirstKeyboard = false;
+};
+
+struct ModifierCombo
+{
+    int vkey = SC_NOP;
+    unsigned char deadkey = 0;
+    unsigned short modAnd = 0;
+    unsigned short modOr = 0;
+    unsigned short modNot = 0;
+    unsigned short modTap = 0;
+    KeySequence keySequence;
+};
+
+struct AllMaps
+{
+    //inkey outkey (tapped)
+    //-1 = undefined key
+    int rewiremap[REWIRE_ROWS][REWIRE_COLS] = { }; //MUST initialize this manually to -1 !!
+
+    std::vector<ModifierCombo> modCombos;// = new vector<ModifierCombo>();
+
+    //compact copy of the combo conditions, grouped by vkey in definition order (first match wins).
+    //comboMatches[comboIndex[vk] .. comboIndex[vk+1]) are the candidates for vk. Built by indexCombos().
+    struct ComboMatch
+    {
+        unsigned char deadkey;
+        unsigned short modAnd;
+        unsigned short modOr;
+        unsigned short modNot;
+        unsigned short modTap;
+        unsigned int combo;  //index into modCombos
+    };
+    std::vector<ComboMatch> comboMatches;
+    unsigned int comboIndex[MAX_VCODES + 1] = { };
+
+    int alphamap[MAX_VCODES] = { }; //MUST initialize this manually to 1 1, 2 2, 3 3, ...
+
+    //CHORD rules. Bit c of chordsOfKey[sc] is set if chords[c] has the key sc, chordsOfSize[n] has the chords of n keys.
+    //The chords that the keys pressed so far can still complete are the AND of their chordsOfKey, see detectChord().
+    struct Chord
+    {
+        unsigned char keys[MAX_CHORD_KEYS];  //scancodes
+        unsigned char size;
+        KeySequence keySequence;
+    };
+    std::vector<Chord> chords;
+    unsigned long long chordsOfKey[256] = { };
+    unsigned long long chordsOfSize[MAX_CHORD_KEYS + 1] = { };
+
+    unsigned char layerKeys[256] = { };  //LAYER key config: holding the key puts the config on top. 0 = not a layer key
+
+    //COMPOSE rules as a trie, one row per node and one column per key that is in any of them (column 0: all other keys).
+    //The node after key sc is composeNext[node * composeColumns + composeColumn[sc]], 0 (the root) if no sequence goes on with sc.
+    //So a key costs one table lookup, however many sequences there are. See detectCompose()
+    struct ComposeNode
+    {
+        int sequence;  //index into composeSequences of the sequence that ends here, -1: none
+        bool hasNext;    //longer sequences go on from here
+    };
+    unsigned char composeColumn[256] = { };
+    int composeColumns = 1;
+    std::vector<unsigned short> composeNext{ 0 };
+    std::vector<ComposeNode> composeNodes{ { -1, false } };  //[0] is the root
+    std::vector<KeySequence> composeSequences;
+
+    CompiledConfig compiled;  //all of the above folded into one table, see compileConfig()
+};
+
+//what the OPTION lines of a config set. A config only switches options on; they stay on until reload.
+struct ConfigOptions
+{
+    bool debug = false;
+    bool flipZy = false;
+    bool flipAltWinOnAppleKeyboards = false;
+    bool LControlLWinBlocksAlphaMapping = false;
+    bool processOnlyFirstKeyboard = false;
+    int delayForKeySequenceMS = -1;  //-1: not set
+    int tappingTermMS = -1;  //a key released later than this is not tapped. -1: no limit (autorepeat ends a tap). REWIRE can set it per key
+    int chordTermMS = DEFAULT_CHORD_TERM_MS;
+    int composeTermMS = DEFAULT_COMPOSE_TERM_MS;
+};
+
+enum CONFIG_MESSAGE_TYPE
+{
+    CONFIG_MESSAGE_INFO,
+    CONFIG_MESSAGE_DEBUG,
+    CONFIG_MESSAGE_ERROR
+};
+
+struct ConfigMessage
+{
+    CONFIG_MESSAGE_TYPE type;
+    std::string text;
+};
+
+//one [config_N] section, parsed and compiled. Never changed once built, so the compile worker can
+//build it in the background and switchConfig() only swaps a pointer.
+struct Config
+{
+    int number = -1;
+    bool valid = false;  //false if the section is missing or empty
+    std::string name = DEFAULT_ACTIVE_CONFIG_NAME;
+    std::string includeDeviceId = "";
+    std::string excludeDeviceId = "";
+    ConfigOptions options;
+    AllMaps maps;
+    unsigned long compileTimeUS = 0;
+
+    //parser output, printed each time the config is activated
+    std::vector<ConfigMessage> messages;
+    void info(const std::string &text) { messages.push_back({ CONFIG_MESSAGE_INFO, text }); }
+    void debug(const std::string &text) { messages.push_back({ CONFIG_MESSAGE_DEBUG, text }); }
+    void error(const std::string &text) { messages.push_back({ CONFIG_MESSAGE_ERROR, text }); }
+};
+
+struct InterceptionState
+{
+    int newKeyboardCounter = 0;
+    InterceptionDevice interceptionDevice = 0;
+    InterceptionDevice previousInterceptionDevice = 0;
+    InterceptionKeyStroke currentIKstroke = { SC_NOP, 0 };
+    InterceptionKeyStroke previousIKstroke1 = { SC_NOP, 0 }; //remember history
+    InterceptionKeyStroke previousIKstroke2 = { SC_NOP, 0 };
+};
+
+struct GlobalState
+{
+    bool capsicainOn = true;
+
+    int  activeConfig = 0;
+    std::string activeConfigName = DEFAULT_ACTIVE_CONFIG_NAME;
+    int previousConfig = 1; // switch to this on func(CONFIGPREVIOUS)
+
+    bool realEscapeIsDown = false;
+
+    std::string deviceIdKeyboard = "";
+
+    bool deviceIsAppleKeyboard = false;
+
+    int keysDownSentCounter = 0;  //tracks how many keys are actually down that Windows knows about
+    bool keysDownSent[256] = { false };  //Remember all forwarded to Windows. Sent keys must be 8 bit
+    InterceptionDevice keysDownSentBy[256] = { 0 };  //the keyboard whose stroke sent the key down
+    bool keysDownTempReleased[256] = { false };  //Remember all keys that were temporarily released, e.g. to send an Alt-Numpad combo
+    VKeyEvent lastSentKeyEvent = { SC_NOP, 0 };  //Remember the last key sent to Windows (to detect tapping of a rewired Win key)
+
+    bool secretSequenceRecording = false;
+    bool secretSequencePlayback = false;
+    int recordingMacro = -1; //-1: not recording. 1..MAX_SIMPLE_MACROS : this is currently recording. 0=currently recording the 'hard' ESC+J macro
+    KeySequence recordedMacros[MAX_NUM_MACROS];  // [0] stores the 'hard' macro
+};
+
+//what a physical key is doing, for tapping and tap-and-hold. See detectTapping().
+//Only the tap candidate can be PRESSED and only the last tap TAPPED; any number of keys can be HELD or TAPHELD.
+enum TAPSTATE : unsigned char
+{
+    TAPSTATE_IDLE = 0,  //up
+    TAPSTATE_TAPPED,    //up, tapped last; pressed again within its term it is tap-and-hold
+    TAPSTATE_PRESSED,   //down, can still be a tap
+    TAPSTATE_HELD,      //down, not a tap anymore (another key pressed, term over, autorepeat)
+    TAPSTATE_TAPHELD,   //down as tap-and-hold: its IfTap+Hold key is down
+};
+
+struct ModifierState
+{
+    unsigned char activeDeadkey = 0;  //it's not really a modifier though...
+    unsigned short modifierDown = 0;
+    unsigned short modifierTapped = 0;
+    std::vector<VKeyEvent> modsTempAltered;
+
+    //tapping, see detectTapping(). The deadlines are resolved by processTimers()
+    TAPSTATE tapState[256] = { };  //by scancode
+    int tapCandidate = -1;  //scancode of the key pressed last, while it is down and within its tapping term
+    bool tapCandidateRepeated = false;  //autorepeat came in (ends the tap when there is no tapping term)
+    bool tapCandidateExpired = false;  //held longer than the tapping term
+    std::chrono::steady_clock::time_point tapCandidateDeadline = std::chrono::steady_clock::time_point::max();
+    int lastTap = -1;  //scancode of the key tapped last; pressing it again within the term is tap-and-hold
+    std::chrono::steady_clock::time_point lastTapDeadline = std::chrono::steady_clock::time_point::max();
+
+    bool isKeyDown(int scancode) const { return tapState[scancode] >= TAPSTATE_PRESSED; }  //a down stroke of such a key is autorepeat
+
+    std::bitset<256> usedKeyDown;  //keys that went into a chord or compose result; their autorepeat and release are swallowed
+
+    //momentary layers, see selectLayer(). The configs are the compiled ones, they live until reset()
+    struct Layer
+    {
+        unsigned char key;  //the LAYER key that holds it
+        const Config *config;
+    };
+    Layer layers[MAX_LAYERS] = { };  //[layerCount - 1] is on top
+    int layerCount = 0;
+    const Config *keyConfig[256] = { };  //the config a key that is down was pressed in; its autorepeat and release go there too
+};
+
+//what the pipeline remembers of one keyboard between its strokes.
+//The keyboard that is typing has its state in interceptionState / modifierState; the others wait here, see switchDeviceState().
+struct DeviceState
+{
+    InterceptionKeyStroke currentIKstroke = { SC_NOP, 0 };
+    InterceptionKeyStroke previousIKstroke1 = { SC_NOP, 0 };
+    InterceptionKeyStroke previousIKstroke2 = { SC_NOP, 0 };
+    ModifierState modifierState;
+
+    //descriptor, see describeDevice(). Resolved when the keyboard sends its first key, and again after reset() (config switch, reload)
+    bool described = false;
+    std::string hardwareId;  //lowercase
+    bool isAppleKeyboard = false;
+    int configNumber = -1;  //GLOBAL DeviceConfig. -1: the active config
+    std::shared_ptr<const Config> config;  //null: the active config
+    int ignoredBy = 0;  //DEBUG_IGNORE_NOT_INCLUDED / DEBUG_IGNORE_EXCLUDED if include/excludeDeviceId of its config skip this keyboard
+};
+
+struct LoopState
+{
+    unsigned char scancode = SC_NOP; //hardware code sent by Interception
+    int vcode = -1; //key code used internally; equals scancode or a Virtual code > FF
+    bool isDownstroke = false;
+    bool isModifier = false;
+    bool tapped = false;
+    bool tappedSlow = false;  //autorepeat set in before key release
+    bool tapHoldMake = false;  //tap-and-hold action (like LAlt > mod12 // LAlt)
+    int tapHoldDecision = 0;  //TAPHOLD_DECIDED_ when the lookahead decided this key, see holdBackStroke()
+    int combo = -1;  //index of the matched combo in modCombos
+    std::chrono::steady_clock::time_point strokeTime;  //hardware time of the stroke, or when it was received
+
+    KeySequence resultingKeySequence;
+};
+
+//a stroke that waits for a held back key to be decided, with what the pipeline knew of it when it came in
+struct HeldStroke
+{
+    InterceptionDevice device;
+    InterceptionKeyStroke stroke;
+    LoopState loop;
+    const Config *config;
+    int flightConfig;
+    std::chrono::steady_clock::time_point receivedAt;
+    std::chrono::steady_clock::time_point decodedAt;
+};
+
+//the key with IfTapped that is held back (TAPHOLD_DEFERRED and up), and the strokes behind it.
+//strokes[0] is its press. Only one key is held back at a time; the keys behind it wait in order.
+struct Lookahead
+{
+    int key = -1;  //scancode, -1: nothing held back
+    InterceptionDevice device = 0;
+    int mode = TAPHOLD_SPECULATIVE;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();  //end of the tapping term: hold
+    int count = 0;
+    HeldStroke strokes[TAPHOLD_LOOKAHEAD_SIZE];
+};
+
+//the first keys of a CHORD, held back until the chord completes or cannot complete anymore. See detectChord()
+struct ChordState
+{
+    InterceptionDevice device = 0;
+    int count = 0;  //keys held back
+    unsigned long long candidates = 0;  //chords that have all of them
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();  //first key + chord term
+    HeldStroke strokes[MAX_CHORD_KEYS];
+};
+
+//the keys of a COMPOSE sequence typed so far, held back while they walk down the trie. See detectCompose()
+struct ComposeState
+{
+    InterceptionDevice device = 0;
+    const Config *config = nullptr;  //the trie is the one of the config the first key was pressed in
+    int node = 0;  //0: no sequence started
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();  //last key + compose term
+    std::bitset<256> keyDown;  //pressed within the sequence and not released yet
+    int count = 0;
+    HeldStroke strokes[MAX_COMPOSE_KEYS * 2];  //presses, and the releases of the keys pressed within the sequence
+};
+
+//the per key timing is in LatencyStats
+struct ProfilingTimer
+{
+    std::chrono::steady_clock::time_point timepointPreviousKeyEvent;
+    std::chrono::steady_clock::time_point timepointLoopStart = std::chrono::steady_clock::now();
+
+    unsigned long lastConfigSwitchUS = 0;
+    unsigned long worstConfigSwitchUS = 0;
+    unsigned long iniLoadTimeUS = 0;  //read ini until the startup config is active
+};
+
+class Engine
+{
+public:
+    Engine(EngineOutput &output, EngineClock &clock, EngineHost &host);
+    ~Engine();
+
+    Globals globals;
+    Options options;
+    std::shared_ptr<const Config> currentConfig;  //the maps of the active config. Never null.
+    InterceptionState interceptionState;
+    GlobalState globalState;
+    ModifierState modifierState;
+    LoopState loopState;
+    ProfilingTimer profiler;
+    LatencyStats latency;  //histograms per pipeline stage and outcome, see latencyStats.h
+    FlightRecorder flightRecorder;  //the last strokes through the pipeline. Engine thread only.
+    InputCapture capture;  //raw input to a file when active (ESC+G). Engine thread only.
+
+    std::string iniFileName = "capsicain.ini";
+    IniContent sanitizedIniContent;  //loaded on startup and reset
+    std::string errorLog = "";
+    bool interpretConfig = false;  //bypass the compiled config and search the maps step by step (for equivalence checks)
+    bool useConfigCache = true;  //take the compiled configs from <ini>.cache if the ini did not change, see configCache.h
+    bool configsFromCache = false;  //the configs of the current ini were read from the cache
+
+    //read the ini, parse GLOBALs, activate the startup config. Returns false if there is no ini.
+    bool loadIni();
+    unsigned long long getIniHash() const { return iniHash; }
+    //feed all strokes from input into processStroke() until input closes or exit is requested
+    void run(EngineInput &input);
+    //the key pipeline for one incoming stroke. Returns false if exit was requested.
+    //The resulting strokes are queued; they reach EngineOutput on the output scheduler thread.
+    //strokeTime is when the hardware saw the key, if the input knows it; otherwise the clock is read.
+    bool processStroke(InterceptionDevice device, InterceptionKeyStroke stroke,
+        std::chrono::steady_clock::time_point strokeTime = std::chrono::steady_clock::time_point());
+    //earliest pending timer (tapping terms, held back keys, chords, compose), time_point::max() if there is none
+    std::chrono::steady_clock::time_point getTimerDeadline() const;
+    //resolve all timers due at time. processStroke() does this itself before each stroke.
+    void processTimers(std::chrono::steady_clock::time_point time);
+    //blocks until all queued output is sent
+    void flushOutput();
+    //input ended: the keys still held back (chord, compose, tap-hold lookahead) are resolved as if
+    //no other key came before their terms ran out. Then flushOutput(). run() calls it at the end.
+    void finishInput();
+    //the keyboard is gone: release the keys it holds down and forget its state, so a keyboard that gets
+    //the same device number later starts clean. run() calls it for INPUT_DEVICE_REMOVED.
+    void deviceRemoved(InterceptionDevice device);
+
+    void error(std::string txt);
+    void reset();
+    void reload();
+    void releaseAllSentKeys();
+    void resetCapsNumScrollLock();
+    std::vector<IniLine> assembleConfig(int config);
+    std::shared_ptr<const Config> getCompiledConfig(int configNumber);
+    //blocks until all configs are compiled and the config cache is written
+    void waitForCompileWorker();
+    void switchConfig(int config, bool forceReloadSameConfig);
+    //query the hardware id of the current keyboard again, and everything that depends on it
+    void getHardwareId();
+    void playKeySequence(const KeySequence &sequence);
+    void sendVKeyEvent(VKeyEvent keyEvent);
+    void printOptions();
+    void printStatus();
+    //the [ESC] + key commands that are the same on every platform. False if scancode is not one of them.
+    bool processCommonCommand(int scancode);
+
+private:
+    EngineOutput &output;
+    EngineClock &clock;
+    EngineHost &host;
+    DebugLog debugLog;  //IFDEBUG output of the key pipeline, printed on the logger thread
+    OutputScheduler scheduler;
+
+    std::shared_ptr<const Config> compiledConfigs[MAX_CONFIGS];  //only use with std::atomic_load / atomic_store
+    std::thread compileWorker;
+    std::atomic<bool> compileWorkerStop{ false };
+    unsigned long long iniHash = 0;
+    bool writeConfigCacheWhenCompiled = false;
+
+    DeviceState deviceStates[INTERCEPTION_MAX_DEVICE + 1];  //by InterceptionDevice. [loadedDevice] is stale, its state is in the working copies
+    InterceptionDevice loadedDevice = 0;
+    const Config *strokeConfig = nullptr;  //config of the stroke being processed: the active one, or the one of GLOBAL DeviceConfig
+    Lookahead lookahead;
+    ChordState chordState;
+    ComposeState composeState;
+
+    //what the stroke coming in has set up, while held back strokes run through the pipeline before it
+    struct LiveContext
+    {
+        InterceptionDevice device;
+        InterceptionDevice interceptionDevice;
+        const Config *config;
+        LoopState loop;
+        unsigned int resetCount;
+    };
+    unsigned int resetCount = 0;  //reset() may free the config of the live stroke (config switch in a replayed sequence)
+    LiveContext saveLiveContext();
+    void restoreLiveContext(const LiveContext &live);
+
+    void InterceptionSendCurrentKeystroke();
+    void switchDeviceState(InterceptionDevice device);
+    void describeDevice(DeviceState &deviceState);
+    bool processOnOffKey();
+    bool processMessyKeys();
+    bool selectLayer(FlightRecord &flight);
+    bool detectChord(FlightRecord &flight, std::chrono::steady_clock::time_point receivedAt);
+    void finishChord();
+    void fireChord(FlightRecord &flight);
+    bool detectCompose(FlightRecord &flight, std::chrono::steady_clock::time_point receivedAt);
+    void finishCompose();
+    void fireCompose(FlightRecord &flight);
+    void sendInPlaceOfHeld(FlightRecord &flight, const HeldStroke *held, int count, const KeySequence &keySequence);
+    bool holdBackStroke(FlightRecord &flight, std::chrono::steady_clock::time_point receivedAt);
+    void resolveLookahead(int decision);
+    void replayHeldStrokes(const std::vector<HeldStroke> &held, int decision);
+    void replayHeldStroke(const HeldStroke &held, int decision);
+    FlightRecord &beginFlight(const HeldStroke &held);
+    int getTapHoldMode(int scancode);
+    void processDecodedStroke(FlightRecord &flight, std::chrono::steady_clock::time_point receivedAt);
+    void detectTapping();
+    int getTappingTermMS(int scancode);
+    void processModifierState();
+    void processRewireScancodeToVirtualcode();
+    void processCombos();
+    void processMapAlphaKeys();
+    void processCompiledMapping();
+    void sendResultingKeyOrSequence();
+    void sendCapsicainCodeHandler(VKeyEvent keyEvent);
+    void SendShiftDownUp();
+
+    bool readIni();
+    void parseIniGlobals();
+    void startCompileWorker();
+    void stopCompileWorker();
+    void applyConfigOptions(const Config &config);
+    bool activateConfig(int configNumber);
+    void printConfigMessages(const Config &config);
+
+    //config parsing touches no engine state; it also runs on the compile worker thread
+    static bool parseIniOptions(const std::vector<IniLine> &assembledIni, Config &config);
+    static void parseIniRewires(const std::vector<IniLine> &assembledIni, Config &config);
+    static bool parseIniCombos(const std::vector<IniLine> &assembledIni, Config &config);
+    static void parseIniChords(const std::vector<IniLine> &assembledIni, Config &config);
+    static void parseIniLayers(const std::vector<IniLine> &assembledIni, Config &config);
+    static void parseIniComposes(const std::vector<IniLine> &assembledIni, Config &config);
+    static bool parseIniAlphaLayout(const std::vector<IniLine> &assembledIni, Config &config);
+    static void indexCombos(AllMaps &allMaps);
+    static void initializeAllMaps(AllMaps &allMaps);
+    static std::vector<IniLine> assembleConfig(const IniContent &iniContent, int configNumber, Config &config);
+    static void includeSection(const IniContent &iniContent, std::string_view sectionName, std::vector<IniLine> &assembledIni, int depth, Config &config);
+    static std::shared_ptr<const Config> parseProcessIniConfig(const IniContent &iniContent, int configNumber);
+
+    LATENCY_OUTCOME getLatencyOutcome();
+    void recordFlightResult(FlightRecord &record);
+};
+
+std::string getPrettyVKLabelPadded(int vcode, int resultLength);
+std::string getPrettyVKLabel(int vcode);
+std::string getSymbolForIKStrokeState(unsigned short state);
+std::string getTimestamp();
+void printIKStrokeState(InterceptionKeyStroke iks);
+
+VKeyEvent convertIkstroke2VKeyEvent(InterceptionKeyStroke ikStroke);
+void normalizeIKStroke(InterceptionKeyStroke &ikstroke);
+InterceptionKeyStroke convertVkeyEvent2ikstroke(VKeyEvent keyEvent);
+
+int obfuscateVKey(int vk);
+int deObfuscateVKey(int vk);
@@ -0,0 +1,341 @@
+#include "pch.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+
+#include "evdevIO.h"
+#include "evdevKeys.h"
+#include "scancodes.h"
+
+using namespace std;
+
+#define EPOLL_INOTIFY 100  //epoll data of the non-keyboard fds; keyboards are their index
+#define EPOLL_STOP 101
+
+static bool testBit(const unsigned char *bits, int bit)
+{
+    return bits[bit / 8] & (1 << (bit % 8));
+}
+
+static void setBit(unsigned char *bits, int bit, bool on)
+{
+    if (on)
+        bits[bit / 8] |= 1 << (bit % 8);
+    else
+        bits[bit / 8] &= ~(1 << (bit % 8));
+}
+
+bool EvdevInput::open(bool grab)
+{
+    this->grab = grab;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (epollFd < 0 || stopFd < 0)
+        return false;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = EPOLL_STOP;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &event);
+    //new keyboards: the node is created first, its permissions are set a moment later
+    if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, EVDEV_INPUT_DIR, IN_CREATE | IN_ATTRIB) >= 0)
+    {
+        event.data.u64 = EPOLL_INOTIFY;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, inotifyFd, &event);
+    }
+
+    vector<string> paths;
+    DIR *dir = opendir(EVDEV_INPUT_DIR);
+    if (dir)
+    {
+        while (dirent *entry = readdir(dir))
+            if (strncmp(entry->d_name, "event", 5) == 0)
+                paths.push_back(string(EVDEV_INPUT_DIR) + "/" + entry->d_name);
+        closedir(dir);
+    }
+    sort(paths.begin(), paths.end());
+
+    bool found = false;
+    for (const string &path : paths)
+        found = openKeyboard(path) || found;
+    return found;
+}
+
+void EvdevInput::close()
+{
+    for (int i = 0; i < INTERCEPTION_MAX_KEYBOARD; i++)
+        closeKeyboard(i);
+    for (int *fd : { &epollFd, &inotifyFd, &stopFd })
+    {
+        if (*fd >= 0)
+            ::close(*fd);
+        *fd = -1;
+    }
+    pending.clear();
+}
+
+void EvdevInput::stop()
+{
+    unsigned long long one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0)
+        return;
+}
+
+//false if the device is not a keyboard, or cannot be opened / grabbed
+bool EvdevInput::openKeyboard(const string &path)
+{
+    int slot = -1;
+    for (int i = INTERCEPTION_MAX_KEYBOARD - 1; i >= 0; i--)
+    {
+        if (keyboards[i].fd >= 0 && keyboards[i].path == path)
+            return false;  //already open
+        if (keyboards[i].fd < 0)
+            slot = i;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    //a keyboard has letters, space and enter. Mice, power buttons, lid switches do not.
+    unsigned char keyBits[KEY_MAX / 8 + 1] = {};
+    char name[256] = {};
+    input_id id = {};
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) < 0
+        || !testBit(keyBits, KEY_A) || !testBit(keyBits, KEY_Z) || !testBit(keyBits, KEY_SPACE) || !testBit(keyBits, KEY_ENTER))
+    {
+        ::close(fd);
+        return false;
+    }
+    ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+    ioctl(fd, EVIOCGID, &id);
+    if (ignoreDeviceName != "" && ignoreDeviceName == name)
+    {
+        ::close(fd);
+        return false;
+    }
+    if (slot < 0)
+    {
+        cout << endl << "Too many keyboards, ignoring " << path << " (" << name << ")";
+        ::close(fd);
+        return false;
+    }
+
+    //timestamps on the steady_clock time line
+    int clockId = CLOCK_MONOTONIC;
+    bool monotonic = ioctl(fd, EVIOCSCLOCKID, &clockId) == 0;
+
+    if (grab)
+    {
+        //grabbing while a key is down (the Enter that started capsicain) would leave it stuck down for the system
+        for (int waited = 0; waited < EVDEV_GRAB_WAIT_MS; waited += 10)
+        {
+            unsigned char down[KEY_MAX / 8 + 1] = {};
+            ioctl(fd, EVIOCGKEY(sizeof(down)), down);
+            if (all_of(begin(down), end(down), [](unsigned char b) { return b == 0; }))
+                break;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        if (ioctl(fd, EVIOCGRAB, 1) < 0)
+        {
+            cout << endl << "Cannot grab " << path << " (" << name << "), is another program using it? Ignoring it.";
+            ::close(fd);
+            return false;
+        }
+        //the keys still queued from before the grab went to the system already
+        input_event events[64];
+        while (read(fd, events, sizeof(events)) > 0)
+            ;
+    }
+
+    char hardwareId[64];
+    snprintf(hardwareId, sizeof(hardwareId), "evdev\\vid_%04x&pid_%04x&bus_%04x\\", id.vendor, id.product, id.bustype);
+    Keyboard &keyboard = keyboards[slot];
+    keyboard.fd = fd;
+    keyboard.path = path;
+    keyboard.hardwareId = hardwareId + string(name);
+    keyboard.monotonic = monotonic;
+    //whatever an earlier keyboard in this slot left in the engine is not this one's
+    pending.push_back({ INTERCEPTION_KEYBOARD(slot), {}, {}, true });
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = slot;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+
+    cout << endl << "keyboard " << slot + 1 << ": " << path << " " << keyboard.hardwareId << (grab ? "" : " (not grabbed)");
+    return true;
+}
+
+void EvdevInput::closeKeyboard(int index)
+{
+    Keyboard &keyboard = keyboards[index];
+    if (keyboard.fd < 0)
+        return;
+    ::close(keyboard.fd);  //also ends the grab and removes it from the epoll set
+    keyboard = Keyboard();
+    //after its last strokes: the engine releases what it still holds down
+    pending.push_back({ INTERCEPTION_KEYBOARD(index), {}, {}, true });
+}
+
+void EvdevInput::readKeyboard(int index)
+{
+    input_event events[64];
+    while (true)
+    {
+        ssize_t n = read(keyboards[index].fd, events, sizeof(events));
+        if (n < 0 && errno == EAGAIN)
+            return;
+        if (n <= 0)
+        {
+            cout << endl << "keyboard " << index + 1 << " is gone: " << keyboards[index].path;
+            closeKeyboard(index);
+            return;
+        }
+
+        for (int i = 0; i < n / (int)sizeof(input_event); i++)
+        {
+            const input_event &ev = events[i];
+            chrono::steady_clock::time_point time;
+            if (keyboards[index].monotonic)
+                time = chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::seconds(ev.input_event_sec) + chrono::microseconds(ev.input_event_usec)));
+            if (ev.type == EV_SYN)
+            {
+                if (ev.code == SYN_DROPPED)
+                    keyboards[index].dropping = true;
+                else if (ev.code == SYN_REPORT && keyboards[index].dropping)
+                {
+                    keyboards[index].dropping = false;
+                    resyncKeyboard(index, time);
+                }
+                continue;
+            }
+            if (ev.type != EV_KEY || keyboards[index].dropping || ev.code > KEY_MAX)
+                continue;
+            queueKey(index, ev.code, ev.value, time);
+        }
+    }
+}
+
+//value 0 up, 1 down, 2 autorepeat
+void EvdevInput::queueKey(int index, unsigned short code, int value, chrono::steady_clock::time_point time)
+{
+    setBit(keyboards[index].keysDown, code, value != 0);
+    InterceptionDevice device = INTERCEPTION_KEYBOARD(index);
+    unsigned short up = value == 0 ? 1 : 0;  //1 down, 2 autorepeat: a make code, like the keyboard sends it
+    if (code == KEY_PAUSE)
+    {
+        if (value == 2)
+            return;
+        //what the Interception driver delivers: E1 LCTRL, NUMLOCK
+        pending.push_back({ device, { SC_LCTRL, (unsigned short)(4 | up), 0 }, time });
+        pending.push_back({ device, { SC_NUMLOCK, up, 0 }, time });
+        return;
+    }
+    int vcode = evdevToVcode(code);
+    if (vcode == 0)
+        return;
+    unsigned short state = (vcode >= 0x80 ? 2 : 0) | up;
+    pending.push_back({ device, { (unsigned short)(vcode & 0x7F), state, 0 }, time });
+}
+
+//events were lost: release the keys that went up in between. Keys that went down are left alone; a late make
+//code would be worse than a missed one.
+void EvdevInput::resyncKeyboard(int index, chrono::steady_clock::time_point time)
+{
+    Keyboard &keyboard = keyboards[index];
+    unsigned char down[KEY_MAX / 8 + 1] = {};
+    if (ioctl(keyboard.fd, EVIOCGKEY(sizeof(down)), down) < 0)
+        return;
+    for (int code = 0; code <= KEY_MAX; code++)
+    {
+        if (testBit(keyboard.keysDown, code) && !testBit(down, code))
+            queueKey(index, (unsigned short)code, 0, time);
+    }
+}
+
+void EvdevInput::readInotify()
+{
+    alignas(inotify_event) char buffer[4096];
+    ssize_t n;
+    while ((n = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + n; p += sizeof(inotify_event) + ((inotify_event *)p)->len)
+        {
+            const inotify_event *event = (inotify_event *)p;
+            if (event->len > 0 && strncmp(event->name, "event", 5) == 0)
+                openKeyboard(string(EVDEV_INPUT_DIR) + "/" + event->name);
+        }
+    }
+}
+
+//strokes only; removed keyboards are skipped
+bool EvdevInput::receive(InterceptionDevice &device, InterceptionKeyStroke &stroke)
+{
+    INPUT_RESULT result;
+    do
+        result = receiveUntil(device, stroke, chrono::steady_clock::time_point::max());
+    while (result == INPUT_DEVICE_REMOVED);
+    return result == INPUT_STROKE;
+}
+
+//wait for the next key from any keyboard
+INPUT_RESULT EvdevInput::receiveUntil(InterceptionDevice &device, InterceptionKeyStroke &stroke, chrono::steady_clock::time_point deadline)
+{
+    while (pending.empty())
+    {
+        int timeoutMS = -1;
+        if (deadline != chrono::steady_clock::time_point::max())
+        {
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (deadline <= now)
+                return INPUT_TIMEOUT;
+            timeoutMS = (int)min<long long>(chrono::ceil<chrono::milliseconds>(deadline - now).count(), INT_MAX);
+        }
+        epoll_event events[INTERCEPTION_MAX_KEYBOARD + 2];
+        int n = epoll_wait(epollFd, events, INTERCEPTION_MAX_KEYBOARD + 2, timeoutMS);
+        if (n < 0 && errno != EINTR)
+            return INPUT_CLOSED;
+        for (int i = 0; i < n; i++)
+        {
+            unsigned long long source = events[i].data.u64;
+            if (source == EPOLL_STOP)
+                return INPUT_CLOSED;
+            else if (source == EPOLL_INOTIFY)
+                readInotify();
+            else if (source < INTERCEPTION_MAX_KEYBOARD && keyboards[source].fd >= 0)
+                readKeyboard((int)source);
+        }
+    }
+    device = pending.front().device;
+    stroke = pending.front().stroke;
+    strokeTime = pending.front().time;
+    bool removed = pending.front().removed;
+    pending.pop_front();
+    return removed ? INPUT_DEVICE_REMOVED : INPUT_STROKE;
+}
+
+string EvdevInput::getHardwareId(InterceptionDevice device)
+{
+    int index = device - 1;
+    if (index < 0 || index >= INTERCEPTION_MAX_KEYBOARD || keyboards[index].fd < 0)
+        return "UNKNOWN_ID";
+    return keyboards[index].hardwareId;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// EngineInput on Linux: all keyboards in /dev/input/event*, read through one epoll loop.
+// The keyboards are grabbed (EVIOCGRAB), so their keys reach the system only through capsicain.
+// The key events carry the kernel timestamp (CLOCK_MONOTONIC), which the engine uses for the tapping terms.
+// Key codes are translated to set 1 scan code strokes, exactly like the Interception driver delivers them,
+// so all configs work unchanged. Keyboards plugged in later are picked up (inotify on /dev/input).
+// An unplugged keyboard, and a new one in its device slot, is reported as INPUT_DEVICE_REMOVED in the stroke order.
+// If the kernel queue overflows (SYN_DROPPED), the keys that came up in the lost events are released.
+// Needs read access to /dev/input/event* (root, or the 'input' group).
+
+#include <string>
+#include <deque>
+#include <linux/input.h>
+
+#include "engine.h"
+
+#define EVDEV_INPUT_DIR "/dev/input"
+#define EVDEV_GRAB_WAIT_MS 1000  //at most this long for all keys to be released before grabbing
+
+class EvdevInput : public EngineInput
+{
+public:
+    ~EvdevInput() { close(); }
+
+    //opens all keyboards. false if there is none
+    bool open(bool grab);
+    void close();
+    //makes receive() return false; safe to call from a signal handler
+    void stop();
+
+    bool receive(InterceptionDevice &device, InterceptionKeyStroke &stroke) override;
+    INPUT_RESULT receiveUntil(InterceptionDevice &device, InterceptionKeyStroke &stroke, std::chrono::steady_clock::time_point deadline) override;
+    //the kernel timestamp of the key event
+    std::chrono::steady_clock::time_point lastStrokeTime() override { return strokeTime; }
+
+    //"evdev\vid_xxxx&pid_xxxx&bus_xxxx\<name>", like the Windows hardware ids, so includeDeviceId / Apple detection work
+    std::string getHardwareId(InterceptionDevice device);
+    //name of our own output device; never opened as a keyboard
+    std::string ignoreDeviceName;
+
+private:
+    struct Keyboard
+    {
+        int fd = -1;
+        std::string path;
+        std::string hardwareId;
+        bool monotonic = false;  //event times are CLOCK_MONOTONIC (= steady_clock)
+        bool dropping = false;  //the kernel queue overflowed: skip to the next complete report, then resync
+        unsigned char keysDown[KEY_MAX / 8 + 1] = {};  //by evdev key code, as far as the events told us
+    };
+    struct PendingStroke
+    {
+        InterceptionDevice device;
+        InterceptionKeyStroke stroke;
+        std::chrono::steady_clock::time_point time;
+        bool removed = false;  //not a stroke: INPUT_DEVICE_REMOVED
+    };
+    Keyboard keyboards[INTERCEPTION_MAX_KEYBOARD];  //keyboards[i] is InterceptionDevice i + 1
+    int epollFd = -1;
+    int inotifyFd = -1;
+    int stopFd = -1;
+    bool grab = false;
+    std::deque<PendingStroke> pending;
+    std::chrono::steady_clock::time_point strokeTime;
+
+    bool openKeyboard(const std::string &path);
+    void closeKeyboard(int index);
+    void readKeyboard(int index);
+    void queueKey(int index, unsigned short code, int value, std::chrono::steady_clock::time_point time);
+    void resyncKeyboard(int index, std::chrono::steady_clock::time_point time);
+    void readInotify();
+};
@@ -0,0 +1,101 @@
+#include "pch.h"
+#include <linux/input-event-codes.h>
+
+#include "evdevKeys.h"
+#include "scancodes.h"
+
+//everything that is not 1:1 (like the Linux keyboard driver atkbd maps set 1)
+static const int EVDEV_VCODE_PAIRS[][2] =
+{
+    { KEY_ZENKAKUHANKAKU, 0x76 },
+    { KEY_RO, SC_ABNT_C1 },
+    { KEY_KATAKANA, 0x78 },
+    { KEY_HIRAGANA, 0x77 },
+    { KEY_HENKAN, SC_CONVERT },
+    { KEY_KATAKANAHIRAGANA, SC_KANA },
+    { KEY_MUHENKAN, SC_NOCONVERT },
+    { KEY_KPJPCOMMA, 0x5C },
+    { KEY_KPEQUAL, SC_NPEQUALS1 },
+    { KEY_KPCOMMA, SC_ABNT_C2 },
+    { KEY_HANGEUL, SC_LANG1 },
+    { KEY_HANJA, SC_LANG2 },
+    { KEY_YEN, SC_YEN },
+    { KEY_F13, SC_F13 }, { KEY_F14, SC_F14 }, { KEY_F15, SC_F15 }, { KEY_F16, SC_F16 }, { KEY_F17, SC_F17 }, { KEY_F18, SC_F18 },
+    { KEY_F19, SC_F19 }, { KEY_F20, SC_F20 }, { KEY_F21, SC_F21 }, { KEY_F22, SC_F22 }, { KEY_F23, SC_F23 },
+    //E0 keys
+    { KEY_KPENTER, SC_NPRET },
+    { KEY_RIGHTCTRL, SC_RCTRL },
+    { KEY_KPSLASH, SC_DIVIDE },
+    { KEY_SYSRQ, SC_PRINT },
+    { KEY_RIGHTALT, SC_RALT },
+    { KEY_HOME, SC_HOME },
+    { KEY_UP, SC_UP },
+    { KEY_PAGEUP, SC_PGUP },
+    { KEY_LEFT, SC_LEFT },
+    { KEY_RIGHT, SC_RIGHT },
+    { KEY_END, SC_END },
+    { KEY_DOWN, SC_DOWN },
+    { KEY_PAGEDOWN, SC_PGDOWN },
+    { KEY_INSERT, SC_INSERT },
+    { KEY_DELETE, SC_DELETE },
+    { KEY_LEFTMETA, SC_LWIN },
+    { KEY_RIGHTMETA, SC_RWIN },
+    { KEY_COMPOSE, SC_APPS },
+    { KEY_POWER, SC_POWER },
+    { KEY_SLEEP, SC_SLEEP },
+    { KEY_WAKEUP, SC_WAKE },
+    { KEY_MUTE, SC_MUTE },
+    { KEY_VOLUMEDOWN, SC_VOLUMEDOWN },
+    { KEY_VOLUMEUP, SC_VOLUMEUP },
+    { KEY_CALC, SC_CALCULATOR },
+    { KEY_PLAYPAUSE, SC_PLAYPAUSE },
+    { KEY_STOPCD, SC_MEDIASTOP },
+    { KEY_PREVIOUSSONG, SC_PREVTRACK },
+    { KEY_NEXTSONG, SC_NEXTTRACK },
+    { KEY_HOMEPAGE, SC_WEBHOME },
+    { KEY_SEARCH, SC_WEBSEARCH },
+    { KEY_BOOKMARKS, SC_WEBFAVORITES },
+    { KEY_REFRESH, SC_WEBREFRESH },
+    { KEY_STOP, SC_WEBSTOP },
+    { KEY_FORWARD, SC_WEBFORWARD },
+    { KEY_BACK, SC_WEBBACK },
+    { KEY_COMPUTER, SC_MYCOMPUTER },
+    { KEY_MAIL, SC_MAIL },
+    { KEY_MEDIA, SC_MEDIASELECT },
+};
+
+struct EvdevTables
+{
+    unsigned short vcodeByEvdev[EVDEV_KEY_CODES];
+    unsigned short evdevByVcode[MAX_VCODES];
+};
+
+constexpr EvdevTables makeEvdevTables()
+{
+    EvdevTables tables = {};
+    for (int code = KEY_ESC; code <= KEY_F12; code++)
+    {
+        if (code == 84 || code == KEY_ZENKAKUHANKAKU)  //84: no key; 85: not at its set 1 code
+            continue;
+        tables.vcodeByEvdev[code] = code;
+        tables.evdevByVcode[code] = code;
+    }
+    for (const auto &pair : EVDEV_VCODE_PAIRS)
+    {
+        tables.vcodeByEvdev[pair[0]] = pair[1];
+        tables.evdevByVcode[pair[1]] = pair[0];
+    }
+    return tables;
+}
+
+static constexpr EvdevTables EVDEV_TABLES = makeEvdevTables();
+
+int evdevToVcode(int evdevCode)
+{
+    return (unsigned int)evdevCode < EVDEV_KEY_CODES ? EVDEV_TABLES.vcodeByEvdev[evdevCode] : 0;
+}
+
+int vcodeToEvdev(int vcode)
+{
+    return (unsigned int)vcode < MAX_VCODES ? EVDEV_TABLES.evdevByVcode[vcode] : 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Linux input event key codes (linux/input-event-codes.h) <-> capsicain vcodes (PS2 scan code set 1, +0x80 for E0 keys).
+// Codes 1..88 are the set 1 scan codes already; the rest is a table.
+// Pause has no vcode of its own: the keyboard sends E1 LCTRL NUMLOCK, see EvdevInput.
+
+#define EVDEV_KEY_CODES 256  //all keyboard keys are below this; mouse buttons start at 0x110
+
+//0 if the key has no scan code
+int evdevToVcode(int evdevCode);
+//0 if the vcode is not a physical key
+int vcodeToEvdev(int vcode);
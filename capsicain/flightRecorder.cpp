@@ -0,0 +1,222 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "flightRecorder.h"
+#include "latencyStats.h"
+#include "scancodes.h"
+#include "utils.h"
+
+using namespace std;
+
+const char *FlightRecorder::getStageName(FLIGHT_STAGE stage)
+{
+    switch (stage)
+    {
+    case FLIGHT_RECEIVED: return "receive";
+    case FLIGHT_DECODED: return "decode";
+    case FLIGHT_REWIRED: return "rewire";
+    case FLIGHT_MODIFIERS: return "modifiers";
+    case FLIGHT_MAPPED: return "map";
+    case FLIGHT_QUEUED: return "queue";
+    default: return "?";
+    }
+}
+
+const char *FlightRecorder::getExitName(FLIGHT_EXIT exit)
+{
+    switch (exit)
+    {
+    case FLIGHT_EXIT_STOPPED: return "stopped";
+    case FLIGHT_EXIT_FORWARDED: return "forwarded";
+    case FLIGHT_EXIT_COMMAND: return "command";
+    case FLIGHT_EXIT_MAPPED: return "mapped";
+    case FLIGHT_EXIT_HELD: return "held";
+    default: return "?";
+    }
+}
+
+FlightRecord &FlightRecorder::begin(InterceptionDevice device, const InterceptionKeyStroke &stroke, chrono::steady_clock::time_point receivedAt, bool secret)
+{
+    FlightRecord &slot = ring[next & (FLIGHT_RECORDER_SIZE - 1)];
+    next++;
+    slot = {};
+    slot.at[FLIGHT_RECEIVED] = receivedAt;
+    slot.device = device;
+    slot.secret = secret;
+    currentRecord = &slot;
+    if (secret)
+    {
+        scratch = slot;
+        currentRecord = &scratch;
+    }
+
+    FlightRecord &record = *currentRecord;
+    record.stroke = stroke;
+    record.scancode = -1;
+    record.vcodeRewired = -1;
+    record.vcodeMapped = -1;
+    record.firstKeyOut = -1;
+    record.combo = -1;
+    return record;
+}
+
+unsigned long long FlightRecorder::firstIndex(int maxRecords) const
+{
+    unsigned long long n = next < FLIGHT_RECORDER_SIZE ? next : FLIGHT_RECORDER_SIZE;
+    if (maxRecords >= 0 && (unsigned long long)maxRecords < n)
+        n = maxRecords;
+    return next - n;
+}
+
+static string vcodeLabel(int vcode, bool withKeys)
+{
+    if (vcode < 0 || vcode >= MAX_VCODES)
+        return "-";
+    if (!withKeys)
+        return "*";
+    if (PRETTY_VK_LABELS[vcode].empty())
+        return stringIntToHex(vcode, 2);
+    return string(PRETTY_VK_LABELS[vcode]);
+}
+
+static bool reached(const FlightRecord &record, int stage)
+{
+    return record.at[stage] != chrono::steady_clock::time_point();
+}
+
+//last stage the stroke reached
+static int lastStage(const FlightRecord &record)
+{
+    int stage = FLIGHT_RECEIVED;
+    for (int i = FLIGHT_RECEIVED + 1; i < NUM_FLIGHT_STAGES; i++)
+        if (reached(record, i))
+            stage = i;
+    return stage;
+}
+
+static double microseconds(chrono::steady_clock::duration d)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(d).count() / 1000.0;
+}
+
+void FlightRecorder::print(ostream &out, int maxRecords, bool withKeys) const
+{
+    unsigned long long first = firstIndex(maxRecords);
+    out << "FLIGHT RECORDER: " << dec << next - first << " of " << next << " strokes"
+        << " (vcode after rewire > after mapping, modifiers down / tapped, stage times in us after receive)" << endl;
+    if (!withKeys)
+        out << "keys left out (*), debug mode includes them" << endl;
+    for (unsigned long long i = first; i < next; i++)
+    {
+        const FlightRecord &r = ring[i & (FLIGHT_RECORDER_SIZE - 1)];
+        if (r.secret)
+        {
+            out << "#" << dec << i << " dev " << r.device << " (secret macro recording)" << endl;
+            continue;
+        }
+        out << "#" << dec << i
+            << " cfg " << r.config << " dev " << r.device
+            << " [" << (withKeys ? stringIntToHex(r.stroke.code, 2) : "**") << " " << r.stroke.state << "] "
+            << setw(8) << vcodeLabel(r.scancode, withKeys) << ((r.stroke.state & 1) ? "^" : "v")
+            << " > " << setw(8) << vcodeLabel(r.vcodeRewired, withKeys) << " > " << setw(8) << vcodeLabel(r.vcodeMapped, withKeys)
+            << "  M:" << setw(4) << stringIntToHex(r.modifierDown, 0) << " T:" << setw(4) << stringIntToHex(r.modifierTapped, 0)
+            << " D:" << setw(6) << (r.activeDeadkey ? vcodeLabel(r.activeDeadkey, withKeys) : "")
+            << "  out: " << setw(8) << vcodeLabel(r.firstKeyOut, withKeys);
+        if (r.sequenceSize > 0)
+            out << " (" << r.sequenceSize << " ops)";
+        if (r.combo >= 0 && withKeys)
+            out << " combo #" << r.combo;
+        out << "  " << getExitName((FLIGHT_EXIT)r.exit);
+        if (r.exit == FLIGHT_EXIT_MAPPED)
+            out << " " << getLatencyOutcomeName((LATENCY_OUTCOME)r.outcome);
+        out << " |";
+        for (int stage = FLIGHT_RECEIVED + 1; stage < NUM_FLIGHT_STAGES; stage++)
+        {
+            if (reached(r, stage))
+                out << " " << getStageName((FLIGHT_STAGE)stage) << " " << fixed << setprecision(1) << microseconds(r.at[stage] - r.at[FLIGHT_RECEIVED]) << defaultfloat;
+        }
+        out << endl;
+    }
+}
+
+static string jsonString(const string &s)
+{
+    string result = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if ((unsigned char)c >= 0x20)
+            result += c;
+    }
+    return result + "\"";
+}
+
+bool FlightRecorder::writeTrace(const string &fileName, bool withKeys) const
+{
+    ofstream f(fileName, ios::trunc);
+    if (!f)
+        return false;
+
+    unsigned long long first = firstIndex(-1);
+    chrono::steady_clock::time_point origin = ring[first & (FLIGHT_RECORDER_SIZE - 1)].at[FLIGHT_RECEIVED];
+    bool deviceNamed[INTERCEPTION_MAX_DEVICE + 1] = {};
+    const char *separator = "";
+
+    f << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << fixed << setprecision(3);
+    for (unsigned long long i = first; i < next; i++)
+    {
+        const FlightRecord &r = ring[i & (FLIGHT_RECORDER_SIZE - 1)];
+        int tid = (r.device >= 0 && r.device <= INTERCEPTION_MAX_DEVICE) ? r.device : 0;
+        if (!deviceNamed[tid])
+        {
+            deviceNamed[tid] = true;
+            f << separator << endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"device " << tid << "\"}}";
+            separator = ",";
+        }
+
+        double start = microseconds(r.at[FLIGHT_RECEIVED] - origin);
+        if (r.secret)
+        {
+            f << separator << endl << "{\"name\":\"secret\",\"cat\":\"key\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << start << "}";
+            continue;
+        }
+        double duration = microseconds(r.at[lastStage(r)] - r.at[FLIGHT_RECEIVED]);
+        string name = (withKeys ? vcodeLabel(r.scancode >= 0 ? r.scancode : r.stroke.code, true) : "key") + ((r.stroke.state & 1) ? "^" : "v");
+        f << separator << endl << "{\"name\":" << jsonString(name) << ",\"cat\":\"key\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << start << ",\"dur\":" << duration
+            << ",\"args\":{\"index\":" << i
+            << ",\"stroke\":" << jsonString((withKeys ? stringIntToHex(r.stroke.code, 2) : "**") + " " + to_string(r.stroke.state))
+            << ",\"config\":" << r.config
+            << ",\"rewired\":" << jsonString(vcodeLabel(r.vcodeRewired, withKeys))
+            << ",\"mapped\":" << jsonString(vcodeLabel(r.vcodeMapped, withKeys))
+            << ",\"out\":" << jsonString(vcodeLabel(r.firstKeyOut, withKeys))
+            << ",\"sequenceOps\":" << r.sequenceSize
+            << ",\"modifierDown\":" << jsonString(stringIntToHex(r.modifierDown, 4))
+            << ",\"modifierTapped\":" << jsonString(stringIntToHex(r.modifierTapped, 4))
+            << ",\"deadkey\":" << jsonString(r.activeDeadkey ? vcodeLabel(r.activeDeadkey, withKeys) : "")
+            << ",\"combo\":" << (withKeys ? r.combo : -1)
+            << ",\"exit\":" << jsonString(getExitName((FLIGHT_EXIT)r.exit))
+            << ",\"outcome\":" << jsonString(r.exit == FLIGHT_EXIT_MAPPED ? getLatencyOutcomeName((LATENCY_OUTCOME)r.outcome) : "")
+            << "}}";
+        separator = ",";
+
+        //one nested slice per stage, from the previous stage reached
+        int previous = FLIGHT_RECEIVED;
+        for (int stage = FLIGHT_RECEIVED + 1; stage < NUM_FLIGHT_STAGES; stage++)
+        {
+            if (!reached(r, stage))
+                continue;
+            f << "," << endl << "{\"name\":\"" << getStageName((FLIGHT_STAGE)stage) << "\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << microseconds(r.at[previous] - origin) << ",\"dur\":" << microseconds(r.at[stage] - r.at[previous]) << "}";
+            previous = stage;
+        }
+    }
+    f << endl << "]}" << endl;
+    return (bool)f;
+}
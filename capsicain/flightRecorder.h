@@ -0,0 +1,83 @@
+#pragma once
+
+// Flight recorder: the last FLIGHT_RECORDER_SIZE incoming strokes, always on.
+// For each stroke: the raw stroke and device, the vcode after each pipeline stage, the modifier state,
+// the matched combo, and a timestamp per stage. Fixed size ring, written only by the engine thread:
+// recording a stroke is a handful of stores, no allocation, no lock.
+// Strokes typed while a secret macro is recorded only leave their time in the ring.
+// ESC+F dumps it as text and as a Chrome / Perfetto trace (chrome://tracing, ui.perfetto.dev).
+// Without withKeys the dumps leave out which keys were typed (raw code, vcodes, combo, deadkey): timing and modifiers only.
+
+#include <chrono>
+#include <string>
+#include <ostream>
+
+#include "interception.h"  //only for the InterceptionKeyStroke / InterceptionDevice types
+
+#define FLIGHT_RECORDER_SIZE 1024  //strokes; power of two
+
+enum FLIGHT_STAGE
+{
+    FLIGHT_RECEIVED = 0,
+    FLIGHT_DECODED,     //escape codes, messy keys, Apple flip done; scancode is final
+    FLIGHT_REWIRED,     //tapping and REWIRE done
+    FLIGHT_MODIFIERS,   //modifier state updated
+    FLIGHT_MAPPED,      //combo / alpha map done: the engine knows what to send
+    FLIGHT_QUEUED,      //resulting strokes are in the output queue
+    NUM_FLIGHT_STAGES
+};
+
+//how the stroke left the pipeline
+enum FLIGHT_EXIT
+{
+    FLIGHT_EXIT_STOPPED = 0,  //nothing sent after the last stage reached (rewired to NOP, on/off key, macro end, ...)
+    FLIGHT_EXIT_FORWARDED,    //sent unchanged (capsicain off, config 0, ignored device)
+    FLIGHT_EXIT_COMMAND,      //ESC command
+    FLIGHT_EXIT_MAPPED,       //went through the whole pipeline
+    FLIGHT_EXIT_HELD,         //held back until a tap-hold key is decided; goes through the pipeline later as a new record
+};
+
+struct FlightRecord
+{
+    std::chrono::steady_clock::time_point at[NUM_FLIGHT_STAGES];  //epoch: stage not reached
+    InterceptionKeyStroke stroke;
+    InterceptionDevice device;
+    int config;
+    int scancode;
+    int vcodeRewired;
+    int vcodeMapped;
+    int firstKeyOut;  //vcode of the first key pressed or released by the result, -1 if none
+    int combo;        //index of the matched combo in the config's modCombos, -1 if none
+    unsigned short modifierDown;
+    unsigned short modifierTapped;
+    unsigned char activeDeadkey;
+    unsigned char exit;     //FLIGHT_EXIT
+    unsigned char outcome;  //LATENCY_OUTCOME
+    unsigned short sequenceSize;
+    bool secret;
+};
+
+class FlightRecorder
+{
+public:
+    //clears the next slot and makes it the current record. A secret stroke gets a scratch record that is never shown.
+    FlightRecord &begin(InterceptionDevice device, const InterceptionKeyStroke &stroke, std::chrono::steady_clock::time_point receivedAt, bool secret);
+    FlightRecord &current() { return *currentRecord; }
+    unsigned long long count() const { return next; }
+
+    //the newest maxRecords strokes, oldest first, one line each
+    void print(std::ostream &out, int maxRecords, bool withKeys) const;
+    //Chrome trace event JSON: one track per device, a slice per stroke with a nested slice per stage
+    bool writeTrace(const std::string &fileName, bool withKeys) const;
+
+    static const char *getStageName(FLIGHT_STAGE stage);
+    static const char *getExitName(FLIGHT_EXIT exit);
+
+private:
+    FlightRecord ring[FLIGHT_RECORDER_SIZE] = {};
+    unsigned long long next = 0;
+    FlightRecord scratch = {};
+    FlightRecord *currentRecord = &scratch;
+
+    unsigned long long firstIndex(int maxRecords) const;
+};
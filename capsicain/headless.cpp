@@ -0,0 +1,157 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "engine.h"
+#include "headlessIO.h"
+
+using namespace std;
+
+// Headless driver for the engine, no keyboard driver needed.
+// Reads strokes from stdin, writes the strokes the engine sends out to stdout.
+// One stroke per line: <code hex> <state> [device]    e.g. "1e 0" = A down, "1e 1" = A up
+// Engine console output goes to stderr.
+//
+// usage: capsicain_headless [--compare] [--nocache] [--latency file] [--trace file] [--capture file] [path/to/capsicain.ini] < strokes.txt
+//
+// --compare  runs every stroke through the interpreted maps and through the compiled config side by side.
+//            Reports each stroke where the output differs, exit code 1 if there was any.
+//            ctest runs it on tests/compare.strokes.txt for the shipped inis.
+// --nocache  always parse the ini; do not read or write the compiled config cache (<ini>.cache)
+// --latency  write the latency histograms to file at the end (same format as ESC+P)
+// --trace    write the flight recorder (the last 1024 strokes) to file at the end as Chrome / Perfetto trace JSON (like ESC+F)
+// --capture  write the input to file as a binary capture (like ESC+G), for capsicain_replay
+
+bool useConfigCache = true;
+
+bool startEngine(Engine &engine, string iniFileName)
+{
+    engine.iniFileName = iniFileName;
+    engine.useConfigCache = useConfigCache;
+    if (!engine.loadIni())
+    {
+        cerr << endl << "Cannot read " << engine.iniFileName << endl;
+        return false;
+    }
+    engine.options.delayForKeySequenceMS = 0;  //no need to pace the output
+    return true;
+}
+
+int compareInterpretedAndCompiled(string iniFileName, ostream &results)
+{
+    ostringstream interpretedOut, compiledOut;
+    HeadlessIO interpretedIO(interpretedOut), compiledIO(compiledOut);
+    SteadyClock clock;
+    EngineHost host;
+    Engine interpreted(interpretedIO, clock, host);
+    Engine compiled(compiledIO, clock, host);
+    interpreted.interpretConfig = true;
+
+    if (!startEngine(interpreted, iniFileName) || !startEngine(compiled, iniFileName))
+        return 1;
+
+    int strokes = 0;
+    int mismatches = 0;
+    auto compareOutput = [&](const string &where)
+    {
+        if (interpretedOut.str() != compiledOut.str())
+        {
+            mismatches++;
+            cerr << "MISMATCH " << where << endl << "interpreted:" << endl << interpretedOut.str()
+                << "compiled:" << endl << compiledOut.str();
+        }
+        results << compiledOut.str();
+        interpretedOut.str("");
+        compiledOut.str("");
+    };
+    InterceptionDevice device;
+    InterceptionKeyStroke stroke;
+    while (compiledIO.receive(device, stroke))
+    {
+        strokes++;
+        bool goOn = interpreted.processStroke(device, stroke);
+        goOn = compiled.processStroke(device, stroke) && goOn;
+        interpreted.flushOutput();
+        compiled.flushOutput();
+
+        ostringstream where;
+        where << "at stroke " << strokes << " (" << hex << stroke.code << " " << dec << stroke.state << ")";
+        compareOutput(where.str());
+        if (!goOn)
+            break;
+    }
+    //the keys still held back at the end
+    interpreted.finishInput();
+    compiled.finishInput();
+    compareOutput("at the end of the input");
+    cerr << dec << strokes << " strokes, " << mismatches << " mismatches" << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    //results on stdout, engine chatter on stderr
+    ostream results(cout.rdbuf());
+    cout.rdbuf(cerr.rdbuf());
+
+    bool compare = false;
+    string iniFileName = "capsicain.ini";
+    string latencyFileName;
+    string traceFileName;
+    string captureFileName;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--compare")
+            compare = true;
+        else if (arg == "--latency" && i + 1 < argc)
+            latencyFileName = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            traceFileName = argv[++i];
+        else if (arg == "--capture" && i + 1 < argc)
+            captureFileName = argv[++i];
+        else if (arg == "--nocache")
+            useConfigCache = false;
+        else
+            iniFileName = arg;
+    }
+
+    if (compare)
+    {
+        //two engines talking at once is unreadable; keep only the report
+        cout.rdbuf(nullptr);
+        int ret = compareInterpretedAndCompiled(iniFileName, results);
+        results.flush();
+        return ret;
+    }
+
+    HeadlessIO io(results);
+    SteadyClock clock;
+    EngineHost host;
+    Engine engine(io, clock, host);
+
+    if (!startEngine(engine, iniFileName))
+        return 1;
+    if (captureFileName != "" && !engine.capture.start(captureFileName, engine.getIniHash(), clock.now()))
+    {
+        cerr << "Cannot write " << captureFileName << endl;
+        return 1;
+    }
+
+    engine.run(io);
+    engine.capture.stop();
+    results.flush();
+    if (latencyFileName != "" && !engine.latency.writeFile(latencyFileName))
+    {
+        cerr << "Cannot write " << latencyFileName << endl;
+        return 1;
+    }
+    if (traceFileName != "" && !engine.flightRecorder.writeTrace(traceFileName, true))
+    {
+        cerr << "Cannot write " << traceFileName << endl;
+        return 1;
+    }
+    return 0;
+}
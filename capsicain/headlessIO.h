@@ -0,0 +1,71 @@
+#pragma once
+
+// Text stroke IO for the headless tools. One stroke per line: <code hex> <state> [device]
+// e.g. "1e 0" = A down, "1e 1" = A up. Emulates the OS toggling the lock keys.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "engine.h"
+
+class HeadlessIO : public EngineInput, public EngineOutput
+{
+public:
+    explicit HeadlessIO(std::ostream &out) : out(out) {}
+
+    bool receive(InterceptionDevice &device, InterceptionKeyStroke &stroke) override
+    {
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            std::istringstream ss(line);
+            unsigned int code, state;
+            int dev = 1;
+            if (!(ss >> std::hex >> code >> std::dec >> state))
+                continue;  //empty or comment line
+            ss >> dev;
+            device = dev;
+            stroke = { (unsigned short)code, (unsigned short)state, 0 };
+            return true;
+        }
+        return false;
+    }
+
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            out << std::hex << std::setw(2) << std::setfill('0') << strokes[i].code << " " << std::dec << strokes[i].state << "\n";
+
+            //emulate the OS toggling its lock key state
+            if ((strokes[i].state & 1) == 0 && (strokes[i].state & 2) == 0)
+            {
+                switch (strokes[i].code)
+                {
+                case SC_CAPS: capsLock = !capsLock; break;
+                case SC_NUMLOCK: numLock = !numLock; break;
+                case SC_SCRLOCK: scrLock = !scrLock; break;
+                }
+            }
+        }
+    }
+
+    bool isLockKeyOn(int scancode) override
+    {
+        switch (scancode)
+        {
+        case SC_CAPS: return capsLock;
+        case SC_NUMLOCK: return numLock;
+        case SC_SCRLOCK: return scrLock;
+        }
+        return false;
+    }
+
+private:
+    std::ostream &out;
+    bool capsLock = false;
+    bool numLock = true;
+    bool scrLock = false;
+};
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include <cstring>
+#include <iterator>
+
+#include "inputCapture.h"
+
+using namespace std;
+
+static const char CAPTURE_MAGIC[8] = { 'C', 'P', 'S', 'C', 'A', 'P', 'T', 'R' };
+
+bool InputCapture::start(const string &fileName, unsigned long long iniHash, chrono::steady_clock::time_point now)
+{
+    stop();
+    file.open(fileName, ios::binary | ios::trunc);
+    if (!file)
+        return false;
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    header.version = CAPTURE_VERSION;
+    header.iniHash = iniHash;
+    file.write((const char *)&header, sizeof(header));
+
+    previous = now;
+    strokes = 0;
+    active = true;
+    return (bool)file;
+}
+
+void InputCapture::stop()
+{
+    if (!active)
+        return;
+    file.close();
+    active = false;
+}
+
+void InputCapture::write(InterceptionDevice device, const InterceptionKeyStroke &stroke, chrono::steady_clock::time_point at)
+{
+    long long deltaUS = chrono::duration_cast<chrono::microseconds>(at - previous).count();
+    unsigned long long delta = deltaUS > 0 ? deltaUS : 0;
+    previous = at;
+
+    unsigned char buffer[13];
+    int n = 0;
+    do
+    {
+        unsigned char b = delta & 0x7F;
+        delta >>= 7;
+        buffer[n++] = delta ? (b | 0x80) : b;
+    } while (delta);
+    buffer[n++] = (unsigned char)stroke.code;
+    buffer[n++] = (unsigned char)stroke.state;
+    buffer[n++] = (unsigned char)device;
+    file.write((const char *)buffer, n);
+
+    if (++strokes % CAPTURE_FLUSH_STROKES == 0)
+        file.flush();
+}
+
+bool readCapture(const string &fileName, CaptureHeader &header, vector<CapturedStroke> &strokes)
+{
+    ifstream file(fileName, ios::binary);
+    if (!file)
+        return false;
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || header.version != CAPTURE_VERSION)
+        return false;
+
+    strokes.clear();
+    long long timeUS = 0;
+    size_t pos = sizeof(header);
+    while (pos < data.size())
+    {
+        unsigned long long delta = 0;
+        int shift = 0;
+        while (pos < data.size() && shift < 64)
+        {
+            unsigned char b = data[pos++];
+            delta |= (unsigned long long)(b & 0x7F) << shift;
+            shift += 7;
+            if (!(b & 0x80))
+                break;
+        }
+        if (data.size() - pos < 3)
+            break;  //truncated
+        timeUS += delta;
+        CapturedStroke captured;
+        captured.timeUS = timeUS;
+        captured.stroke = { (unsigned char)data[pos], (unsigned char)data[pos + 1], 0 };
+        captured.device = (unsigned char)data[pos + 2];
+        pos += 3;
+        strokes.push_back(captured);
+    }
+    return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Capture of the raw input: every stroke the engine receives, with device and time, in a compact binary file.
+// capsicain_replay feeds a capture back through the engine with a virtual clock, so a field issue can be
+// reproduced offline, the output of two versions can be diffed, and real typing sessions serve as benchmark input.
+// File: CaptureHeader, then per stroke the microseconds since the previous stroke (LEB128 varint),
+// followed by code, state and device, one byte each. Typing is ~5 bytes per stroke.
+// The time of a stroke is its strokeTime: when the hardware saw it (the kernel timestamp on Linux), else when it was received.
+// Strokes typed while a secret macro is recorded are not captured.
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+
+#include "interception.h"  //only for the InterceptionKeyStroke / InterceptionDevice types
+
+#define CAPTURE_VERSION 2  //2: stroke times are strokeTime, not the receive time
+#define CAPTURE_FLUSH_STROKES 256  //write through to the file every n strokes, so a crash loses little
+
+struct CaptureHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int reserved;
+    unsigned long long iniHash;  //hash of the ini text that was active when the capture started
+};
+
+struct CapturedStroke
+{
+    long long timeUS;  //since the capture started
+    InterceptionDevice device;
+    InterceptionKeyStroke stroke;
+};
+
+class InputCapture
+{
+public:
+    ~InputCapture() { stop(); }
+
+    bool start(const std::string &fileName, unsigned long long iniHash, std::chrono::steady_clock::time_point now);
+    void stop();
+    bool isActive() const { return active; }
+    unsigned long long count() const { return strokes; }
+    void write(InterceptionDevice device, const InterceptionKeyStroke &stroke, std::chrono::steady_clock::time_point at);
+
+private:
+    std::ofstream file;
+    bool active = false;
+    std::chrono::steady_clock::time_point previous;
+    unsigned long long strokes = 0;
+};
+
+//false if the file is missing or not a capture. A truncated last stroke is ignored.
+bool readCapture(const std::string &fileName, CaptureHeader &header, std::vector<CapturedStroke> &strokes);
@@ -0,0 +1,79 @@
+#include "pch.h"
+#include <string>
+#include <windows.h>
+
+#include "interceptionIO.h"
+#include "scancodes.h"
+
+using namespace std;
+
+void InterceptionIO::open()
+{
+    interceptionContext = interception_create_context();
+    interception_set_filter(interceptionContext, interception_is_keyboard, INTERCEPTION_FILTER_KEY_ALL);
+}
+
+void InterceptionIO::close()
+{
+    interception_destroy_context(interceptionContext);
+    interceptionContext = NULL;
+}
+
+//wait for the next key from Interception
+bool InterceptionIO::receive(InterceptionDevice &device, InterceptionKeyStroke &stroke)
+{
+    device = interception_wait(interceptionContext);
+    return interception_receive(interceptionContext, device, (InterceptionStroke*)&stroke, 1) > 0;
+}
+
+INPUT_RESULT InterceptionIO::receiveUntil(InterceptionDevice &device, InterceptionKeyStroke &stroke, chrono::steady_clock::time_point deadline)
+{
+    if (deadline == chrono::steady_clock::time_point::max())
+        return receive(device, stroke) ? INPUT_STROKE : INPUT_CLOSED;
+
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    unsigned long timeoutMS = deadline <= now ? 0 : (unsigned long)chrono::ceil<chrono::milliseconds>(deadline - now).count();
+    device = interception_wait_with_timeout(interceptionContext, timeoutMS);
+    if (device == 0)
+        return INPUT_TIMEOUT;
+    return interception_receive(interceptionContext, device, (InterceptionStroke*)&stroke, 1) > 0 ? INPUT_STROKE : INPUT_CLOSED;
+}
+
+void InterceptionIO::send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count)
+{
+    interception_send(interceptionContext, device, (InterceptionStroke*)strokes, count);
+}
+
+bool InterceptionIO::isLockKeyOn(int scancode)
+{
+    switch (scancode)
+    {
+    case SC_CAPS: return GetKeyState(VK_CAPITAL) & 0x0001;
+    case SC_NUMLOCK: return GetKeyState(VK_NUMLOCK) & 0x0001;
+    case SC_SCRLOCK: return GetKeyState(VK_SCROLL) & 0x0001;
+    }
+    return false;
+}
+
+string InterceptionIO::getHardwareId(InterceptionDevice device)
+{
+    wchar_t  hardware_id[500] = { 0 };
+    string id;
+    size_t length = interception_get_hardware_id(interceptionContext, device, hardware_id, sizeof(hardware_id));
+    if (length > 0 && length < sizeof(hardware_id))
+    {
+        //forced conversion will replace special characters > 127 with "?"
+        for (wchar_t c : hardware_id)
+        {
+            if (c > 127)
+                id += '?';
+            else if (c == 0)
+                break;
+            else
+                id += (char)c;
+        }
+    }
+    else
+        id = "UNKNOWN_ID";
+    return id;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+#include "interception.h"
+#include "engine.h"
+
+//EngineInput + EngineOutput on top of the Interception driver
+class InterceptionIO : public EngineInput, public EngineOutput
+{
+public:
+    void open();
+    void close();
+
+    bool receive(InterceptionDevice &device, InterceptionKeyStroke &stroke) override;
+    INPUT_RESULT receiveUntil(InterceptionDevice &device, InterceptionKeyStroke &stroke, std::chrono::steady_clock::time_point deadline) override;
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override;
+    bool isLockKeyOn(int scancode) override;
+
+    std::string getHardwareId(InterceptionDevice device);
+
+private:
+    InterceptionContext interceptionContext = NULL;
+};
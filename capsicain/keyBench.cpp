@@ -0,0 +1,335 @@
+#include "pch.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "engine.h"
+#include "scancodes.h"
+
+using namespace std;
+
+// Key processing benchmark: time per incoming stroke in processStroke(), for typical input streams
+// against the shipped inis, and for synthetic configs with 100 / 1000 / 10000 COMBO rules.
+// Every stream is measured with the compiled config (as the engine runs) and with the interpreted maps
+// (processCombos + processMapAlphaKeys). For the synthetic configs also the load time without cache.
+// Nothing waits: the clock does not sleep, the output goes nowhere.
+//
+// usage: capsicain_key_bench [--runs N] [--strokes N] [path/to/capsicain.ini ...]
+//        default: capsicain.ini capsicain.kingcon.ini capsicain.example.ini
+//
+// --runs N     median of N runs (default 9)
+// --strokes N  strokes per run; the stream is repeated (default 100000)
+//
+// Output: CSV on stdout, diff it between versions.
+// bench,config,stream,mode,strokes,median,unit
+//   stroke: time per stroke of a stream in mode compiled / interpreted, ns
+//   load:   synthetic config without cache, stream startup (loadIni) / allConfigs (compile worker done), us
+
+class NullIO : public EngineOutput
+{
+public:
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override {}
+    bool isLockKeyOn(int scancode) override { return false; }
+};
+
+//real time, but sequence pauses and LED delays are not waited for
+class NoSleepClock : public SteadyClock
+{
+public:
+    void sleepMS(unsigned int ms) override {}
+    void sleepUntil(chrono::steady_clock::time_point time) override {}
+};
+
+struct Stream
+{
+    string name;
+    vector<InterceptionKeyStroke> strokes;
+
+    Stream(const string &name) : name(name) {}
+
+    void down(const string &label) { strokes.push_back(stroke(label, true)); }
+    void up(const string &label) { strokes.push_back(stroke(label, false)); }
+    void tap(const string &label) { down(label); up(label); }
+    void type(const vector<string> &labels) { for (const string &label : labels) tap(label); }
+
+    static InterceptionKeyStroke stroke(const string &label, bool isDownstroke)
+    {
+        VKeyEvent event;
+        event.vcode = getVcode(label);
+        event.isDownstroke = isDownstroke;
+        return convertVkeyEvent2ikstroke(event);
+    }
+};
+
+//all streams release every key they press, so they can be repeated
+vector<Stream> makeStreams()
+{
+    vector<Stream> streams;
+    const vector<string> letters = { "H", "E", "Q", "U", "I", "C", "K", "SPACE", "B", "R", "O", "W", "N", "SPACE",
+        "F", "O", "X", "SPACE", "J", "U", "M", "P", "S", "SPACE", "O", "V", "E", "R", "SPACE", "L", "A", "Z", "Y", "SPACE",
+        "D", "O", "G", "." };
+
+    Stream typing{ "typing" };
+    typing.down("LSHF");
+    typing.tap("T");
+    typing.up("LSHF");
+    typing.type(letters);
+    streams.push_back(typing);
+
+    Stream chords{ "chords" };  //ctrl, ctrl+shift, caps (kingcon: cursor keys), caps+shift (select)
+    chords.down("LCTRL");
+    chords.type({ "C", "V", "X", "Z", "A", "S" });
+    chords.down("LSHF");
+    chords.type({ "T", "N", "Z" });
+    chords.up("LSHF");
+    chords.up("LCTRL");
+    chords.down("CAPS");
+    chords.type({ "I", "J", "K", "L", "U", "O", "H", ";" });
+    chords.down("LSHF");
+    chords.type({ "J", "J", "L", "L", "U", "O" });
+    chords.up("LSHF");
+    chords.up("CAPS");
+    streams.push_back(chords);
+
+    Stream tapHold{ "taphold" };  //kingcon: TAB tapped / held (numpad), LALT tapped, LALT tap-and-hold (real alt)
+    tapHold.tap("TAB");
+    tapHold.tap("A");
+    tapHold.tap("LALT");
+    tapHold.tap("S");
+    tapHold.down("TAB");
+    tapHold.type({ "7", "8", "9", "U", "I", "O", "J", "K", "L", "M" });
+    tapHold.up("TAB");
+    tapHold.tap("LALT");
+    tapHold.down("LALT");
+    tapHold.tap("F");
+    tapHold.up("LALT");
+    streams.push_back(tapHold);
+
+    Stream deadkeys{ "deadkeys" };  //kingcon: tapped LALT, then the deadkey, then the letter
+    for (const char *deadkey : { "'", "Z", "Y" })
+    {
+        for (const char *letter : { "E", "A", "O" })
+        {
+            deadkeys.tap("LALT");
+            deadkeys.tap(deadkey);
+            deadkeys.tap(letter);
+        }
+    }
+    streams.push_back(deadkeys);
+
+    Stream altChar{ "altchar" };  //kingcon: LALT held + key, LALT tapped + key
+    altChar.down("LALT");
+    altChar.type({ "'", ";", "[", "]", "B" });
+    altChar.down("LSHF");
+    altChar.type({ "'", ";", "Q" });
+    altChar.up("LSHF");
+    altChar.up("LALT");
+    for (const char *key : { "D", "T", "2", "U" })
+    {
+        altChar.tap("LALT");
+        altChar.tap(key);
+    }
+    streams.push_back(altChar);
+    return streams;
+}
+
+//synthetic configs: every key of SYNTHETIC_KEYS with every mask over 8 modifiers, one COMBO per (mask, key), up to the count
+const vector<string> SYNTHETIC_KEYS = { "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P", "Q", "R", "S", "T",
+    "U", "V", "W", "X", "Y", "Z", "1", "2", "3", "4", "5", "6", "7", "8", "9", "0", "F1", "F2", "F3", "F4" };
+//mask bits 7..4: MOD12..MOD9 (rewired keys), bits 3..0: LALT LWIN LCTRL LSHF
+const vector<string> SYNTHETIC_MODIFIER_KEYS = { "LSHF", "LCTRL", "LWIN", "LALT", "CAPS", "TAB", "RSHF", "RCTRL" };
+
+string syntheticMask(int mask)
+{
+    string s = "[";
+    for (int bit = 7; bit >= 4; bit--)
+        s += (mask & (1 << bit)) ? '&' : '^';
+    s += " .... ";
+    for (int bit = 3; bit >= 0; bit--)
+        s += (mask & (1 << bit)) ? '&' : '^';
+    return s + "]";
+}
+
+bool writeSyntheticIni(string fileName, int combos)
+{
+    ofstream f(fileName, ios::trunc);
+    f << "GLOBAL ActiveConfigOnStartup 1" << endl
+        << "[CONFIG_1]" << endl
+        << "OPTION configName = synthetic" << endl
+        << "REWIRE CAPS MOD9" << endl
+        << "REWIRE TAB MOD10" << endl
+        << "REWIRE RSHF MOD11" << endl
+        << "REWIRE RCTRL MOD12" << endl;
+    int n = 0;
+    for (int mask = 0; mask < 256 && n < combos; mask++)
+    {
+        for (size_t key = 0; key < SYNTHETIC_KEYS.size() && n < combos; key++, n++)
+            f << "COMBO " << SYNTHETIC_KEYS[key] << " " << syntheticMask(mask)
+                << " > key(" << SYNTHETIC_KEYS[(key + 1) % SYNTHETIC_KEYS.size()] << ")" << endl;
+    }
+    return (bool)f;
+}
+
+//holds a few modifier masks, types keys under each. With fewer combos the higher masks miss.
+Stream makeSyntheticStream()
+{
+    Stream stream{ "combos" };
+    for (int mask : { 0x00, 0x01, 0x02, 0x10, 0x21, 0x5A, 0xFF })
+    {
+        for (int bit = 0; bit < 8; bit++)
+            if (mask & (1 << bit))
+                stream.down(SYNTHETIC_MODIFIER_KEYS[bit]);
+        stream.type({ "A", "S", "D", "F", "J", "K", "L", "1", "9", "F2" });
+        for (int bit = 7; bit >= 0; bit--)
+            if (mask & (1 << bit))
+                stream.up(SYNTHETIC_MODIFIER_KEYS[bit]);
+    }
+    return stream;
+}
+
+long long median(vector<long long> values)
+{
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+string baseName(const string &fileName)
+{
+    return filesystem::path(fileName).filename().string();
+}
+
+//median ns per stroke; -1 if the ini cannot be loaded
+long long measureStream(string iniFileName, const Stream &stream, bool interpret, int runs, long long strokesPerRun)
+{
+    NullIO io;
+    NoSleepClock clock;
+    EngineHost host;
+    Engine engine(io, clock, host);
+    engine.iniFileName = iniFileName;
+    engine.useConfigCache = false;
+    engine.interpretConfig = interpret;
+    if (!engine.loadIni())
+        return -1;
+    engine.waitForCompileWorker();
+    engine.options.delayForKeySequenceMS = 0;
+
+    long long repeats = max(1LL, strokesPerRun / (long long)stream.strokes.size());
+    for (const InterceptionKeyStroke &stroke : stream.strokes)  //warm up
+        engine.processStroke(INTERCEPTION_KEYBOARD(0), stroke);
+    engine.flushOutput();
+
+    vector<long long> perStroke;
+    for (int run = 0; run < runs; run++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long r = 0; r < repeats; r++)
+            for (const InterceptionKeyStroke &stroke : stream.strokes)
+                engine.processStroke(INTERCEPTION_KEYBOARD(0), stroke);
+        long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        perStroke.push_back(ns / (repeats * (long long)stream.strokes.size()));
+        engine.flushOutput();
+    }
+    return median(perStroke);
+}
+
+struct LoadTime
+{
+    long long startupUS;
+    long long allConfigsUS;
+};
+
+LoadTime measureLoad(string iniFileName)
+{
+    NullIO io;
+    NoSleepClock clock;
+    EngineHost host;
+    Engine engine(io, clock, host);
+    engine.iniFileName = iniFileName;
+    engine.useConfigCache = false;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    engine.loadIni();
+    long long startupUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    engine.waitForCompileWorker();
+    long long allConfigsUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return { startupUS, allConfigsUS };
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 9;
+    long long strokesPerRun = 100000;
+    vector<string> iniFileNames;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = max(1, atoi(argv[++i]));
+        else if (arg == "--strokes" && i + 1 < argc)
+            strokesPerRun = max(1LL, atoll(argv[++i]));
+        else
+            iniFileNames.push_back(arg);
+    }
+    if (iniFileNames.empty())
+        iniFileNames = { "capsicain.ini", "capsicain.kingcon.ini", "capsicain.example.ini" };
+
+    //the engine talks a lot while loading
+    streambuf *console = cout.rdbuf(nullptr);
+    ostream results(console);
+    const char *modeNames[] = { "compiled", "interpreted" };
+
+    results << "bench,config,stream,mode,strokes,median,unit" << endl;
+    vector<Stream> streams = makeStreams();
+    for (const string &iniFileName : iniFileNames)
+    {
+        for (const Stream &stream : streams)
+        {
+            for (bool interpret : { false, true })
+            {
+                long long ns = measureStream(iniFileName, stream, interpret, runs, strokesPerRun);
+                if (ns < 0)
+                {
+                    cerr << "Cannot read " << iniFileName << endl;
+                    break;
+                }
+                results << "stroke," << baseName(iniFileName) << "," << stream.name << "," << modeNames[interpret] << ","
+                    << strokesPerRun << "," << ns << ",ns" << endl;
+            }
+        }
+    }
+
+    Stream synthetic = makeSyntheticStream();
+    string syntheticFileName = (filesystem::temp_directory_path() / "capsicain.keybench.ini").string();
+    for (int combos : { 100, 1000, 10000 })
+    {
+        if (!writeSyntheticIni(syntheticFileName, combos))
+        {
+            cerr << "Cannot write " << syntheticFileName << endl;
+            return 1;
+        }
+        string config = "synthetic-" + to_string(combos);
+        for (bool interpret : { false, true })
+        {
+            long long ns = measureStream(syntheticFileName, synthetic, interpret, runs, strokesPerRun);
+            results << "stroke," << config << "," << synthetic.name << "," << modeNames[interpret] << ","
+                << strokesPerRun << "," << ns << ",ns" << endl;
+        }
+
+        vector<long long> startup, allConfigs;
+        for (int run = 0; run < runs; run++)
+        {
+            LoadTime t = measureLoad(syntheticFileName);
+            startup.push_back(t.startupUS);
+            allConfigs.push_back(t.allConfigsUS);
+        }
+        results << "load," << config << ",startup,nocache,," << median(startup) << ",us" << endl;
+        results << "load," << config << ",allConfigs,nocache,," << median(allConfigs) << ",us" << endl;
+    }
+    remove(syntheticFileName.c_str());
+    return 0;
+}
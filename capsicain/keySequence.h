@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+
+// Key sequences are compiled to a compact bytecode: one 32 bit word per instruction,
+// opcode in the top byte, argument in the low 24 bits. Engine::playKeySequence() runs it.
+// Commands carry their own argument, there are no 'param' key events to track.
+
+enum SEQ_OPCODE
+{
+    SEQ_PRESS = 0,            //arg: vcode
+    SEQ_RELEASE,              //arg: vcode
+    SEQ_SLEEP,                //arg: milliseconds
+    SEQ_REPEAT,               //arg: count. Plays everything up to the matching SEQ_REPEAT_END count times
+    SEQ_REPEAT_END,
+    SEQ_TEMPRELEASEKEYS,      //release and remember all keys that are physically down
+    SEQ_TEMPRESTOREKEYS,      //restore all keys that were down before SEQ_TEMPRELEASEKEYS
+    SEQ_DEADKEY,              //arg: deadkey scancode
+    SEQ_CONFIGSWITCH,         //arg: config number
+    SEQ_RECORDMACRO,          //arg: macro number
+    SEQ_RECORDSECRETMACRO,    //arg: macro number
+    SEQ_PLAYMACRO,            //arg: macro number
+    SEQ_SECRET,               //the key args that follow are obfuscated
+};
+
+#define SEQ_MAX_REPEAT_NESTING 4
+
+typedef unsigned int SeqOp;
+
+inline SeqOp makeSeqOp(SEQ_OPCODE opcode, int arg)
+{
+    return ((unsigned int)opcode << 24) | ((unsigned int)arg & 0xFFFFFF);
+}
+inline SEQ_OPCODE getSeqOpcode(SeqOp op)
+{
+    return (SEQ_OPCODE)(op >> 24);
+}
+inline int getSeqArg(SeqOp op)
+{
+    return (int)(op & 0xFFFFFF);
+}
+
+struct KeySequence
+{
+    std::vector<SeqOp> ops;
+
+    size_t size() const { return ops.size(); }
+    void clear() { ops.clear(); }
+    void add(SEQ_OPCODE opcode, int arg = 0) { ops.push_back(makeSeqOp(opcode, arg)); }
+    void press(int vcode) { add(SEQ_PRESS, vcode); }
+    void release(int vcode) { add(SEQ_RELEASE, vcode); }
+    void pressRelease(int vcode) { press(vcode); release(vcode); }
+    bool operator==(const KeySequence &other) const { return ops == other.ops; }
+};
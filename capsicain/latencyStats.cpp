@@ -0,0 +1,200 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <algorithm>
+
+#include "latencyStats.h"
+
+using namespace std;
+
+const char *getLatencyStageName(LATENCY_STAGE stage)
+{
+    switch (stage)
+    {
+    case LATENCY_DECISION: return "receive-to-decision";
+    case LATENCY_SEND: return "decision-to-send";
+    case LATENCY_ROUNDTRIP: return "round trip";
+    default: return "?";
+    }
+}
+
+const char *getLatencyOutcomeName(LATENCY_OUTCOME outcome)
+{
+    switch (outcome)
+    {
+    case LATENCY_PASSTHROUGH: return "passthrough";
+    case LATENCY_REWIRE: return "rewire";
+    case LATENCY_COMBO: return "combo";
+    case LATENCY_SEQUENCE: return "sequence";
+    default: return "?";
+    }
+}
+
+//v > 0
+static int highestBit(unsigned long long v)
+{
+    int bit = 0;
+    if (v >> 32) { v >>= 32; bit += 32; }
+    if (v >> 16) { v >>= 16; bit += 16; }
+    if (v >> 8) { v >>= 8; bit += 8; }
+    if (v >> 4) { v >>= 4; bit += 4; }
+    if (v >> 2) { v >>= 2; bit += 2; }
+    if (v >> 1) bit += 1;
+    return bit;
+}
+
+//values below 2*LATENCY_SUB_BUCKETS have a bucket each. Above, every power of two is split into LATENCY_SUB_BUCKETS buckets.
+int LatencyHistogram::bucketForValue(unsigned long long ns)
+{
+    if (ns < 2 * LATENCY_SUB_BUCKETS)
+        return (int)ns;
+    if (ns >> LATENCY_MAX_BIT)
+        return LATENCY_BUCKETS - 1;
+    int shift = highestBit(ns) - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)(ns >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+unsigned long long LatencyHistogram::highestValueInBucket(int bucket)
+{
+    if (bucket < 2 * LATENCY_SUB_BUCKETS)
+        return bucket;
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    unsigned long long lowest = (unsigned long long)(bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS) << shift;
+    return lowest + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long ns)
+{
+    //one writer thread per histogram: load + store is enough, no locked read-modify-write
+    atomic<unsigned int> &counter = counts[bucketForValue(ns)];
+    counter.store(counter.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    if (ns > maxValue.load(memory_order_relaxed))
+        maxValue.store(ns, memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (atomic<unsigned int> &counter : counts)
+        counter.store(0, memory_order_relaxed);
+    maxValue.store(0, memory_order_relaxed);
+}
+
+unsigned long long LatencyHistogram::count() const
+{
+    unsigned long long total = 0;
+    for (const atomic<unsigned int> &counter : counts)
+        total += counter.load(memory_order_relaxed);
+    return total;
+}
+
+unsigned long long LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    unsigned long long total = count();
+    if (total == 0)
+        return 0;
+    unsigned long long target = (unsigned long long)ceil(total * percentile / 100.0);
+    if (target < 1)
+        target = 1;
+    unsigned long long seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+    {
+        seen += counts[bucket].load(memory_order_relaxed);
+        if (seen >= target)
+            return min(highestValueInBucket(bucket), maxNS());
+    }
+    return maxNS();
+}
+
+void LatencyHistogram::printDistribution(ostream &out) const
+{
+    unsigned long long total = count();
+    if (total == 0)
+        return;
+    unsigned long long seen = 0;
+    out << setw(14) << "value(us)" << setw(12) << "percentile" << setw(12) << "count" << endl;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS && seen < total; bucket++)
+    {
+        unsigned int n = counts[bucket].load(memory_order_relaxed);
+        if (n == 0)
+            continue;
+        seen += n;
+        out << fixed << setprecision(3) << setw(14) << min(highestValueInBucket(bucket), maxNS()) / 1000.0
+            << setprecision(4) << setw(12) << 100.0 * seen / total << setw(12) << seen << endl;
+    }
+    out << defaultfloat;
+}
+
+LatencyStats::LatencyStats()
+{
+    for (atomic<bool> &requested : resetRequested)
+        requested.store(false, memory_order_relaxed);
+}
+
+void LatencyStats::record(LATENCY_STAGE stage, LATENCY_OUTCOME outcome, chrono::steady_clock::duration latency)
+{
+    //a reset from another thread would race with this writer, so the writer does it
+    if (resetRequested[stage].load(memory_order_relaxed))
+    {
+        for (int i = 0; i < NUM_LATENCY_OUTCOMES; i++)
+            histograms[stage][i].reset();
+        resetRequested[stage].store(false, memory_order_relaxed);
+    }
+    long long ns = chrono::duration_cast<chrono::nanoseconds>(latency).count();
+    histograms[stage][outcome].record(ns > 0 ? ns : 0);
+}
+
+void LatencyStats::requestReset()
+{
+    for (atomic<bool> &requested : resetRequested)
+        requested.store(true, memory_order_relaxed);
+}
+
+void LatencyStats::printSummary(ostream &out) const
+{
+    out << "latency (microseconds)" << endl
+        << left << setw(21) << "stage" << setw(13) << "outcome" << right
+        << setw(10) << "count" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p99.9" << setw(10) << "max" << endl;
+    bool any = false;
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++)
+    {
+        for (int outcome = 0; outcome < NUM_LATENCY_OUTCOMES; outcome++)
+        {
+            const LatencyHistogram &h = histograms[stage][outcome];
+            unsigned long long count = h.count();
+            if (count == 0)
+                continue;
+            any = true;
+            out << left << setw(21) << getLatencyStageName((LATENCY_STAGE)stage) << setw(13) << getLatencyOutcomeName((LATENCY_OUTCOME)outcome) << right
+                << setw(10) << count << fixed << setprecision(1)
+                << setw(10) << h.valueAtPercentile(50) / 1000.0
+                << setw(10) << h.valueAtPercentile(99) / 1000.0
+                << setw(10) << h.valueAtPercentile(99.9) / 1000.0
+                << setw(10) << h.maxNS() / 1000.0 << endl;
+        }
+    }
+    if (!any)
+        out << "(no keys measured yet)" << endl;
+    out << defaultfloat;
+}
+
+bool LatencyStats::writeFile(const string &fileName) const
+{
+    ofstream f(fileName, ios::trunc);
+    if (!f)
+        return false;
+    printSummary(f);
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; stage++)
+    {
+        for (int outcome = 0; outcome < NUM_LATENCY_OUTCOMES; outcome++)
+        {
+            const LatencyHistogram &h = histograms[stage][outcome];
+            if (h.count() == 0)
+                continue;
+            f << endl << "# " << getLatencyStageName((LATENCY_STAGE)stage) << " / " << getLatencyOutcomeName((LATENCY_OUTCOME)outcome) << endl;
+            h.printDistribution(f);
+        }
+    }
+    return (bool)f;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Latency histograms of the key pipeline, always on (ESC+S shows them, ESC+P writes them to a file).
+// HDR style: log-linear buckets, 32 per power of two, so every value from 1 ns to ~18 minutes is kept with ~3% precision.
+// Recording is an index computation and a counter increment, no allocation, no lock.
+// Each stage has one writer thread. Readers may read while it records; the counters are relaxed atomics.
+// A reset is only requested by other threads; the writer clears its histograms before it records the next value.
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <ostream>
+
+//receive-to-decision is recorded on the input thread, decision-to-send and the round trip on the output thread
+enum LATENCY_STAGE
+{
+    LATENCY_DECISION = 0,  //stroke received until the engine knows what to send
+    LATENCY_SEND,          //decision until the first resulting stroke is handed to the output
+    LATENCY_ROUNDTRIP,     //stroke received until the first resulting stroke is handed to the output
+    NUM_LATENCY_STAGES
+};
+
+enum LATENCY_OUTCOME
+{
+    LATENCY_PASSTHROUGH = 0,  //the key goes out unchanged
+    LATENCY_REWIRE,           //one key out, but another one (rewire, alpha layout, tap rewire)
+    LATENCY_COMBO,            //a combo matched, at most one key press out
+    LATENCY_SEQUENCE,         //more than one key press out, or sequence commands (altChar, sequence(), macros)
+    NUM_LATENCY_OUTCOMES
+};
+
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BIT 40  //2^40 ns; bigger values are counted in the last bucket
+#define LATENCY_BUCKETS ((LATENCY_MAX_BIT - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() { reset(); }
+
+    void record(unsigned long long ns);
+    void reset();
+    unsigned long long count() const;
+    unsigned long long maxNS() const { return maxValue.load(std::memory_order_relaxed); }
+    //smallest recorded bucket value that at least percentile % of all values are not bigger than
+    unsigned long long valueAtPercentile(double percentile) const;
+    //the full distribution, one line per used bucket: value (us), percentile, count up to here
+    void printDistribution(std::ostream &out) const;
+
+    static int bucketForValue(unsigned long long ns);
+    static unsigned long long highestValueInBucket(int bucket);
+
+private:
+    std::atomic<unsigned int> counts[LATENCY_BUCKETS];
+    std::atomic<unsigned long long> maxValue;
+};
+
+//timestamps of one incoming stroke, handed from the input thread to the output thread with its first resulting stroke
+struct LatencyTag
+{
+    std::chrono::steady_clock::time_point received;
+    std::chrono::steady_clock::time_point decided;
+    LATENCY_OUTCOME outcome = LATENCY_PASSTHROUGH;
+    bool valid = false;
+};
+
+class LatencyStats
+{
+public:
+    LatencyHistogram histograms[NUM_LATENCY_STAGES][NUM_LATENCY_OUTCOMES];
+
+    LatencyStats();
+
+    void record(LATENCY_STAGE stage, LATENCY_OUTCOME outcome, std::chrono::steady_clock::duration latency);
+    //start all histograms over. Any thread; each stage is cleared by its writer thread at its next record()
+    void requestReset();
+    //count, p50, p99, p99.9 and max per stage and outcome, in microseconds
+    void printSummary(std::ostream &out) const;
+    //the summary and the full distribution of every histogram
+    bool writeFile(const std::string &fileName) const;
+
+private:
+    std::atomic<bool> resetRequested[NUM_LATENCY_STAGES];
+};
+
+const char *getLatencyStageName(LATENCY_STAGE stage);
+const char *getLatencyOutcomeName(LATENCY_OUTCOME outcome);
@@ -6,16 +6,6 @@
 
 const int NUMBER_OF_MODIFIERS = 15;
 
-unsigned short getModifierBitmaskForVcode(int vcode);
-
-unsigned short getModifierForBitmask(unsigned short bitmask);
-
-bool isModifier(int vcode);
-
-bool isRealModifier(int vcode);
-
-bool isVirtualModifier(int vcode);
-
 #define BITMASK_LSHIFT      0x001
 #define BITMASK_LCTRL       0x002
 #define BITMASK_LWIN        0x004
@@ -32,6 +22,94 @@ bool isVirtualModifier(int vcode);
 #define BITMASK_MOD14       0x2000
 #define BITMASK_MOD15       0x4000
 
+enum MODIFIER_TYPE : unsigned char
+{
+    MODIFIER_NONE = 0,
+    MODIFIER_REAL,      //the 8 hardware modifiers, low byte of the bitmask
+    MODIFIER_VIRTUAL    //MOD9..MOD15
+};
+
+struct ModifierInfo
+{
+    unsigned short bitmask;  //0 if the vcode is not a modifier
+    MODIFIER_TYPE type;
+};
+
+struct ModifierTables
+{
+    ModifierInfo byVcode[MAX_VCODES];
+    unsigned short vcodeByBit[NUMBER_OF_MODIFIERS];  //inverse: the modifier vcode for bitmask (1 << bit)
+    bool valid;
+};
+
+constexpr ModifierTables makeModifierTables()
+{
+    //stores {SC_LSHIFT/42 = 00001b},{VK_LCTRL = 010b}, ... {VK_MOD15, 100000000000000b}
+    const unsigned short modifierToBitmask[2][NUMBER_OF_MODIFIERS] =
+    {
+        {SC_LSHIFT, SC_LCTRL, SC_LALT, SC_LWIN,
+        SC_RSHIFT, SC_RCTRL, SC_RALT, SC_RWIN,
+        VK_MOD9, VK_MOD10, VK_MOD11, VK_MOD12,
+        VK_MOD13, VK_MOD14, VK_MOD15} ,
+
+        {BITMASK_LSHIFT, BITMASK_LCTRL, BITMASK_LALT, BITMASK_LWIN,
+        BITMASK_RSHIFT, BITMASK_RCTRL, BITMASK_RALT, BITMASK_RWIN,
+        BITMASK_MOD9, BITMASK_MOD10, BITMASK_MOD11, BITMASK_MOD12,
+        BITMASK_MOD13, BITMASK_MOD14, BITMASK_MOD15}
+    };
+
+    ModifierTables tables = {};
+    tables.valid = true;
+    for (int i = 0; i < NUMBER_OF_MODIFIERS; i++)
+    {
+        int vcode = modifierToBitmask[0][i];
+        unsigned short bitmask = modifierToBitmask[1][i];
+        int bit = 0;
+        while (bit < NUMBER_OF_MODIFIERS && bitmask != (1 << bit))
+            bit++;
+        //one bit per modifier, one modifier per bit
+        if (vcode <= 0 || vcode >= MAX_VCODES || bit == NUMBER_OF_MODIFIERS
+            || tables.byVcode[vcode].bitmask != 0 || tables.vcodeByBit[bit] != 0)
+        {
+            tables.valid = false;
+            continue;
+        }
+        tables.byVcode[vcode].bitmask = bitmask;
+        tables.byVcode[vcode].type = (bitmask & 0xFF) ? MODIFIER_REAL : MODIFIER_VIRTUAL;
+        tables.vcodeByBit[bit] = (unsigned short)vcode;
+    }
+    return tables;
+}
+
+inline constexpr ModifierTables MODIFIER_TABLES = makeModifierTables();
+static_assert(MODIFIER_TABLES.valid, "modifier table: every modifier needs its own vcode and its own single bit");
+
+//returns 0 if vcode is not a modifier
+inline unsigned short getModifierBitmaskForVcode(int vcode)
+{
+    return (unsigned int)vcode < MAX_VCODES ? MODIFIER_TABLES.byVcode[vcode].bitmask : 0;
+}
+
+//the modifier vcode for bitmask (1 << bit)
+inline unsigned short getModifierForBit(int bit)
+{
+    return (unsigned int)bit < NUMBER_OF_MODIFIERS ? MODIFIER_TABLES.vcodeByBit[bit] : 0;
+}
+
+inline bool isModifier(int vcode)
+{
+    return getModifierBitmaskForVcode(vcode) != 0;
+}
+
+inline bool isRealModifier(int vcode)
+{
+    return (unsigned int)vcode < MAX_VCODES && MODIFIER_TABLES.byVcode[vcode].type == MODIFIER_REAL;
+}
+
+inline bool isVirtualModifier(int vcode)
+{
+    return (unsigned int)vcode < MAX_VCODES && MODIFIER_TABLES.byVcode[vcode].type == MODIFIER_VIRTUAL;
+}
 
 #define IS_SHIFT_DOWN (modifierState.modifierDown & BITMASK_LSHIFT || modifierState.modifierDown & BITMASK_RSHIFT)
 #define IS_LSHIFT_DOWN (modifierState.modifierDown & BITMASK_LSHIFT)
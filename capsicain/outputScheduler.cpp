@@ -0,0 +1,145 @@
+#include "pch.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "outputScheduler.h"
+#include "engine.h"
+
+using namespace std;
+
+OutputScheduler::OutputScheduler(EngineOutput &output, EngineClock &clock, LatencyStats &latency)
+    : output(output), clock(clock), latency(latency)
+{
+    sender = thread(&OutputScheduler::runSender, this);
+}
+
+OutputScheduler::~OutputScheduler()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stop = true;
+    }
+    wakeSender.notify_one();
+    sender.join();
+}
+
+void OutputScheduler::send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count)
+{
+    bool wake;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            queue.push_back({ device, strokes[i], 0, nextTag });
+            nextTag.valid = false;
+        }
+        wake = senderWaiting && openBatches == 0;
+    }
+    if (wake)
+        wakeSender.notify_one();
+}
+
+void OutputScheduler::pause(unsigned int ms)
+{
+    if (ms == 0)
+        return;
+    bool wake;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.push_back({ 0, {}, ms, {} });
+        wake = senderWaiting && openBatches == 0;
+    }
+    //a pause alone sends nothing, but the sender must take it out of the queue, or waitUntilIdle() waits forever
+    if (wake)
+        wakeSender.notify_one();
+}
+
+void OutputScheduler::waitUntilIdle()
+{
+    unique_lock<mutex> lock(queueMutex);
+    unsigned int batches = openBatches;
+    openBatches = 0;
+    if (batches > 0 && senderWaiting)
+        wakeSender.notify_one();
+    idle.wait(lock, [this] { return queue.empty() && !sending; });
+    openBatches = batches;
+}
+
+void OutputScheduler::beginBatch()
+{
+    lock_guard<mutex> lock(queueMutex);
+    openBatches++;
+}
+
+void OutputScheduler::endBatch()
+{
+    bool wake;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        wake = --openBatches == 0 && senderWaiting && !queue.empty();
+    }
+    if (wake)
+        wakeSender.notify_one();
+}
+
+//sends the queue in order. A pause delays the next stroke relative to the stroke before it, or to the time
+//the pause is taken out of the queue if that stroke went out earlier (a leading sleep(), a pause after idle time).
+//So a pause at the end of a sequence costs nothing if the next key comes later anyway.
+void OutputScheduler::runSender()
+{
+    InterceptionKeyStroke batch[OUTPUT_BATCH_SIZE];
+    LatencyTag tags[OUTPUT_BATCH_SIZE];
+    chrono::steady_clock::time_point notBefore = clock.now();
+
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        if (queue.empty() || (openBatches > 0 && !stop))
+        {
+            if (queue.empty())
+                idle.notify_all();
+            if (queue.empty() && stop)
+                return;
+            senderWaiting = true;
+            wakeSender.wait(lock, [this] { return (!queue.empty() && openBatches == 0) || stop; });
+            senderWaiting = false;
+            continue;
+        }
+
+        if (queue.front().pauseMS > 0)
+        {
+            notBefore = max(notBefore, clock.now()) + chrono::milliseconds(queue.front().pauseMS);
+            queue.pop_front();
+            continue;
+        }
+
+        //take all strokes up to the next pause or device change
+        InterceptionDevice device = queue.front().device;
+        unsigned int count = 0;
+        while (count < OUTPUT_BATCH_SIZE && !queue.empty() && queue.front().pauseMS == 0 && queue.front().device == device)
+        {
+            tags[count] = queue.front().tag;
+            batch[count++] = queue.front().stroke;
+            queue.pop_front();
+        }
+        sending = true;
+        lock.unlock();
+
+        if (clock.now() < notBefore)
+            clock.sleepUntil(notBefore);
+        output.send(device, batch, count);
+        notBefore = clock.now();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            if (!tags[i].valid)
+                continue;
+            latency.record(LATENCY_SEND, tags[i].outcome, notBefore - tags[i].decided);
+            latency.record(LATENCY_ROUNDTRIP, tags[i].outcome, notBefore - tags[i].received);
+        }
+
+        lock.lock();
+        sending = false;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Timed output queue between the engine and EngineOutput.
+// The engine thread decides what to send and queues it, with the pauses between the strokes of a key sequence.
+// A separate thread sends the strokes in queue order and waits out the pauses, so a long sequence
+// (altChar, sequence() with sleep) no longer blocks the processing of new input.
+// All output goes through the same queue, so direct keys never overtake a sequence that is still playing.
+// The engine queues the output of one input stroke inside a Batch: the sender only takes it when it is complete,
+// so a sequence without pauses goes to EngineOutput::send() in one call.
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "interception.h"  //only for the InterceptionKeyStroke / InterceptionDevice types
+#include "latencyStats.h"
+
+class EngineOutput;
+class EngineClock;
+
+#define OUTPUT_BATCH_SIZE 32  //strokes without a pause in between go to EngineOutput::send() together
+
+class OutputScheduler
+{
+public:
+    OutputScheduler(EngineOutput &output, EngineClock &clock, LatencyStats &latency);
+    ~OutputScheduler();  //sends everything that is still queued
+
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count);
+    //the next stroke sent carries these timestamps; the sender thread records its latency when it is out.
+    //Only the engine thread calls send() and tagNextStroke(). An invalid tag clears a tag that was not used.
+    void tagNextStroke(const LatencyTag &tag) { nextTag = tag; }
+    //the next stroke goes out no earlier than ms after the previous one, and no earlier than ms from now
+    void pause(unsigned int ms);
+    //blocks until everything queued so far is sent. Use before asking the OS about state that the queued strokes change.
+    //Sends an open batch as it is.
+    void waitUntilIdle();
+
+    //the sender leaves the strokes queued while a Batch is alive. Batches nest; only the engine thread opens them.
+    class Batch
+    {
+    public:
+        Batch(OutputScheduler &scheduler) : scheduler(scheduler) { scheduler.beginBatch(); }
+        ~Batch() { scheduler.endBatch(); }
+        Batch(const Batch &) = delete;
+        Batch &operator=(const Batch &) = delete;
+    private:
+        OutputScheduler &scheduler;
+    };
+
+private:
+    struct Entry
+    {
+        InterceptionDevice device;
+        InterceptionKeyStroke stroke;
+        unsigned int pauseMS;  //>0: a pause, no stroke
+        LatencyTag tag;
+    };
+
+    EngineOutput &output;
+    EngineClock &clock;
+    LatencyStats &latency;
+    LatencyTag nextTag;
+
+    std::mutex queueMutex;
+    std::condition_variable wakeSender;
+    std::condition_variable idle;
+    std::deque<Entry> queue;
+    bool sending = false;  //the sender thread holds strokes taken from the queue
+    bool senderWaiting = false;
+    bool stop = false;
+    unsigned int openBatches = 0;
+    std::thread sender;
+
+    void beginBatch();
+    void endBatch();
+    void runSender();
+};
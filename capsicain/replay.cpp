@@ -0,0 +1,154 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+
+#include "engine.h"
+#include "headlessIO.h"
+#include "inputCapture.h"
+
+using namespace std;
+
+// Replays a capture (ESC+G, or capsicain_headless --capture) through the engine.
+// The engine sees the captured timestamps through a virtual clock, and nothing waits (sequence pauses, LED delays),
+// so a replay gives the same output every time and runs as fast as the engine can.
+// Writes the strokes the engine sends out to stdout, in the capsicain_headless format. Engine console output goes to stderr.
+//
+// usage: capsicain_replay [--nocache] [--bench N] capture.file [path/to/capsicain.ini]
+//
+// --nocache  always parse the ini; do not read or write the compiled config cache (<ini>.cache)
+// --bench N  no output; replay N times and report the time per stroke of the engine loop
+
+#define VIRTUAL_CLOCK_START_US 1000000  //time_point 0 means 'not set' in places (flight recorder)
+
+class VirtualClock : public EngineClock
+{
+public:
+    //the input thread moves the time forward, stroke by stroke
+    void set(long long timeUS) { nowNS = (VIRTUAL_CLOCK_START_US + timeUS) * 1000; }
+
+    chrono::steady_clock::time_point now() override
+    {
+        return chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(nowNS.load())));
+    }
+    void sleepMS(unsigned int ms) override {}
+    void sleepUntil(chrono::steady_clock::time_point time) override {}
+
+private:
+    atomic<long long> nowNS{ VIRTUAL_CLOCK_START_US * 1000LL };
+};
+
+class NullIO : public EngineOutput
+{
+public:
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override {}
+    bool isLockKeyOn(int scancode) override { return false; }
+};
+
+bool useConfigCache = true;
+
+bool startEngine(Engine &engine, string iniFileName)
+{
+    engine.iniFileName = iniFileName;
+    engine.useConfigCache = useConfigCache;
+    if (!engine.loadIni())
+    {
+        cerr << endl << "Cannot read " << engine.iniFileName << endl;
+        return false;
+    }
+    return true;
+}
+
+//feeds all strokes; false if the engine asked to exit before the end
+bool replay(Engine &engine, VirtualClock &clock, const vector<CapturedStroke> &strokes)
+{
+    for (const CapturedStroke &captured : strokes)
+    {
+        clock.set(captured.timeUS);
+        if (!engine.processStroke(captured.device, captured.stroke))
+            return false;
+    }
+    return true;
+}
+
+int bench(const vector<CapturedStroke> &strokes, string iniFileName, int runs, ostream &results)
+{
+    long long totalNS = 0;
+    for (int run = 0; run < runs; run++)
+    {
+        NullIO io;
+        VirtualClock clock;
+        EngineHost host;
+        Engine engine(io, clock, host);
+        if (!startEngine(engine, iniFileName))
+            return 1;
+        engine.waitForCompileWorker();
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        replay(engine, clock, strokes);
+        totalNS += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        engine.finishInput();
+    }
+    double perStroke = strokes.empty() ? 0 : (double)totalNS / runs / strokes.size();
+    results << "strokes " << strokes.size() << " runs " << runs << " ns/stroke " << fixed << setprecision(1) << perStroke << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    //results on stdout, engine chatter on stderr
+    ostream results(cout.rdbuf());
+    cout.rdbuf(cerr.rdbuf());
+
+    int benchRuns = 0;
+    string captureFileName;
+    string iniFileName = "capsicain.ini";
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--nocache")
+            useConfigCache = false;
+        else if (arg == "--bench" && i + 1 < argc)
+            benchRuns = stoi(argv[++i]);
+        else if (captureFileName == "")
+            captureFileName = arg;
+        else
+            iniFileName = arg;
+    }
+    if (captureFileName == "")
+    {
+        cerr << "usage: capsicain_replay [--nocache] [--bench N] capture.file [path/to/capsicain.ini]" << endl;
+        return 1;
+    }
+
+    CaptureHeader header;
+    vector<CapturedStroke> strokes;
+    if (!readCapture(captureFileName, header, strokes))
+    {
+        cerr << "Cannot read capture " << captureFileName << endl;
+        return 1;
+    }
+
+    if (benchRuns > 0)
+    {
+        cout.rdbuf(nullptr);  //no engine chatter in the measurement
+        return bench(strokes, iniFileName, benchRuns, results);
+    }
+
+    HeadlessIO io(results);
+    VirtualClock clock;
+    EngineHost host;
+    Engine engine(io, clock, host);
+    if (!startEngine(engine, iniFileName))
+        return 1;
+    if (header.iniHash != engine.getIniHash())
+        cerr << endl << "WARNING: the capture was made with another ini than " << iniFileName << endl;
+
+    replay(engine, clock, strokes);
+    engine.finishInput();
+    results.flush();
+    return 0;
+}
@@ -1,40 +1,17 @@
 #pragma once
 #include "pch.h"
-#include <iostream>
-#include <Windows.h>  //for Sleep()
+#include <string_view>
 
 #include "scancodes.h"
 #include "constants.h"
-#include "utils.h"
 
 using namespace std;
 
-//returns -1 if label is not found, or if given SC_ string is not a number,
-//otherwise an 8bit scancode (can cast to unsigned char without checks)
-int getVcode(string label, string* arr)
+struct KeyLabel
 {
-    string ucLabel = stringToUpper(label);
-    for (int i = 0; i < MAX_VCODES; i++)
-    {
-        if (arr[i] == ucLabel)
-            return i;
-    }
-    return -1;
-}
-
-void checkAddLabel(int index, string label, string arr[])
-{
-    if (index >= MAX_VCODES)
-    {
-        cout << endl << endl <<"***********BUG: scancodes.h defines a virtual code "<< index << " that is bigger than MAX_VKEYS. Increase MAX_VKEYS !";
-        Sleep(10000);
-        exit(1);
-    }
-    if (arr[index] != "")
-        cout << endl << "ERROR initScancodeLabels: duplicate scancode in scancodes.h: 'SC_" << label << "' (index 0x" << hex << index << ")" << endl;
-    else
-        arr[index] = label;
-}
+    int vcode;
+    std::string_view label;
+};
 
 //List of all 'pretty' key labels that can be used in the .ini
 //Map scancodes via scancode labels to key labels that are used in the .ini
@@ -42,216 +19,399 @@ void checkAddLabel(int index, string label, string arr[])
 //All undefined scancodes get a generic label "SC_0XNN" (where NN is a hex value).
 //to re-sync automatically, run this regex in Notepad++ over scancodes.h enum:
 //from:  (.*)SC_(.*?) (.*)
-//to:    checkAddLabel\( SC_\2, "\2", arr\);
+//to:    { SC_\2, "\2" },
 //then make a bunch of modifications for nicer labels...
-void defineAllPrettyVKLabels(string arr[])
+//Labels must be upper case. The table is checked and hashed at compile time, see below.
+static constexpr KeyLabel KEY_LABELS[] =
 {
-    checkAddLabel(SC_NOP, "NOP", arr);
-    checkAddLabel(SC_ESCAPE, "ESC", arr);
-    checkAddLabel(SC_1, "1", arr);
-    checkAddLabel(SC_2, "2", arr);
-    checkAddLabel(SC_3, "3", arr);
-    checkAddLabel(SC_4, "4", arr);
-    checkAddLabel(SC_5, "5", arr);
-    checkAddLabel(SC_6, "6", arr);
-    checkAddLabel(SC_7, "7", arr);
-    checkAddLabel(SC_8, "8", arr);
-    checkAddLabel(SC_9, "9", arr);
-    checkAddLabel(SC_0, "0", arr);
-    checkAddLabel(SC_MINUS, "-", arr);
-    checkAddLabel(SC_EQUALS, "=", arr);
-    checkAddLabel(SC_BACK, "BSP", arr);
-    checkAddLabel(SC_TAB, "TAB", arr);
-    checkAddLabel(SC_Q, "Q", arr);
-    checkAddLabel(SC_W, "W", arr);
-    checkAddLabel(SC_E, "E", arr);
-    checkAddLabel(SC_R, "R", arr);
-    checkAddLabel(SC_T, "T", arr);
-    checkAddLabel(SC_Y, "Y", arr);
-    checkAddLabel(SC_U, "U", arr);
-    checkAddLabel(SC_I, "I", arr);
-    checkAddLabel(SC_O, "O", arr);
-    checkAddLabel(SC_P, "P", arr);
-    checkAddLabel(SC_LBRACK, "[", arr);
-    checkAddLabel(SC_RBRACK, "]", arr);
-    checkAddLabel(SC_RETURN, "RET", arr);
-    checkAddLabel(SC_LCTRL, "LCTRL", arr);
-    checkAddLabel(SC_A, "A", arr);
-    checkAddLabel(SC_S, "S", arr);
-    checkAddLabel(SC_D, "D", arr);
-    checkAddLabel(SC_F, "F", arr);
-    checkAddLabel(SC_G, "G", arr);
-    checkAddLabel(SC_H, "H", arr);
-    checkAddLabel(SC_J, "J", arr);
-    checkAddLabel(SC_K, "K", arr);
-    checkAddLabel(SC_L, "L", arr);
-    checkAddLabel(SC_SEMI, ";", arr);
-    checkAddLabel(SC_APOS, "'", arr);
-    checkAddLabel(SC_GRAVE, "`", arr);
-    checkAddLabel(SC_LSHIFT, "LSHF", arr);
-    checkAddLabel(SC_BSLASH, "\\", arr);
-    checkAddLabel(SC_Z, "Z", arr);
-    checkAddLabel(SC_X, "X", arr);
-    checkAddLabel(SC_C, "C", arr);
-    checkAddLabel(SC_V, "V", arr);
-    checkAddLabel(SC_B, "B", arr);
-    checkAddLabel(SC_N, "N", arr);
-    checkAddLabel(SC_M, "M", arr);
-    checkAddLabel(SC_COMMA, ",", arr);
-    checkAddLabel(SC_DOT, ".", arr);
-    checkAddLabel(SC_SLASH, "/", arr);
-    checkAddLabel(SC_RSHIFT, "RSHF", arr);
-    checkAddLabel(SC_NPMULT, "NP*", arr);
-    checkAddLabel(SC_LALT, "LALT", arr);
-    checkAddLabel(SC_SPACE, "SPACE", arr);
-    checkAddLabel(SC_CAPS, "CAPS", arr);
-    checkAddLabel(SC_F1, "F1", arr);
-    checkAddLabel(SC_F2, "F2", arr);
-    checkAddLabel(SC_F3, "F3", arr);
-    checkAddLabel(SC_F4, "F4", arr);
-    checkAddLabel(SC_F5, "F5", arr);
-    checkAddLabel(SC_F6, "F6", arr);
-    checkAddLabel(SC_F7, "F7", arr);
-    checkAddLabel(SC_F8, "F8", arr);
-    checkAddLabel(SC_F9, "F9", arr);
-    checkAddLabel(SC_F10, "F10", arr);
-    checkAddLabel(SC_NUMLOCK, "NUMLOCK", arr);
-    checkAddLabel(SC_SCRLOCK, "SCRLOCK", arr);
-    checkAddLabel(SC_NP7, "NP7", arr);
-    checkAddLabel(SC_NP8, "NP8", arr);
-    checkAddLabel(SC_NP9, "NP9", arr);
-    checkAddLabel(SC_NPSUB, "NP-", arr);
-    checkAddLabel(SC_NP4, "NP4", arr);
-    checkAddLabel(SC_NP5, "NP5", arr);
-    checkAddLabel(SC_NP6, "NP6", arr);
-    checkAddLabel(SC_NPADD, "NP+", arr);
-    checkAddLabel(SC_NP1, "NP1", arr);
-    checkAddLabel(SC_NP2, "NP2", arr);
-    checkAddLabel(SC_NP3, "NP3", arr);
-    checkAddLabel(SC_NP0, "NP0", arr);
-    checkAddLabel(SC_NPDOT, "NP.", arr);
-    checkAddLabel(SC_ALTPRINT, "ALTPRINT", arr);
-    checkAddLabel(SC_LBSLASH, "L\\", arr);
-    checkAddLabel(SC_F11, "F11", arr);
-    checkAddLabel(SC_F12, "F12", arr);
-    checkAddLabel(SC_NPEQUALS1, "NP=", arr);
-    checkAddLabel(SC_F13, "F13", arr);
-    checkAddLabel(SC_F14, "F14", arr);
-    checkAddLabel(SC_F15, "F15", arr);
-    checkAddLabel(SC_F16, "F16", arr);
-    checkAddLabel(SC_F17, "F17", arr);
-    checkAddLabel(SC_F18, "F18", arr);
-    checkAddLabel(SC_F19, "F19", arr);
-    checkAddLabel(SC_F20, "F20", arr);
-    checkAddLabel(SC_F21, "F21", arr);
-    checkAddLabel(SC_F22, "F22", arr);
-    checkAddLabel(SC_F23, "F23", arr);
-    checkAddLabel(SC_KANA, "KANA", arr);
-    checkAddLabel(SC_LANG2, "LANG2", arr);
-    checkAddLabel(SC_LANG1, "LANG1", arr);
-    checkAddLabel(SC_ABNT_C1, "ABNT_C1", arr);
-    checkAddLabel(SC_CONVERT, "CONVERT", arr);
-    checkAddLabel(SC_NOCONVERT, "NOCONVERT", arr);
-    checkAddLabel(SC_YEN, "YEN", arr);
-    checkAddLabel(SC_ABNT_C2, "ABNT_C2", arr);
+    { SC_NOP, "NOP" },
+    { SC_ESCAPE, "ESC" },
+    { SC_1, "1" },
+    { SC_2, "2" },
+    { SC_3, "3" },
+    { SC_4, "4" },
+    { SC_5, "5" },
+    { SC_6, "6" },
+    { SC_7, "7" },
+    { SC_8, "8" },
+    { SC_9, "9" },
+    { SC_0, "0" },
+    { SC_MINUS, "-" },
+    { SC_EQUALS, "=" },
+    { SC_BACK, "BSP" },
+    { SC_TAB, "TAB" },
+    { SC_Q, "Q" },
+    { SC_W, "W" },
+    { SC_E, "E" },
+    { SC_R, "R" },
+    { SC_T, "T" },
+    { SC_Y, "Y" },
+    { SC_U, "U" },
+    { SC_I, "I" },
+    { SC_O, "O" },
+    { SC_P, "P" },
+    { SC_LBRACK, "[" },
+    { SC_RBRACK, "]" },
+    { SC_RETURN, "RET" },
+    { SC_LCTRL, "LCTRL" },
+    { SC_A, "A" },
+    { SC_S, "S" },
+    { SC_D, "D" },
+    { SC_F, "F" },
+    { SC_G, "G" },
+    { SC_H, "H" },
+    { SC_J, "J" },
+    { SC_K, "K" },
+    { SC_L, "L" },
+    { SC_SEMI, ";" },
+    { SC_APOS, "'" },
+    { SC_GRAVE, "`" },
+    { SC_LSHIFT, "LSHF" },
+    { SC_BSLASH, "\\" },
+    { SC_Z, "Z" },
+    { SC_X, "X" },
+    { SC_C, "C" },
+    { SC_V, "V" },
+    { SC_B, "B" },
+    { SC_N, "N" },
+    { SC_M, "M" },
+    { SC_COMMA, "," },
+    { SC_DOT, "." },
+    { SC_SLASH, "/" },
+    { SC_RSHIFT, "RSHF" },
+    { SC_NPMULT, "NP*" },
+    { SC_LALT, "LALT" },
+    { SC_SPACE, "SPACE" },
+    { SC_CAPS, "CAPS" },
+    { SC_F1, "F1" },
+    { SC_F2, "F2" },
+    { SC_F3, "F3" },
+    { SC_F4, "F4" },
+    { SC_F5, "F5" },
+    { SC_F6, "F6" },
+    { SC_F7, "F7" },
+    { SC_F8, "F8" },
+    { SC_F9, "F9" },
+    { SC_F10, "F10" },
+    { SC_NUMLOCK, "NUMLOCK" },
+    { SC_SCRLOCK, "SCRLOCK" },
+    { SC_NP7, "NP7" },
+    { SC_NP8, "NP8" },
+    { SC_NP9, "NP9" },
+    { SC_NPSUB, "NP-" },
+    { SC_NP4, "NP4" },
+    { SC_NP5, "NP5" },
+    { SC_NP6, "NP6" },
+    { SC_NPADD, "NP+" },
+    { SC_NP1, "NP1" },
+    { SC_NP2, "NP2" },
+    { SC_NP3, "NP3" },
+    { SC_NP0, "NP0" },
+    { SC_NPDOT, "NP." },
+    { SC_ALTPRINT, "ALTPRINT" },
+    { SC_LBSLASH, "L\\" },
+    { SC_F11, "F11" },
+    { SC_F12, "F12" },
+    { SC_NPEQUALS1, "NP=" },
+    { SC_F13, "F13" },
+    { SC_F14, "F14" },
+    { SC_F15, "F15" },
+    { SC_F16, "F16" },
+    { SC_F17, "F17" },
+    { SC_F18, "F18" },
+    { SC_F19, "F19" },
+    { SC_F20, "F20" },
+    { SC_F21, "F21" },
+    { SC_F22, "F22" },
+    { SC_F23, "F23" },
+    { SC_KANA, "KANA" },
+    { SC_LANG2, "LANG2" },
+    { SC_LANG1, "LANG1" },
+    { SC_ABNT_C1, "ABNT_C1" },
+    { SC_CONVERT, "CONVERT" },
+    { SC_NOCONVERT, "NOCONVERT" },
+    { SC_YEN, "YEN" },
+    { SC_ABNT_C2, "ABNT_C2" },
 
     //poorly standardized special keys > 0x80, escaped with E0 (IKS state 2/3)
-    checkAddLabel(SC_NPEQUALS2, "NPEQUALS2", arr);
-    checkAddLabel(SC_PREVTRACK, "PREVTRACK", arr);
-    checkAddLabel(SC_AT, "AT", arr);
-    checkAddLabel(SC_COLON, "COLON", arr);
-    checkAddLabel(SC_UNDERLINE, "UNDERLINE", arr);
-    checkAddLabel(SC_KANJI, "KANJI", arr);
-    checkAddLabel(SC_STOP, "STOP", arr);
-    checkAddLabel(SC_AX, "AX", arr);
-    checkAddLabel(SC_UNLABELED, "UNLABELED", arr);
-    checkAddLabel(SC_NEXTTRACK, "NEXTTRACK", arr);
-    checkAddLabel(SC_NPRET, "NPRET", arr);
-    checkAddLabel(SC_RCTRL, "RCTRL", arr);
-    checkAddLabel(SC_MUTE, "MUTE", arr);
-    checkAddLabel(SC_CALCULATOR, "CALCULATOR", arr);
-    checkAddLabel(SC_PLAYPAUSE, "PLAYPAUSE", arr);
-    checkAddLabel(SC_MEDIASTOP, "MEDIASTOP", arr);
-    checkAddLabel(SC_E0LSHF, "E0LSHF", arr);
-    checkAddLabel(SC_VOLUMEDOWN, "VOLUMEDOWN", arr);
-    checkAddLabel(SC_VOLUMEUP, "VOLUMEUP", arr);
-    checkAddLabel(SC_WEBHOME, "WEBHOME", arr);
-    checkAddLabel(SC_NUMPADCOMMA, "NP,", arr);
-    checkAddLabel(SC_DIVIDE, "NP/", arr);
-    checkAddLabel(SC_PRINT, "PRINT", arr);
-    checkAddLabel(SC_RALT, "RALT", arr);
-    checkAddLabel(SC_BREAK, "SC_BREAK", arr);
-    checkAddLabel(SC_HOME, "HOME", arr);
-    checkAddLabel(SC_UP, "UP", arr);
-    checkAddLabel(SC_PGUP, "PGUP", arr);
-    checkAddLabel(SC_LEFT, "LEFT", arr);
-    checkAddLabel(SC_RIGHT, "RIGHT", arr);
-    checkAddLabel(SC_END, "END", arr);
-    checkAddLabel(SC_DOWN, "DOWN", arr);
-    checkAddLabel(SC_PGDOWN, "PGDOWN", arr);
-    checkAddLabel(SC_INSERT, "INS", arr);
-    checkAddLabel(SC_DELETE, "DEL", arr);
-    checkAddLabel(SC_LWIN, "LWIN", arr);
-    checkAddLabel(SC_RWIN, "RWIN", arr);
-    checkAddLabel(SC_APPS, "APPS", arr);
-    checkAddLabel(SC_POWER, "POWER", arr);
-    checkAddLabel(SC_SLEEP, "SLEEP", arr);
-    checkAddLabel(SC_WAKE, "WAKE", arr);
-    checkAddLabel(SC_WEBSEARCH, "WEBSEARCH", arr);
-    checkAddLabel(SC_WEBFAVORITES, "WEBFAVORITES", arr);
-    checkAddLabel(SC_WEBREFRESH, "WEBREFRESH", arr);
-    checkAddLabel(SC_WEBSTOP, "WEBSTOP", arr);
-    checkAddLabel(SC_WEBFORWARD, "WEBFORWARD", arr);
-    checkAddLabel(SC_WEBBACK, "WEBBACK", arr);
-    checkAddLabel(SC_MYCOMPUTER, "MYCOMPUTER", arr);
-    checkAddLabel(SC_MAIL, "MAIL", arr);
-    checkAddLabel(SC_MEDIASELECT, "MEDIASELECT", arr);
+    { SC_NPEQUALS2, "NPEQUALS2" },
+    { SC_PREVTRACK, "PREVTRACK" },
+    { SC_AT, "AT" },
+    { SC_COLON, "COLON" },
+    { SC_UNDERLINE, "UNDERLINE" },
+    { SC_KANJI, "KANJI" },
+    { SC_STOP, "STOP" },
+    { SC_AX, "AX" },
+    { SC_UNLABELED, "UNLABELED" },
+    { SC_NEXTTRACK, "NEXTTRACK" },
+    { SC_NPRET, "NPRET" },
+    { SC_RCTRL, "RCTRL" },
+    { SC_MUTE, "MUTE" },
+    { SC_CALCULATOR, "CALCULATOR" },
+    { SC_PLAYPAUSE, "PLAYPAUSE" },
+    { SC_MEDIASTOP, "MEDIASTOP" },
+    { SC_E0LSHF, "E0LSHF" },
+    { SC_VOLUMEDOWN, "VOLUMEDOWN" },
+    { SC_VOLUMEUP, "VOLUMEUP" },
+    { SC_WEBHOME, "WEBHOME" },
+    { SC_NUMPADCOMMA, "NP," },
+    { SC_DIVIDE, "NP/" },
+    { SC_PRINT, "PRINT" },
+    { SC_RALT, "RALT" },
+    { SC_BREAK, "SC_BREAK" },
+    { SC_HOME, "HOME" },
+    { SC_UP, "UP" },
+    { SC_PGUP, "PGUP" },
+    { SC_LEFT, "LEFT" },
+    { SC_RIGHT, "RIGHT" },
+    { SC_END, "END" },
+    { SC_DOWN, "DOWN" },
+    { SC_PGDOWN, "PGDOWN" },
+    { SC_INSERT, "INS" },
+    { SC_DELETE, "DEL" },
+    { SC_LWIN, "LWIN" },
+    { SC_RWIN, "RWIN" },
+    { SC_APPS, "APPS" },
+    { SC_POWER, "POWER" },
+    { SC_SLEEP, "SLEEP" },
+    { SC_WAKE, "WAKE" },
+    { SC_WEBSEARCH, "WEBSEARCH" },
+    { SC_WEBFAVORITES, "WEBFAVORITES" },
+    { SC_WEBREFRESH, "WEBREFRESH" },
+    { SC_WEBSTOP, "WEBSTOP" },
+    { SC_WEBFORWARD, "WEBFORWARD" },
+    { SC_WEBBACK, "WEBBACK" },
+    { SC_MYCOMPUTER, "MYCOMPUTER" },
+    { SC_MAIL, "MAIL" },
+    { SC_MEDIASELECT, "MEDIASELECT" },
 
-    //fill all undefined scancodes with "SC_0XNN" so they can be referenced in ini
-    char buffer[9];
-    for (int i = 0; i <= 255; i++)
+    //define all Capsicain VK Virtual Keys >= 0x100
+    //Capsicain virtual modifiers:
+    //{ VK_CPS_ESC, "CPS_ESC" },  //only for logging; do not use this in ini
+    { VK_CPS_TEMPRELEASEKEYS, "TEMPRELEASEKEYS" },
+    { VK_CPS_TEMPRESTOREKEYS, "TEMPRESTOREKEYS" },
+    { VK_CPS_SLEEP, "SLEEP" },
+    { VK_CPS_DEADKEY, "DEADKEY" },
+    { VK_CPS_CONFIGSWITCH, "CONFIGSWITCH" },
+    { VK_CPS_CONFIGPREVIOUS, "CONFIGPREVIOUS" },
+    { VK_MOD9, "MOD9" },
+    { VK_MOD10, "MOD10" },
+    { VK_MOD11, "MOD11" },
+    { VK_MOD12, "MOD12" },
+    { VK_MOD13, "MOD13" },
+    { VK_MOD14, "MOD14" },
+    { VK_MOD15, "MOD15" },
+    { VK_CPS_CAPSON, "CAPSON" },
+    { VK_CPS_CAPSOFF, "CAPSOFF" },
+    { VK_CPS_RECORDMACRO, "RECMAC" },
+    { VK_CPS_RECORDSECRETMACRO, "RECSECMACRO" },
+    { VK_CPS_PLAYMACRO, "PLAYMAC" },
+    { VK_CPS_OBFUSCATED_SEQUENCE_START, "OBFUSEQSTART" },
+    { VK_CPS_PAUSE, "PAUSE" },  //this is not a real scancode, used to map the PAUSE combo E1 LCTRL SCRLCK
+/* testing the VMK style config shift
+    { VK_SHFCFG0, "SHFCFG0" },
+    { VK_SHFCFG1, "SHFCFG1" },
+    { VK_SHFCFG2, "SHFCFG2" },
+    { VK_SHFCFG3, "SHFCFG3" },
+    { VK_SHFCFG4, "SHFCFG4" },
+    { VK_SHFCFG5, "SHFCFG5" },
+    { VK_SHFCFG6, "SHFCFG6" },
+    { VK_SHFCFG7, "SHFCFG7" },
+    { VK_SHFCFG8, "SHFCFG8" },
+    { VK_SHFCFG9, "SHFCFG9" },
+*/
+};
+
+static constexpr char toUpperAscii(char c)
+{
+    return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+//"SC_0XNN" for all scancodes without a label, so they can be referenced in the ini
+struct GenericLabels
+{
+    char text[256][8];
+};
+
+static constexpr GenericLabels makeGenericLabels()
+{
+    GenericLabels generic = {};
+    const char prefix[] = "SC_0X";
+    const char hexDigits[] = "0123456789ABCDEF";
+    for (int i = 0; i < 256; i++)
+    {
+        for (int c = 0; c < 5; c++)
+            generic.text[i][c] = prefix[c];
+        generic.text[i][5] = hexDigits[i >> 4];
+        generic.text[i][6] = hexDigits[i & 0xF];
+    }
+    return generic;
+}
+
+static constexpr GenericLabels GENERIC_LABELS = makeGenericLabels();
+
+struct LabelTable
+{
+    std::string_view labels[MAX_VCODES];
+    bool codesInRange;
+    bool codesUnique;
+    bool labelsUpperCase;
+};
+
+static constexpr LabelTable makeLabelTable()
+{
+    LabelTable table = {};
+    for (std::string_view &label : table.labels)
+        label = std::string_view();  //explicit, gcc does not see the value-initialized ones as constant
+    table.codesInRange = table.codesUnique = table.labelsUpperCase = true;
+    for (const KeyLabel &key : KEY_LABELS)
     {
-        if (arr[i] == "")
+        if (key.vcode < 0 || key.vcode >= MAX_VCODES)
+            table.codesInRange = false;
+        else if (!table.labels[key.vcode].empty())
+            table.codesUnique = false;
+        else
+            table.labels[key.vcode] = key.label;
+        for (char c : key.label)
+            if (toUpperAscii(c) != c)
+                table.labelsUpperCase = false;
+    }
+    for (int i = 0; i < 256; i++)
+        if (table.labels[i].empty())
+            table.labels[i] = std::string_view(GENERIC_LABELS.text[i], 7);
+    return table;
+}
+
+static constexpr LabelTable LABEL_TABLE = makeLabelTable();
+static_assert(LABEL_TABLE.codesInRange, "scancodes.h defines a virtual code that is bigger than MAX_VCODES. Increase MAX_VCODES !");
+static_assert(LABEL_TABLE.codesUnique, "duplicate scancode in the key label table");
+static_assert(LABEL_TABLE.labelsUpperCase, "key labels must be upper case");
+
+const std::string_view (&PRETTY_VK_LABELS)[MAX_VCODES] = LABEL_TABLE.labels;
+
+// Label lookup: a perfect hash (hash and displace), built at compile time.
+// Every label hashes to a bucket, every bucket has a displacement that moves all its labels into free slots.
+// A lookup is one hash, one slot and one compare; no search, no allocation.
+#define LABEL_HASH_BUCKETS 128   //power of 2
+#define LABEL_HASH_SLOTS 1024    //power of 2, about 3.5 slots per label
+#define LABEL_HASH_MAX_DISPLACEMENT 4096
+
+//case-insensitive FNV-1a
+static constexpr unsigned int hashLabel(std::string_view label)
+{
+    unsigned int hash = 2166136261u;
+    for (char c : label)
+        hash = (hash ^ (unsigned char)toUpperAscii(c)) * 16777619u;
+    return hash;
+}
+
+static constexpr int labelSlot(unsigned int hash, unsigned int displacement)
+{
+    unsigned int h = hash ^ (displacement * 0x9E3779B9u);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return (int)(h & (LABEL_HASH_SLOTS - 1));
+}
+
+struct LabelHash
+{
+    unsigned short displacement[LABEL_HASH_BUCKETS];
+    short slots[LABEL_HASH_SLOTS];  //vcode, -1 if free
+    bool complete;
+};
+
+static constexpr LabelHash makeLabelHash(const LabelTable &table)
+{
+    LabelHash lh = {};
+    for (short &slot : lh.slots)
+        slot = -1;
+
+    //sort the vcodes by bucket, in vcode order within a bucket
+    unsigned int hashes[MAX_VCODES] = {};
+    int bucketStart[LABEL_HASH_BUCKETS + 1] = {};
+    for (int vcode = 0; vcode < MAX_VCODES; vcode++)
+    {
+        hashes[vcode] = hashLabel(table.labels[vcode]);
+        if (!table.labels[vcode].empty())
+            bucketStart[(hashes[vcode] & (LABEL_HASH_BUCKETS - 1)) + 1]++;
+    }
+    int biggestBucket = 0;
+    for (int b = 0; b < LABEL_HASH_BUCKETS; b++)
+    {
+        if (bucketStart[b + 1] > biggestBucket)
+            biggestBucket = bucketStart[b + 1];
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    int bucketFill[LABEL_HASH_BUCKETS] = {};
+    int vcodes[MAX_VCODES] = {};
+    for (int vcode = 0; vcode < MAX_VCODES; vcode++)
+    {
+        if (table.labels[vcode].empty())
+            continue;
+        int b = hashes[vcode] & (LABEL_HASH_BUCKETS - 1);
+        vcodes[bucketStart[b] + bucketFill[b]++] = vcode;
+    }
+    //the same label twice (SLEEP): the lower vcode wins, like the old linear search did
+    bool shadowed[MAX_VCODES] = {};
+    for (int b = 0; b < LABEL_HASH_BUCKETS; b++)
+        for (int i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+            for (int j = bucketStart[b]; j < i; j++)
+                if (table.labels[vcodes[j]] == table.labels[vcodes[i]])
+                    shadowed[vcodes[i]] = true;
+
+    //place the biggest buckets first while there is room
+    lh.complete = true;
+    for (int size = biggestBucket; size > 0; size--)
+    {
+        for (int b = 0; b < LABEL_HASH_BUCKETS; b++)
         {
-            snprintf(buffer, 9, "SC_0X%02X", i);
-            arr[i].assign(buffer, 7);
+            if (bucketStart[b + 1] - bucketStart[b] != size)
+                continue;
+            int d = 0;
+            for (; d < LABEL_HASH_MAX_DISPLACEMENT; d++)
+            {
+                bool fits = true;
+                for (int i = bucketStart[b]; i < bucketStart[b + 1] && fits; i++)
+                {
+                    if (shadowed[vcodes[i]])
+                        continue;
+                    int slot = labelSlot(hashes[vcodes[i]], d);
+                    if (lh.slots[slot] >= 0)
+                        fits = false;
+                    for (int j = bucketStart[b]; j < i; j++)
+                        if (!shadowed[vcodes[j]] && labelSlot(hashes[vcodes[j]], d) == slot)
+                            fits = false;
+                }
+                if (fits)
+                    break;
+            }
+            if (d == LABEL_HASH_MAX_DISPLACEMENT)
+            {
+                lh.complete = false;
+                continue;
+            }
+            lh.displacement[b] = (unsigned short)d;
+            for (int i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+                if (!shadowed[vcodes[i]])
+                    lh.slots[labelSlot(hashes[vcodes[i]], d)] = (short)vcodes[i];
         }
     }
+    return lh;
+}
 
-    //define all Capsicain VK Virtual Keys >= 0x100
-    //Capsicain virtual modifiers:
-    //checkAddLabel(VK_CPS_ESC, "CPS_ESC", arr);  //only for logging; do not use this in ini
-    checkAddLabel(VK_CPS_TEMPRELEASEKEYS, "TEMPRELEASEKEYS", arr);
-    checkAddLabel(VK_CPS_TEMPRESTOREKEYS, "TEMPRESTOREKEYS", arr);
-    checkAddLabel(VK_CPS_SLEEP, "SLEEP", arr);
-    checkAddLabel(VK_CPS_DEADKEY, "DEADKEY", arr);
-    checkAddLabel(VK_CPS_CONFIGSWITCH, "CONFIGSWITCH", arr);
-    checkAddLabel(VK_CPS_CONFIGPREVIOUS, "CONFIGPREVIOUS", arr);
-    checkAddLabel(VK_MOD9, "MOD9", arr);
-    checkAddLabel(VK_MOD10, "MOD10", arr);
-    checkAddLabel(VK_MOD11, "MOD11", arr);
-    checkAddLabel(VK_MOD12, "MOD12", arr);
-    checkAddLabel(VK_MOD13, "MOD13", arr);
-    checkAddLabel(VK_MOD14, "MOD14", arr);
-    checkAddLabel(VK_MOD15, "MOD15", arr);
-    checkAddLabel(VK_CPS_CAPSON, "CAPSON", arr);
-    checkAddLabel(VK_CPS_CAPSOFF, "CAPSOFF", arr);
-    checkAddLabel(VK_CPS_RECORDMACRO, "RECMAC", arr);
-    checkAddLabel(VK_CPS_RECORDSECRETMACRO, "RECSECMACRO", arr);
-    checkAddLabel(VK_CPS_PLAYMACRO, "PLAYMAC", arr);
-    checkAddLabel(VK_CPS_OBFUSCATED_SEQUENCE_START, "OBFUSEQSTART", arr);
-    checkAddLabel(VK_CPS_PAUSE, "PAUSE", arr);  //this is not a real scancode, used to map the PAUSE combo E1 LCTRL SCRLCK
-/* testing the VMK style config shift
-    checkAddLabel(VK_SHFCFG0, "SHFCFG0", arr);
-    checkAddLabel(VK_SHFCFG1, "SHFCFG1", arr);
-    checkAddLabel(VK_SHFCFG2, "SHFCFG2", arr);
-    checkAddLabel(VK_SHFCFG3, "SHFCFG3", arr);
-    checkAddLabel(VK_SHFCFG4, "SHFCFG4", arr);
-    checkAddLabel(VK_SHFCFG5, "SHFCFG5", arr);
-    checkAddLabel(VK_SHFCFG6, "SHFCFG6", arr);
-    checkAddLabel(VK_SHFCFG7, "SHFCFG7", arr);
-    checkAddLabel(VK_SHFCFG8, "SHFCFG8", arr);
-    checkAddLabel(VK_SHFCFG9, "SHFCFG9", arr);
-*/
+static constexpr LabelHash LABEL_HASH = makeLabelHash(LABEL_TABLE);
+static_assert(LABEL_HASH.complete, "key label hash does not fit. Increase LABEL_HASH_SLOTS or LABEL_HASH_MAX_DISPLACEMENT");
 
+//returns -1 if label is not found (case-insensitive), otherwise the vcode
+int getVcode(std::string_view label)
+{
+    unsigned int hash = hashLabel(label);
+    int vcode = LABEL_HASH.slots[labelSlot(hash, LABEL_HASH.displacement[hash & (LABEL_HASH_BUCKETS - 1)])];
+    if (vcode < 0 || PRETTY_VK_LABELS[vcode].size() != label.size())
+        return -1;
+    for (size_t i = 0; i < label.size(); i++)
+        if (toUpperAscii(label[i]) != PRETTY_VK_LABELS[vcode][i])
+            return -1;
+    return vcode;
 }
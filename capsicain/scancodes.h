@@ -1,8 +1,11 @@
 #pragma once
 
 #include <string>
-void defineAllPrettyVKLabels(std::string prettyVKLabels[]);
-int getVcode(std::string label, std::string prettyVKLabels[]);
+#include <string_view>
+#include "constants.h"
+
+extern const std::string_view (&PRETTY_VK_LABELS)[MAX_VCODES]; // contains e.g. [SC_ESCAPE]="ESC"; all VKs incl. > 0xFF
+int getVcode(std::string_view label);
 
 // taken from https://github.com/wgois/OIS/blob/master/includes/OISKeyboard.h
 // assigns easy to remember labels to the PS2 scan codes set 1 (which the keyboard driver seems to use)
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "engine.h"
+#include "configCache.h"
+
+using namespace std;
+
+// Startup benchmark: how long it takes from reading the ini until the startup config is active,
+// and until all configs are compiled. Measured without the config cache (the plain parse, as before the cache),
+// with a stale cache (parse and write the cache) and with a valid cache (map and read the cache).
+// The parse part alone: read, normalize and index the ini, then assemble the sections of all configs (INCLUDEs resolved).
+//
+// usage: capsicain_startup_bench [--runs N] [path/to/capsicain.ini ...]     default: capsicain.ini capsicain.kingcon.ini
+// Writes <ini>.cache next to each ini.
+
+class NullIO : public EngineOutput
+{
+public:
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override {}
+    bool isLockKeyOn(int scancode) override { return false; }
+};
+
+struct StartupTime
+{
+    long long startupUS;   //loadIni(): the startup config is active
+    long long allConfigsUS;  //the compile worker is done
+};
+
+enum CACHE_MODE
+{
+    CACHE_OFF,
+    CACHE_STALE,
+    CACHE_VALID
+};
+
+StartupTime measureStartup(string iniFileName, CACHE_MODE mode)
+{
+    if (mode == CACHE_STALE)
+        remove(getConfigCacheFileName(iniFileName).c_str());
+
+    NullIO io;
+    SteadyClock clock;
+    EngineHost host;
+    Engine engine(io, clock, host);
+    engine.iniFileName = iniFileName;
+    engine.useConfigCache = (mode != CACHE_OFF);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    engine.loadIni();
+    long long startupUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    engine.waitForCompileWorker();
+    long long allConfigsUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+    if (mode == CACHE_VALID && !engine.configsFromCache)
+        cerr << "WARNING: the cache of " << iniFileName << " was not used" << endl;
+    return { startupUS, allConfigsUS };
+}
+
+struct ParseTime
+{
+    long long sanitizeUS;  //readSanitizeIniFile()
+    long long assembleUS;  //assembleConfig() of all configs
+};
+
+ParseTime measureParse(Engine &engine, string iniFileName)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    readSanitizeIniFile(engine.sanitizedIniContent, iniFileName);
+    long long sanitizeUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    size_t lines = 0;
+    for (int config = 1; config < MAX_CONFIGS; config++)
+        lines += engine.assembleConfig(config).size();
+    long long assembleUS = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return { sanitizeUS, lines > 0 ? assembleUS : 0 };
+}
+
+long long median(vector<long long> values)
+{
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 20;
+    vector<string> iniFileNames;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = max(1, atoi(argv[++i]));
+        else
+            iniFileNames.push_back(arg);
+    }
+    if (iniFileNames.empty())
+        iniFileNames = { "capsicain.ini", "capsicain.kingcon.ini" };
+
+    //the engine talks a lot while loading
+    streambuf *console = cout.rdbuf(nullptr);
+    ostream results(console);
+
+    results << "# ini parse, median of " << runs << " runs, microseconds" << endl;
+    results << left << setw(32) << "ini" << right << setw(12) << "sanitize" << setw(14) << "assembleAll" << endl;
+    for (const string &iniFileName : iniFileNames)
+    {
+        NullIO io;
+        SteadyClock clock;
+        EngineHost host;
+        Engine engine(io, clock, host);
+        vector<long long> sanitize, assemble;
+        for (int run = 0; run < runs; run++)
+        {
+            ParseTime t = measureParse(engine, iniFileName);
+            sanitize.push_back(t.sanitizeUS);
+            assemble.push_back(t.assembleUS);
+        }
+        results << left << setw(32) << iniFileName << right << setw(12) << median(sanitize) << setw(14) << median(assemble) << endl;
+    }
+
+    results << endl << "# startup, median of " << runs << " runs, microseconds" << endl;
+    results << left << setw(32) << "ini" << setw(8) << "cache" << right << setw(12) << "startup" << setw(14) << "allConfigs" << endl;
+    const char *modeNames[] = { "off", "stale", "valid" };
+    for (const string &iniFileName : iniFileNames)
+    {
+        IniContent probe;
+        if (!readSanitizeIniFile(probe, iniFileName))
+        {
+            cerr << "Cannot read " << iniFileName << endl;
+            continue;
+        }
+        for (CACHE_MODE mode : { CACHE_OFF, CACHE_STALE, CACHE_VALID })
+        {
+            vector<long long> startup, allConfigs;
+            for (int run = 0; run < runs; run++)
+            {
+                StartupTime t = measureStartup(iniFileName, mode);
+                startup.push_back(t.startupUS);
+                allConfigs.push_back(t.allConfigsUS);
+            }
+            results << left << setw(32) << iniFileName << setw(8) << modeNames[mode]
+                << right << setw(12) << median(startup) << setw(14) << median(allConfigs) << endl;
+        }
+    }
+    return 0;
+}
@@ -7,6 +7,8 @@
 
 const int TRAYBAR_UID = 11;
 
+static bool capturing = false;  //ESC+G input capture is running: REC icon whatever the config, and a warning tooltip
+
 bool DeleteIconFromTraybar()
 {
     ::NOTIFYICONDATA tnid;
@@ -58,11 +60,13 @@ bool ShowInTaskbar()
 
 bool ShowInTraybar(bool enabled, bool recording, int activeConfig)
 {
-    LPCTSTR lpszTip = "Capsicain "; // tooltip.c_str();
+    LPCTSTR lpszTip = capturing ? "Capsicain - CAPTURING ALL INPUT" : "Capsicain "; // tooltip.c_str();
 
     HMODULE handleToMyself = ::GetModuleHandleA(NULL);
     HICON hIcon;
-    if( !enabled || activeConfig == 0)
+    if (capturing)
+        hIcon = LoadIcon(handleToMyself, MAKEINTRESOURCE(IDI_ICON_REC));
+    else if( !enabled || activeConfig == 0)
         hIcon = LoadIcon(handleToMyself, MAKEINTRESOURCE(IDI_ICON_OFF));
     else if (recording)
         hIcon = LoadIcon(handleToMyself, MAKEINTRESOURCE(IDI_ICON_REC));
@@ -97,6 +101,11 @@ bool ShowInTraybar(bool enabled, bool recording, int activeConfig)
     return res;
 }
 
+void setTrayCapturing(bool on)
+{
+    capturing = on;
+}
+
 void updateTrayIcon(bool enabled, bool recording, int activeConfig)
 {
     if (!IsCapsicainInTray())
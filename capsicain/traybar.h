@@ -7,4 +7,5 @@ bool IsCapsicainInTray();
 bool ShowInTaskbar();
 bool ShowInTaskbarMinimized();
 bool ShowInTraybar(bool enabled, bool recording, int activeConfig);
-void updateTrayIcon(bool enabled, bool recording, int activeConfig);
\ No newline at end of file
+void updateTrayIcon(bool enabled, bool recording, int activeConfig);
+void setTrayCapturing(bool on);  //input capture running; takes effect with the next icon update
\ No newline at end of file
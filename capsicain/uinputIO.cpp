@@ -0,0 +1,156 @@
+#include "pch.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#include "uinputIO.h"
+#include "evdevKeys.h"
+#include "scancodes.h"
+
+using namespace std;
+
+bool UinputOutput::open()
+{
+    close();
+    int ufd = ::open("/dev/uinput", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (ufd < 0)
+        return false;
+
+    ioctl(ufd, UI_SET_EVBIT, EV_KEY);
+    ioctl(ufd, UI_SET_EVBIT, EV_SYN);
+    ioctl(ufd, UI_SET_EVBIT, EV_LED);
+    for (int code = 1; code < EVDEV_KEY_CODES; code++)
+        if (evdevToVcode(code) != 0 || code == KEY_PAUSE)
+            ioctl(ufd, UI_SET_KEYBIT, code);
+    for (int led : { LED_NUML, LED_CAPSL, LED_SCROLLL })
+        ioctl(ufd, UI_SET_LEDBIT, led);
+
+    uinput_setup setup = {};
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x1209;  //pid.codes, open source projects
+    setup.id.product = 0xCA95;
+    setup.id.version = 1;
+    strncpy(setup.name, UINPUT_DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+    if (ioctl(ufd, UI_DEV_SETUP, &setup) < 0 || ioctl(ufd, UI_DEV_CREATE) < 0)
+    {
+        ::close(ufd);
+        return false;
+    }
+    fd = ufd;
+    isUinput = true;
+    return true;
+}
+
+void UinputOutput::attach(int fd)
+{
+    close();
+    this->fd = fd;
+    isUinput = false;
+}
+
+void UinputOutput::close()
+{
+    if (fd < 0)
+        return;
+    if (isUinput)
+        ioctl(fd, UI_DEV_DESTROY);
+    ::close(fd);
+    fd = -1;
+    memset(keyDown, 0, sizeof(keyDown));
+    e1Pending = false;
+}
+
+static void addEvent(vector<input_event> &events, unsigned short type, unsigned short code, int value)
+{
+    input_event event = {};  //the kernel sets the time
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    events.push_back(event);
+}
+
+//the whole batch in one write. After a short write (a full pipe or socket) the rest follows.
+void UinputOutput::send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count)
+{
+    vector<input_event> events;
+    events.reserve(count * 2);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const InterceptionKeyStroke &stroke = strokes[i];
+        bool isDownstroke = (stroke.state & 1) == 0;
+        int code;
+        if (stroke.state & 4)  //E1 LCTRL: first half of the Pause key
+        {
+            e1Pending = true;
+            continue;
+        }
+        if (e1Pending && stroke.code == SC_NUMLOCK)
+            code = KEY_PAUSE;
+        else
+            code = vcodeToEvdev(convertIkstroke2VKeyEvent(stroke).vcode);
+        e1Pending = false;
+        if (code == 0)
+            continue;
+
+        int value = isDownstroke ? (keyDown[code] ? 2 : 1) : 0;
+        keyDown[code] = isDownstroke;
+        addEvent(events, EV_KEY, (unsigned short)code, value);
+        addEvent(events, EV_SYN, SYN_REPORT, 0);
+    }
+    const char *data = (const char *)events.data();
+    size_t left = events.size() * sizeof(input_event);
+    while (left > 0)
+    {
+        ssize_t n = write(fd, data, left);
+        if (n > 0)
+        {
+            data += n;
+            left -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        pollfd writable = { fd, POLLOUT, 0 };
+        if (n < 0 && errno == EAGAIN && poll(&writable, 1, UINPUT_WRITE_TIMEOUT_MS) > 0)
+            continue;
+        cout << endl << "ERROR: cannot send " << (left + sizeof(input_event) - 1) / sizeof(input_event) << " key events: "
+            << (n < 0 ? strerror(errno) : "nothing written");
+        return;
+    }
+}
+
+//the system writes the LED state to the virtual keyboard; uinput hands it to us to read
+void UinputOutput::readLeds()
+{
+    if (!isUinput)
+        return;
+    input_event events[16];
+    ssize_t n;
+    while ((n = read(fd, events, sizeof(events))) > 0)
+    {
+        for (int i = 0; i < n / (int)sizeof(input_event); i++)
+        {
+            if (events[i].type == EV_LED && events[i].code <= LED_SCROLLL)
+                leds[events[i].code] = events[i].value != 0;
+        }
+    }
+}
+
+bool UinputOutput::isLockKeyOn(int scancode)
+{
+    lock_guard<mutex> lock(ledMutex);
+    readLeds();
+    switch (scancode)
+    {
+    case SC_CAPS: return leds[LED_CAPSL];
+    case SC_NUMLOCK: return leds[LED_NUML];
+    case SC_SCRLOCK: return leds[LED_SCROLLL];
+    }
+    return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// EngineOutput on Linux: a virtual keyboard through /dev/uinput.
+// Every send() is one write() (continued after a short write): all strokes of the batch, each key event followed by its SYN_REPORT.
+// The strokes of a key sequence go out back to back, so there is no default pause between them
+// (OPTION delayForKeySequenceMS and sleep() in sequences still pause).
+// The lock keys are read from the LED state the system sets on the virtual keyboard.
+// attach() writes the same event stream to any file descriptor instead (a file or pipe, for tests).
+
+#include <mutex>
+
+#include "engine.h"
+#include "evdevKeys.h"
+
+#define UINPUT_DEVICE_NAME "capsicain virtual keyboard"
+#define UINPUT_WRITE_TIMEOUT_MS 1000  //a write that cannot go on for this long loses the rest of the batch
+
+class UinputOutput : public EngineOutput
+{
+public:
+    ~UinputOutput() { close(); }
+
+    //creates the virtual keyboard. false if /dev/uinput cannot be opened
+    bool open();
+    //use fd as it is, no device setup, no LED state. The fd is closed by close().
+    void attach(int fd);
+    void close();
+
+    void send(InterceptionDevice device, const InterceptionKeyStroke *strokes, unsigned int count) override;
+    bool isLockKeyOn(int scancode) override;
+    unsigned int getDefaultKeySequenceDelayMS() override { return 0; }
+
+private:
+    int fd = -1;
+    bool isUinput = false;
+    bool e1Pending = false;  //got E1 LCTRL, the next NUMLOCK is the Pause key
+    bool keyDown[EVDEV_KEY_CODES] = {};  //by Linux key code; a make code for a key that is down is an autorepeat
+    std::mutex ledMutex;
+    bool leds[3] = {};  //LED_NUML, LED_CAPSL, LED_SCROLLL
+
+    void readLeds();
+};
@@ -4,14 +4,23 @@
 #include <fstream>
 #include <sstream>
 #include <iterator>
+#include <iomanip>
+#include <algorithm>
+#ifdef _WIN32
 #include <windows.h>
 #include <tlhelp32.h>
-#include <algorithm>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "utils.h"
 
 
 using namespace std;
 
+#ifdef _WIN32
 void raise_process_priority(void)
 {
     SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
@@ -146,6 +155,7 @@ void closeOrKillProgram(string processName)
     else if (result == 2)
         cout << " Killed.";
 }
+#endif
 
 //time stuff
 unsigned long timeSinceTimepointMS(chrono::steady_clock::time_point timepoint)
@@ -167,7 +177,7 @@ unsigned long timeBetweenTimepointsUS(std::chrono::steady_clock::time_point time
 }
 
 //String stuff
-bool stringStartsWith(string haystack, string needle)
+bool stringStartsWith(std::string_view haystack, std::string_view needle)
 {
     return (haystack.compare(0, needle.length(), needle) == 0);
 }
@@ -268,4 +278,66 @@ std::string stringIntToHex(const unsigned int i, unsigned int minLength)
     std::stringstream s;
     s << setfill('0') << setw(minLength) << std::hex << i;
     return s.str();
-}
\ No newline at end of file
+}
+
+MappedFile::MappedFile(const std::string &fileName)
+{
+#ifdef _WIN32
+    //share everything, an editor may save the file while it is mapped
+    HANDLE f = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f == INVALID_HANDLE_VALUE)
+        return;
+    file = f;
+    opened = true;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0)
+        return;
+    mapping = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        opened = false;
+        return;
+    }
+    view = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view)
+        length = (size_t)fileSize.QuadPart;
+    else
+        opened = false;
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        opened = true;
+        if (st.st_size > 0)
+        {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                view = (const char *)p;
+                length = (size_t)st.st_size;
+            }
+            else
+                opened = false;
+        }
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (view)
+        UnmapViewOfFile(view);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+#else
+    if (view)
+        munmap((void *)view, length);
+#endif
+}
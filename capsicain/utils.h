@@ -1,20 +1,23 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <vector>
 
+#ifdef _WIN32
 void raise_process_priority(void);
 void copyToClipBoard(std::string text);
 std::string startProgram(std::string processname, std::string dir);
 std::string startProgramSameFolder(std::string path);
 void closeOrKillProgram(std::string processName);
+#endif
 
 unsigned long timeSinceTimepointMS(std::chrono::steady_clock::time_point timepoint);
 unsigned long timeSinceTimepointUS(std::chrono::steady_clock::time_point timepoint);
 std::chrono::steady_clock::time_point timeGetTimepointNow();
 unsigned long timeBetweenTimepointsUS(std::chrono::steady_clock::time_point timepoint1, std::chrono::steady_clock::time_point timepoint2);
 
-bool stringStartsWith(std::string haystack, std::string needle);
+bool stringStartsWith(std::string_view haystack, std::string_view needle);
 std::string stringGetLastToken(std::string line);
 std::string stringGetRestBehindFirstToken(std::string line);
 std::string stringCutFirstToken(std::string& line);
@@ -25,3 +28,24 @@ std::vector<std::string> stringSplit(const std::string &line, char delimiter);
 bool stringToInt(std::string strval, int& result);
 bool stringReplace(std::string& haystack, const std::string& needle, const std::string& newneedle);
 std::string stringIntToHex(const unsigned int i, unsigned int minLength);
+
+//read-only view of a whole file, mapped into memory
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &fileName);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return opened; }
+    const char *data() const { return view; }  //nullptr if the file is empty
+    size_t size() const { return length; }
+
+private:
+    bool opened = false;
+    const char *view = nullptr;
+    size_t length = 0;
+    void *file = nullptr;     //Windows file and mapping handles
+    void *mapping = nullptr;
+};
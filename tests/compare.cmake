@@ -0,0 +1,13 @@
+# CTest script: run capsicain_headless --compare on a stroke file, fail on any mismatch.
+# -DHEADLESS=<exe> -DINI=<ini> -DSTROKES=<stroke file>
+execute_process(
+    COMMAND ${HEADLESS} --compare --nocache ${INI}
+    INPUT_FILE ${STROKES}
+    OUTPUT_QUIET
+    ERROR_VARIABLE report
+    RESULT_VARIABLE result
+)
+message("${report}")
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "interpreted and compiled config differ for ${INI}")
+endif()
@@ -0,0 +1,119 @@
+// Test of capsicain_linux --events: runs it on a few strokes and checks the struct input_event records it writes.
+// The event stream goes to a SOCK_SEQPACKET socket, where every write() arrives as one packet, so the batches are visible.
+//
+// usage: capsicain_events_check <path/to/capsicain_linux> <ini>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <linux/input.h>
+
+using namespace std;
+
+//A down, autorepeat, up. Pause as the Interception driver delivers it: E1 LCTRL, NUMLOCK. X is sequence(B_C) in the ini.
+static const char *STROKES = "1e 0\n1e 0\n1e 1\n1d 4\n45 0\n1d 5\n45 1\n2d 0\n2d 1\n";
+
+struct KeyEvent
+{
+    unsigned short code;
+    int value;  //0 up, 1 down, 2 autorepeat
+    size_t write = 0;  //index of the write it came in
+};
+
+static const vector<KeyEvent> EXPECTED = {
+    { KEY_A, 1 }, { KEY_A, 2 }, { KEY_A, 0 },
+    { KEY_PAUSE, 1 }, { KEY_PAUSE, 0 },
+    { KEY_B, 1 }, { KEY_B, 0 }, { KEY_C, 1 }, { KEY_C, 0 },
+};
+static const size_t SEQUENCE_START = 5;  //EXPECTED from here on is the sequence; it must come in one write
+
+static int failures = 0;
+
+static void fail(const string &what)
+{
+    cout << "FAIL: " << what << endl;
+    failures++;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        cout << "usage: capsicain_events_check <path/to/capsicain_linux> <ini>" << endl;
+        return 2;
+    }
+
+    int events[2], strokes[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, events) < 0 || pipe(strokes) < 0)
+    {
+        perror("capsicain_events_check");
+        return 2;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(strokes[0], STDIN_FILENO);
+        dup2(events[1], STDOUT_FILENO);
+        close(strokes[1]);
+        execl(argv[1], argv[1], "--stdin", "--events", "-", argv[2], (char *)nullptr);
+        _exit(127);
+    }
+    close(strokes[0]);
+    close(events[1]);
+    if (write(strokes[1], STROKES, strlen(STROKES)) < 0)
+        fail("cannot write the strokes");
+    close(strokes[1]);
+
+    vector<vector<input_event>> writes;
+    input_event buffer[256];
+    ssize_t n;
+    while ((n = recv(events[0], buffer, sizeof(buffer), 0)) > 0)
+    {
+        if (n % sizeof(input_event) != 0)
+            fail("a write that is not whole input_event records");
+        writes.emplace_back(buffer, buffer + n / sizeof(input_event));
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        fail("capsicain_linux did not exit cleanly");
+
+    //each write is one batch: key events, each followed by its SYN_REPORT
+    vector<KeyEvent> keys;
+    for (size_t w = 0; w < writes.size(); w++)
+    {
+        const vector<input_event> &batch = writes[w];
+        if (batch.size() % 2 != 0)
+            fail("a write with a key event but no SYN_REPORT");
+        for (size_t i = 0; i + 1 < batch.size(); i += 2)
+        {
+            if (batch[i].type != EV_KEY)
+                fail("type " + to_string(batch[i].type) + " where a key event was expected");
+            if (batch[i + 1].type != EV_SYN || batch[i + 1].code != SYN_REPORT)
+                fail("no SYN_REPORT after key " + to_string(batch[i].code));
+            keys.push_back({ batch[i].code, batch[i].value, w });
+        }
+    }
+
+    if (keys.size() != EXPECTED.size())
+        fail(to_string(keys.size()) + " key events, expected " + to_string(EXPECTED.size()));
+    for (size_t i = 0; i < keys.size() && i < EXPECTED.size(); i++)
+    {
+        if (keys[i].code != EXPECTED[i].code || keys[i].value != EXPECTED[i].value)
+            fail("key event " + to_string(i) + ": " + to_string(keys[i].code) + " " + to_string(keys[i].value)
+                + ", expected " + to_string(EXPECTED[i].code) + " " + to_string(EXPECTED[i].value));
+    }
+    for (size_t i = SEQUENCE_START + 1; i < keys.size(); i++)
+    {
+        if (keys[i].write != keys[SEQUENCE_START].write)
+            fail("the sequence is split over writes " + to_string(keys[SEQUENCE_START].write) + " and " + to_string(keys[i].write));
+    }
+
+    cout << writes.size() << " writes, " << keys.size() << " key events" << endl;
+    return failures == 0 ? 0 : 1;
+}
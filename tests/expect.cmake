@@ -0,0 +1,8 @@
+# CTest script: run capsicain_headless on a stroke file, fail unless it sends exactly the expected strokes.
+# -DHEADLESS=<exe> -DINI=<ini> -DSTROKES=<stroke file> -DEXPECTED=<expected output>
+execute_process(COMMAND ${HEADLESS} --nocache ${INI} INPUT_FILE ${STROKES} OUTPUT_VARIABLE output ERROR_QUIET RESULT_VARIABLE result)
+file(READ ${EXPECTED} expected)
+string(REPLACE "\r\n" "\n" expected "${expected}")
+if(NOT result EQUAL 0 OR NOT output STREQUAL expected)
+    message(FATAL_ERROR "${INI}: expected\n${expected}got\n${output}")
+endif()